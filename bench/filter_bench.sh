@@ -0,0 +1,62 @@
+#!/bin/bash
+# Compares the stream filters of myshell (head, tail, wc, grep, cut and rev run on threads of the
+# shell) with the coreutils programs they replace, by running the same commands over a generated
+# file with MYSHELL_FILTERS=1 and MYSHELL_FILTERS=0, and prints MB/sec for both. Each command runs
+# several times inside a loop of one shell, so the figures include launching the programs (with 0)
+# but not starting the shell. Outputs go to a file, as GNU grep stops early when writing /dev/null.
+#
+# Usage: bench/filter_bench.sh [size of the input in MB] [runs per command]
+
+SHELL_BINARY="$(cd "$(dirname "$0")/.." && pwd)/myshell"
+SIZE_MB=${1:-256}
+RUNS=${2:-3}
+
+if [ ! -x "$SHELL_BINARY" ]; then
+    echo "Build myshell first (make)" >&2
+    exit 1
+fi
+
+WORK_DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$WORK_DIRECTORY"' EXIT
+cd "$WORK_DIRECTORY" || exit 1
+export MYSHELL_HISTORY="$WORK_DIRECTORY/history.txt"
+
+# The input: tab separated lines of varying length, one in 16 holding the string grep looks for
+awk -v size=$((SIZE_MB * 1024 * 1024)) 'BEGIN {
+    srand(1)
+    while (written < size) {
+        line = sprintf("%d\tfield%d\t%s\t%s", NR++, int(rand() * 1000), substr("lorem ipsum dolor sit amet consectetur adipiscing elit", 1 + int(rand() * 40)), (NR % 16 == 0) ? "needle" : "hay")
+        print line
+        written += length(line) + 1
+    }
+}' > input.txt
+
+COMMANDS=(
+    "wc -l < input.txt > out.txt"
+    "wc -c < input.txt > out.txt"
+    "head -n 100000000 < input.txt > out.txt"
+    "tail -n 1000 < input.txt > out.txt"
+    "cat input.txt | tail -n 1000 > out.txt"
+    "grep -F needle < input.txt > out.txt"
+    "grep -c needle < input.txt > out.txt"
+    "grep -v hay < input.txt > out.txt"
+    "cut -f 2,4 < input.txt > out.txt"
+    "cut -b 1-8 < input.txt > out.txt"
+    "rev < input.txt > out.txt"
+    "cat input.txt | grep needle | cut -f 1 | wc -l > out.txt"
+)
+
+# Runs a command RUNS times inside one shell with MYSHELL_FILTERS set to the first argument, prints MB/sec
+run() {
+    local start end
+    rm -f out.txt # Truncating the large output of the previous command would be timed otherwise
+    start=$(date +%s%N)
+    MYSHELL_FILTERS=$1 "$SHELL_BINARY" -c "for run in $(seq -s ' ' "$RUNS"); do $2; done" > /dev/null 2>&1
+    end=$(date +%s%N)
+    awk -v mb=$((SIZE_MB * RUNS)) -v ns=$((end - start)) 'BEGIN { printf "%.0f", mb / (ns / 1e9) }'
+}
+
+printf "%-56s %12s %12s\n" "command (${SIZE_MB} MB input)" "threads" "coreutils"
+for command in "${COMMANDS[@]}"; do
+    printf "%-56s %7s MB/s %7s MB/s\n" "$command" "$(run 1 "$command")" "$(run 0 "$command")"
+done
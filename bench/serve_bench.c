@@ -0,0 +1,295 @@
+/** Benchmark of the server mode of myshell **/
+// Compares launching "myshell -c" once per command (what an orchestrator does without the server)
+// with sending the same commands to "myshell --serve": one command per batch over one connection,
+// and batches of BATCH_SIZE commands over several concurrent connections. Before measuring, the
+// frames of a small batch are checked (output, error output and exit statuses).
+//
+// Usage: bench/serve_bench <myshell binary> [commands per scenario] [concurrent clients]
+
+/** Including necessary .h files **/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define DEFAULT_COMMANDS 2000 // Commands per scenario
+#define DEFAULT_CLIENTS 4 // Concurrent connections of the batched scenario
+#define BATCH_SIZE 100 // Commands per batch of the batched scenario
+#define COMMAND "echo bench" // The measured command
+#define CONNECT_TIMEOUT_MS 5000 // How long the server may take to start listening
+
+/** A reply of the server **/
+struct reply {
+    char *output; // Data of the 'O' frames
+    size_t outputLength;
+    char *errors; // Data of the 'E' frames
+    size_t errorsLength;
+    int statuses[BATCH_SIZE]; // Data of the 'S' frames
+    int numOfStatuses;
+};
+
+// Current time in microseconds (monotonic)
+double nowMicroseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+// Reads exactly length bytes. Returns 0 on success, -1 at the end of the connection or on error
+int readExactly(int fd, void *buffer, size_t length) {
+    while (length > 0) {
+        ssize_t bytesRead = read(fd, buffer, length);
+        if ((bytesRead == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            return -1;
+        }
+        buffer = (char *) buffer + bytesRead;
+        length -= bytesRead;
+    }
+    return 0;
+}
+// Connects to the server, retrying until it listens. Returns the descriptor, -1 on error
+int connectToServer(const char *socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", socketPath);
+    double deadline = nowMicroseconds() + CONNECT_TIMEOUT_MS * 1000.0;
+    while (nowMicroseconds() < deadline) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connect(fd, (struct sockaddr *) &address, sizeof(address)) == 0) {
+            return fd;
+        }
+        close(fd);
+        usleep(10000);
+    }
+    fprintf(stderr, "Could not connect to %s\n", socketPath);
+    return -1;
+}
+// Sends a batch of numOfCommands copies of commands (or the given list), then reads the frames of
+// the reply until the batch is done. Returns 0 on success, -1 on error
+int runBatch(int fd, const char **commands, int numOfCommands, struct reply *reply) {
+    size_t length = 0;
+    for (int i = 0; i < numOfCommands; i++) {
+        length += strlen(commands[i]) + 1;
+    }
+    char *frame = malloc(5 + length);
+    uint32_t networkLength = htonl(length);
+    frame[0] = 'B';
+    memcpy(frame + 1, &networkLength, 4);
+    char *end = frame + 5;
+    for (int i = 0; i < numOfCommands; i++) {
+        end = stpcpy(end, commands[i]) + 1;
+    }
+    ssize_t bytesSent = send(fd, frame, 5 + length, MSG_NOSIGNAL);
+    free(frame);
+    if (bytesSent != (ssize_t) (5 + length)) {
+        return -1;
+    }
+
+    memset(reply, 0, sizeof(*reply));
+    while (1) {
+        unsigned char header[5];
+        if (readExactly(fd, header, 5) == -1) {
+            return -1;
+        }
+        memcpy(&networkLength, header + 1, 4);
+        uint32_t payloadLength = ntohl(networkLength);
+        char *payload = malloc(payloadLength + 1);
+        if (readExactly(fd, payload, payloadLength) == -1) {
+            free(payload);
+            return -1;
+        }
+        if (header[0] == 'O') {
+            reply->output = realloc(reply->output, reply->outputLength + payloadLength + 1);
+            memcpy(reply->output + reply->outputLength, payload, payloadLength);
+            reply->outputLength += payloadLength;
+            reply->output[reply->outputLength] = '\0';
+        } else if (header[0] == 'E') {
+            reply->errors = realloc(reply->errors, reply->errorsLength + payloadLength + 1);
+            memcpy(reply->errors + reply->errorsLength, payload, payloadLength);
+            reply->errorsLength += payloadLength;
+            reply->errors[reply->errorsLength] = '\0';
+        } else if ((header[0] == 'S') && (payloadLength == 4) && (reply->numOfStatuses < BATCH_SIZE)) {
+            memcpy(&networkLength, payload, 4);
+            reply->statuses[reply->numOfStatuses++] = ntohl(networkLength);
+        }
+        free(payload);
+        if (header[0] == 'D') {
+            return 0;
+        }
+    }
+}
+// Frees the buffers of a reply
+void freeReply(struct reply *reply) {
+    free(reply->output);
+    free(reply->errors);
+}
+// Sends a small batch and checks every part of the reply. Returns 0 if it is right, -1 otherwise
+int checkServer(const char *socketPath) {
+    const char *commands[] = {"echo hello", "ls /nonexistent-bench-path", "x=world", "echo $x | rev", "exit 3"};
+    int fd = connectToServer(socketPath);
+    struct reply reply;
+    if ((fd == -1) || (runBatch(fd, commands, 5, &reply) == -1)) {
+        fprintf(stderr, "The server has not answered the check batch\n");
+        return -1;
+    }
+    int isRight = (reply.output != NULL) && (strcmp(reply.output, "hello\ndlrow\n") == 0) &&
+                  (reply.errors != NULL) && (strstr(reply.errors, "nonexistent-bench-path") != NULL) &&
+                  (reply.numOfStatuses == 5) && (reply.statuses[0] == 0) && (reply.statuses[1] != 0) &&
+                  (reply.statuses[2] == 0) && (reply.statuses[3] == 0) && (reply.statuses[4] == 3);
+    char end;
+    isRight = isRight && (read(fd, &end, 1) == 0); // exit has ended the connection
+    if (!isRight) {
+        fprintf(stderr, "Unexpected reply: output \"%s\", errors \"%s\", %d statuses\n",
+                reply.output ? reply.output : "", reply.errors ? reply.errors : "", reply.numOfStatuses);
+    }
+    freeReply(&reply);
+    close(fd);
+    return isRight ? 0 : -1;
+}
+// Runs the command numOfCommands times with "myshell -c", each reading its output like a client
+// would. Returns commands/sec, -1 on error
+double runWithoutServer(const char *shellBinary, int numOfCommands) {
+    double start = nowMicroseconds();
+    for (int i = 0; i < numOfCommands; i++) {
+        int outputPipe[2];
+        if (pipe(outputPipe) == -1) {
+            return -1;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            dup2(outputPipe[1], STDOUT_FILENO);
+            close(outputPipe[0]);
+            close(outputPipe[1]);
+            execl(shellBinary, shellBinary, "-c", COMMAND, (char *) NULL);
+            _exit(127);
+        }
+        close(outputPipe[1]);
+        char buffer[256];
+        while (read(outputPipe[0], buffer, sizeof(buffer)) > 0) {}
+        close(outputPipe[0]);
+        int status;
+        if ((pid == -1) || (waitpid(pid, &status, 0) == -1) || (status != 0)) {
+            return -1;
+        }
+    }
+    return numOfCommands / ((nowMicroseconds() - start) / 1e6);
+}
+// One client of the server: sends numOfCommands commands in batches of batchSize over one
+// connection. Returns 0 on success, -1 on error
+int runClient(const char *socketPath, int numOfCommands, int batchSize) {
+    const char *commands[BATCH_SIZE];
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        commands[i] = COMMAND;
+    }
+    int fd = connectToServer(socketPath);
+    if (fd == -1) {
+        return -1;
+    }
+    for (int sent = 0; sent < numOfCommands; sent += batchSize) {
+        int size = (numOfCommands - sent < batchSize) ? numOfCommands - sent : batchSize;
+        struct reply reply;
+        int result = runBatch(fd, commands, size, &reply);
+        int isRight = (result == 0) && (reply.numOfStatuses == size) && (reply.outputLength == size * strlen("bench\n"));
+        freeReply(&reply);
+        if (!isRight) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return 0;
+}
+// Runs numOfCommands commands through the server, split over numOfClients concurrent client
+// processes. Returns commands/sec, -1 on error
+double runWithServer(const char *socketPath, int numOfCommands, int batchSize, int numOfClients) {
+    double start = nowMicroseconds();
+    for (int c = 0; c < numOfClients; c++) {
+        if (fork() == 0) {
+            _exit(runClient(socketPath, numOfCommands / numOfClients, batchSize) == 0 ? 0 : 1);
+        }
+    }
+    int hasFailed = 0;
+    for (int c = 0; c < numOfClients; c++) {
+        int status;
+        if ((wait(&status) == -1) || (status != 0)) {
+            hasFailed = 1;
+        }
+    }
+    if (hasFailed) {
+        return -1;
+    }
+    return (numOfCommands / numOfClients * numOfClients) / ((nowMicroseconds() - start) / 1e6);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <myshell binary> [commands per scenario] [concurrent clients]\n", argv[0]);
+        return 1;
+    }
+    char *shellBinary = realpath(argv[1], NULL);
+    if (shellBinary == NULL) {
+        perror("Error finding the shell");
+        return 1;
+    }
+    int numOfCommands = argc > 2 ? atoi(argv[2]) : DEFAULT_COMMANDS;
+    int numOfClients = argc > 3 ? atoi(argv[3]) : DEFAULT_CLIENTS;
+    if (numOfCommands <= 0) {numOfCommands = DEFAULT_COMMANDS;}
+    if (numOfClients <= 0) {numOfClients = DEFAULT_CLIENTS;}
+
+    // The server runs inside a temporary directory, which also holds its socket
+    char workDirectory[] = "/tmp/myshell-serve-bench-XXXXXX";
+    if ((mkdtemp(workDirectory) == NULL) || (chdir(workDirectory) == -1)) {
+        perror("Error creating the work directory");
+        return 1;
+    }
+    char socketPath[1024];
+    snprintf(socketPath, sizeof(socketPath), "%s/shell.sock", workDirectory);
+    pid_t server = fork();
+    if (server == 0) {
+        int nullFd = open("/dev/null", O_WRONLY);
+        dup2(nullFd, STDOUT_FILENO);
+        execl(shellBinary, shellBinary, "--serve", socketPath, (char *) NULL);
+        perror("Error executing the shell");
+        _exit(127);
+    }
+
+    int result = 0;
+    if (checkServer(socketPath) != 0) {
+        result = 1;
+    } else {
+        double withoutServer = runWithoutServer(shellBinary, numOfCommands);
+        double singleCommands = runWithServer(socketPath, numOfCommands, 1, 1);
+        double batches = runWithServer(socketPath, numOfCommands, BATCH_SIZE, numOfClients);
+        if ((withoutServer < 0) || (singleCommands < 0) || (batches < 0)) {
+            fprintf(stderr, "A scenario has failed\n");
+            result = 1;
+        } else {
+            printf("myshell -c per command               %9.0f cmds/sec\n", withoutServer);
+            printf("server, 1 command per batch          %9.0f cmds/sec\n", singleCommands);
+            printf("server, %d per batch, %d clients     %9.0f cmds/sec\n", BATCH_SIZE, numOfClients, batches);
+        }
+    }
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    unlink(socketPath);
+    unlink("alias_config_file.txt");
+    if (chdir("/") == 0) {
+        rmdir(workDirectory);
+    }
+    free(shellBinary);
+    return result;
+}
@@ -0,0 +1,274 @@
+/** End-to-end benchmark of myshell **/
+// Drives the shell through a pseudo terminal, exactly like a user typing at its prompt, and
+// measures every command from the moment its line is written until the next prompt appears.
+// Each scenario runs in a fresh shell inside a temporary directory. The results (commands/sec,
+// p50 and p99 latency of every scenario) are written as JSON, so runs can be compared.
+//
+// Usage: bench/shell_bench <myshell binary> [results.json] [iterations per scenario]
+
+/** Including necessary .h files **/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define DEFAULT_ITERATIONS 2000 // Measured commands per scenario
+#define WARMUP_ITERATIONS 50 // Commands run before measuring, they fill the shell's caches
+#define PROMPT_TIMEOUT_MS 10000 // A command taking longer than this is treated as a hang
+#define NUM_OF_LONG_TOKENS 2000 // Tokens of the long line, which must fit the 4095 byte line limit of the terminal
+#define NUM_OF_EXTRA_ALIASES 10000 // Unrelated aliases put into the journal for the alias scenario
+
+/** Scenarios **/
+struct scenario {
+    const char *name; // Name inside the results
+    const char *command; // The line typed for every iteration, NULL for the long token line
+};
+struct scenario scenarios[] = {
+    {"spawn", "/bin/true"}, // true itself is a builtin, which would not be spawned
+    {"redirect_write", "echo bench > out.txt"},
+    {"redirect_append", "echo bench >> append.txt"},
+    {"redirect_reverse", "echo bench >>> reverse.txt"},
+    {"alias", "bench_alias"},
+    {"background", "/bin/true &"},
+    {"pipeline", "/bin/true | /bin/true"},
+    {"builtin", "hash > hash.txt"},
+    {"long_tokens", NULL},
+    {NULL, NULL}
+};
+
+/** A running shell **/
+struct shell {
+    pid_t pid; // Process id of the shell
+    int fd; // Master side of its terminal
+    char *output; // What the shell has printed since the last command was written
+    size_t length; // Bytes inside output
+    size_t capacity; // Size of output
+};
+char prompt[1024]; // The prompt the shell prints, built the same way the shell does
+
+// Current time in microseconds (monotonic)
+double nowMicroseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+// Reads whatever the shell has printed into its output buffer. Returns 0 on success, -1 once the shell has gone
+int readShell(struct shell *shell) {
+    if (shell->capacity - shell->length < 65536) {
+        shell->capacity = shell->capacity * 2 + 65536;
+        shell->output = realloc(shell->output, shell->capacity);
+    }
+    ssize_t bytesRead = read(shell->fd, shell->output + shell->length, shell->capacity - shell->length - 1);
+    if (bytesRead > 0) {
+        shell->length += bytesRead;
+        shell->output[shell->length] = '\0';
+        return 0;
+    }
+    if ((bytesRead == -1) && ((errno == EAGAIN) || (errno == EINTR))) {
+        return 0;
+    }
+    return -1;
+}
+// Returns 1 if the shell's output ends with its prompt
+int hasPrompt(struct shell *shell) {
+    size_t promptLength = strlen(prompt);
+    return (shell->length >= promptLength) && (memcmp(shell->output + shell->length - promptLength, prompt, promptLength) == 0);
+}
+// Writes a line to the shell and waits for its next prompt, reading its output meanwhile (so
+// neither side can block on a full terminal buffer). Returns 0 on success, -1 on a hang or exit
+int runCommand(struct shell *shell, const char *line) {
+    size_t lineLength = strlen(line);
+    size_t written = 0;
+    shell->length = 0;
+    double deadline = nowMicroseconds() + PROMPT_TIMEOUT_MS * 1000.0;
+    while ((written < lineLength) || !hasPrompt(shell)) {
+        struct pollfd pollFd = {shell->fd, POLLIN | (written < lineLength ? POLLOUT : 0), 0};
+        int timeLeft = (int) ((deadline - nowMicroseconds()) / 1000);
+        if ((timeLeft <= 0) || (poll(&pollFd, 1, timeLeft) == 0)) {
+            fprintf(stderr, "Timed out waiting for the prompt after: %.60s\n", line);
+            return -1;
+        }
+        if (pollFd.revents & POLLIN) {
+            if (readShell(shell) == -1) {
+                fprintf(stderr, "The shell has exited after: %.60s\n", line);
+                return -1;
+            }
+        } else if (pollFd.revents & (POLLHUP | POLLERR)) {
+            fprintf(stderr, "The shell has exited after: %.60s\n", line);
+            return -1;
+        }
+        if ((written < lineLength) && (pollFd.revents & POLLOUT)) {
+            ssize_t bytesWritten = write(shell->fd, line + written, lineLength - written);
+            if (bytesWritten > 0) {written += bytesWritten;}
+        }
+    }
+    return 0;
+}
+// Starts the shell on a new terminal (with echo turned off) and waits for its first prompt
+int startShell(struct shell *shell, const char *shellBinary) {
+    struct termios settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.c_iflag = ICRNL;
+    settings.c_oflag = OPOST | ONLCR;
+    settings.c_cflag = CS8 | CREAD;
+    settings.c_lflag = ICANON | ISIG; // Line editing and signals, like a terminal, but no echo
+    settings.c_cc[VINTR] = 3;
+    settings.c_cc[VSUSP] = 26;
+    settings.c_cc[VEOF] = 4;
+    settings.c_cc[VMIN] = 1;
+    cfsetispeed(&settings, B38400);
+    cfsetospeed(&settings, B38400);
+
+    shell->pid = forkpty(&shell->fd, NULL, &settings, NULL);
+    if (shell->pid < 0) {
+        perror("forkpty Failed");
+        return -1;
+    }
+    if (shell->pid == 0) {
+        execl(shellBinary, shellBinary, (char *) NULL);
+        perror("Error executing the shell");
+        _exit(127);
+    }
+    fcntl(shell->fd, F_SETFL, O_NONBLOCK);
+    return runCommand(shell, "");
+}
+// Ends the shell with exit and reaps it
+void stopShell(struct shell *shell) {
+    if (write(shell->fd, "exit\n", 5) != 5) {
+        kill(shell->pid, SIGKILL);
+    }
+    // Draining the terminal until the shell has gone, so it cannot block on its output
+    struct pollfd pollFd = {shell->fd, POLLIN, 0};
+    while ((poll(&pollFd, 1, PROMPT_TIMEOUT_MS) > 0) && (readShell(shell) == 0)) {
+        shell->length = 0;
+    }
+    close(shell->fd);
+    waitpid(shell->pid, NULL, 0);
+}
+// Comparison function for qsort
+int compareDoubles(const void *first, const void *second) {
+    double a = *(const double *) first, b = *(const double *) second;
+    return (a > b) - (a < b);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <myshell binary> [results.json] [iterations per scenario]\n", argv[0]);
+        return 1;
+    }
+    char *shellBinary = realpath(argv[1], NULL);
+    if (shellBinary == NULL) {
+        perror("Error finding the shell");
+        return 1;
+    }
+    const char *resultsFile = argc > 2 ? argv[2] : "bench/results.json";
+    int iterations = argc > 3 ? atoi(argv[3]) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) {iterations = DEFAULT_ITERATIONS;}
+    FILE *results = fopen(resultsFile, "w");
+    if (results == NULL) {
+        perror("Error opening the results file");
+        return 1;
+    }
+
+    // Every scenario runs inside a temporary directory, which becomes the shell's PWD
+    char workDirectory[] = "/tmp/myshell-bench-XXXXXX";
+    if ((mkdtemp(workDirectory) == NULL) || (chdir(workDirectory) == -1)) {
+        perror("Error creating the work directory");
+        return 1;
+    }
+    setenv("PWD", workDirectory, 1);
+    setenv("USER", "bench", 1);
+    char historyFile[1024];
+    snprintf(historyFile, sizeof(historyFile), "%s/history.txt", workDirectory);
+    setenv("MYSHELL_HISTORY", historyFile, 1); // The benchmark's lines stay out of the user's history
+    char hostName[255];
+    gethostname(hostName, sizeof(hostName));
+    snprintf(prompt, sizeof(prompt), "bench@%s %s --- ", hostName, workDirectory);
+
+    // The alias journal, the alias we run is the last line after many unrelated ones
+    FILE *journal = fopen("alias_config_file.txt", "w");
+    for (int i = 0; i < NUM_OF_EXTRA_ALIASES; i++) {
+        fprintf(journal, "bench_alias_%d=echo %d\n", i, i);
+    }
+    fprintf(journal, "bench_alias=/bin/true\n");
+    fclose(journal);
+
+    // The long token line
+    char *longLine = malloc(NUM_OF_LONG_TOKENS * 2 + 16);
+    strcpy(longLine, "/bin/true");
+    char *end = longLine + 9;
+    for (int i = 0; i < NUM_OF_LONG_TOKENS; i++) {
+        *end++ = ' ';
+        *end++ = 'x';
+    }
+    *end = '\0';
+
+    double *latencies = malloc(iterations * sizeof(double));
+    fprintf(results, "{\n  \"iterations\": %d,\n  \"scenarios\": [\n", iterations);
+    int hasFailed = 0;
+    for (int s = 0; scenarios[s].name != NULL; s++) {
+        const char *command = scenarios[s].command != NULL ? scenarios[s].command : longLine;
+        char *line = malloc(strlen(command) + 2);
+        sprintf(line, "%s\n", command);
+
+        struct shell shell = {0, -1, NULL, 0, 0};
+        if (startShell(&shell, shellBinary) != 0) {
+            hasFailed = 1;
+            break;
+        }
+        int isFinished = 1;
+        for (int i = 0; (i < WARMUP_ITERATIONS) && isFinished; i++) {
+            isFinished = (runCommand(&shell, line) == 0);
+        }
+        double start = nowMicroseconds();
+        for (int i = 0; (i < iterations) && isFinished; i++) {
+            double before = nowMicroseconds();
+            isFinished = (runCommand(&shell, line) == 0);
+            latencies[i] = nowMicroseconds() - before;
+        }
+        double elapsed = nowMicroseconds() - start;
+        stopShell(&shell);
+        free(shell.output);
+        free(line);
+        if (!isFinished) {
+            hasFailed = 1;
+            break;
+        }
+
+        qsort(latencies, iterations, sizeof(double), compareDoubles);
+        double rate = iterations / (elapsed / 1e6);
+        double p50 = latencies[(iterations - 1) * 50 / 100];
+        double p99 = latencies[(iterations - 1) * 99 / 100];
+        printf("%-18s %9.0f cmds/sec   p50 %8.1f us   p99 %8.1f us\n", scenarios[s].name, rate, p50, p99);
+        fprintf(results, "%s    {\"name\": \"%s\", \"commands_per_sec\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f}",
+                s == 0 ? "" : ",\n", scenarios[s].name, rate, p50, p99);
+    }
+    fprintf(results, "\n  ]\n}\n");
+    fclose(results);
+
+    // Removing the work directory with the files the scenarios have created
+    const char *files[] = {"out.txt", "append.txt", "reverse.txt", "hash.txt", "alias_config_file.txt", "temp_file.txt", "history.txt", NULL};
+    for (int i = 0; files[i] != NULL; i++) {
+        unlink(files[i]);
+    }
+    if (chdir("/") == 0) {
+        rmdir(workDirectory);
+    }
+    free(latencies);
+    free(longLine);
+    free(shellBinary);
+    if (hasFailed) {
+        return 1;
+    }
+    printf("Results written to %s\n", resultsFile);
+    return 0;
+}
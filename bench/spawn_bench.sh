@@ -0,0 +1,51 @@
+#!/bin/bash
+# Compares the process launch backends of myshell (fork, posix_spawn and the zygote) by running
+# the same batch of commands through the shell with each of them, and prints commands/sec.
+# The shell is run once with a small and once with a large alias table, as page-table copying
+# makes fork slower while the shell's memory grows.
+#
+# Usage: bench/spawn_bench.sh [number of commands] [number of aliases for the large run]
+
+SHELL_BINARY="$(cd "$(dirname "$0")/.." && pwd)/myshell"
+COMMANDS=${1:-2000}
+ALIASES=${2:-200000}
+
+if [ ! -x "$SHELL_BINARY" ]; then
+    echo "Build myshell first (make)" >&2
+    exit 1
+fi
+
+WORK_DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$WORK_DIRECTORY"' EXIT
+cd "$WORK_DIRECTORY" || exit 1
+
+# The batch of commands: plain spawns and redirections (true is a builtin of the shell, its
+# path is given so it is launched like any other command)
+for ((i = 0; i < COMMANDS; i++)); do
+    case $((i % 3)) in
+        0) echo "/bin/true" ;;
+        1) echo "echo $i > out.txt" ;;
+        2) echo "echo $i >> out.txt" ;;
+    esac
+done > commands.txt
+
+# Runs the batch with the given backend (and MYSHELL_ZYGOTE set to the second argument), prints commands/sec
+run() {
+    local start end
+    start=$(date +%s%N)
+    MYSHELL_SPAWN=$1 MYSHELL_ZYGOTE=${2:-0} "$SHELL_BINARY" < commands.txt > /dev/null 2>&1
+    end=$(date +%s%N)
+    awk -v n="$COMMANDS" -v ns=$((end - start)) 'BEGIN { printf "%.0f", n / (ns / 1e9) }'
+}
+
+for size in small large; do
+    rm -f alias_config_file.txt
+    if [ "$size" = large ]; then
+        for ((i = 0; i < ALIASES; i++)); do echo "bench_alias_$i=echo $i"; done > alias_config_file.txt
+        echo "bench_alias_0" > first.txt && cat first.txt commands.txt > with_aliases.txt && mv with_aliases.txt commands.txt
+    fi
+    fork_rate=$(run fork)
+    spawn_rate=$(run posix_spawn)
+    zygote_rate=$(run posix_spawn 1)
+    printf "%-6s alias table: fork %8s cmds/sec, posix_spawn %8s cmds/sec, zygote %8s cmds/sec\n" "$size" "$fork_rate" "$spawn_rate" "$zygote_rate"
+done
@@ -1,1073 +1,8571 @@
-/** Including necessary .h files **/
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/wait.h>
-#include <time.h>
-#include <signal.h>
-
-/** Function prototypes **/
-int parser(char* input);
-int spawn (char* program, char** arg_list);
-int isInPath(const char *token);
-void removeQuotes(char *str);
-
-/** Global variables **/
-char lastlyExecutedCommand[255] = ""; // Our "lastly executed command" (will be explained in more detail later)
-int numOfTotal = 0; // Number of total process spawned (terminated or not) (excluding main process)
-int numOfReaped = 0; // Number of total processes reaped
-int *reaPointer = &numOfReaped; // Pointer to the above variable, details will be given
-int error; // An integer error flag. 1 indicates error, 0 indicates non-error
-
-/** Our helping functions **/
-// As its name shows, it removes the first and last quotes of a string input str
-void removeQuotes(char *str) {
-    char *src = str, *dst = str;
-    while (*src) {
-        if ((*src != '"') || ((*src == '"')&&(src!=str)&&(*(src+1) != '\0'))) {
-            *dst = *src;
-            dst++;
-        }
-        src++;
-    }
-    *dst = '\0';  // Null-terminate the modified string
-}
-// Creates a child process, executes a program with the given argument list,
-// which are given in the parameters of the function
-int spawn (char* program, char** arg_list) {
-    // Forking the parent, creating a child
-    pid_t child_pid;
-    child_pid = fork ();
-    if (child_pid != 0) {
-        // Parent enters here
-        int status; // Success-failure status of our child process
-        /* This is the parent process. It waits for the child and returns child's id */
-        waitpid(child_pid, &status, 0);
-
-        // Check if the child process exited abnormally
-        if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-            fprintf(stderr, "Child process could not be executed successfully\n"); // Setting error message
-            error = 1; // Setting error flag
-            (*reaPointer) -= 1; // Temporary decrease for the below increase case
-        }
-        (*reaPointer) += 1; // Increasing the number of reaped processes by 1 in no error case, else do not increment
-        return child_pid;
-    }
-    else {
-        // This is the child process, which executes the program
-        if (execvp(program, arg_list) == -1) {
-            /* The execvp function returns only if an error occurs.  */
-            // Writing an error message and abort
-            fprintf (stderr, "An error occurred in execvp\n");
-            abort ();
-        }
-    }
-}
-// Checks whether a command in inside the path or not (excluding bello command)
-int isInPath(const char *token) {
-    char *path = getenv("PATH"); // Getting the path environment variable
-
-    // If path is null, return error, set error flag and corresponding error message
-    if (path == NULL) {fprintf(stderr, "PATH environment variable not found\n");error=1;return 0;}
-
-    // Copying the path and taking the part before first :
-    char *pathCopy = strdup(path);
-    char *pathToken = strtok(pathCopy, ":");
-
-    // Searching the command in the path, if found return 1, otherwise it gets out of the while loop
-    // During and after the procedure, we also need to deallocate the allocated memory spaces as well
-    while (pathToken != NULL) {
-        char *executablePath = malloc(strlen(pathToken) + strlen(token) + 2);
-        strcpy(executablePath, pathToken);
-        strcat(executablePath, "/");
-        strcat(executablePath, token);
-
-        // Command found in the path
-        if (access(executablePath, X_OK) == 0) {
-            //printf("%s found in PATH\n", token);
-            free(executablePath);
-            free(pathCopy);
-            return 1;
-        }
-        free(executablePath);
-        pathToken = strtok(NULL, ":");
-    }
-    free(pathCopy);
-    // In case of bello, no need to give error, as it is an exceptional case
-    // If it is not bello and not found in the path, follow the similar error procedures as before
-    // (Indeed, bello is not in our path, but we don't want this function to print error
-    // each time we run a bello command. That's the reason why we are doing this exception)
-    if (strcmp(token,"bello") != 0) {
-        fprintf(stderr, "Error: '%s' not found in the PATH\n", token);
-        error = 1;
-        return 0;
-    }
-}
-/** Our main function **/
-int main() {
-
-    while (1) {
-        // Initializing strings which are holding our input and hostname
-        char userInput[1024];
-        char hostName[1024];
-
-        // This just creates the alias_config_file
-        FILE *first = fopen("alias_config_file.txt", "a");
-        fclose(first);
-
-        // Getting the hostname and corresponding error procedures in case of an error
-        if (gethostname(hostName, sizeof(hostName)) != 0) {
-            perror("Error getting hostname");
-            error = 1;
-            return 1;
-        }
-
-        // Printing the prompt
-        printf("%s@%s %s --- ", getenv("USER"), hostName, getenv("PWD"));
-
-        // Taking the input from the user, if exit signal, then terminate the shell
-        if (fgets(userInput, sizeof(userInput), stdin) == NULL) {
-            break;
-        }
-
-        // Remove the newline character, if exists
-        userInput[strcspn(userInput, "\n")] = '\0';
-
-        // Our key function which takes the input, parses it and does
-        // the corresponding tasks. Details will be explained
-        parser(userInput);
-
-        // Only the last "successfully" executed command will be
-        // written to the "lastly executed command" string. This part
-        // of the code handles the input error cases
-        if (error == 0) {
-            strcpy(lastlyExecutedCommand,userInput);
-        }
-        if (error == 1) {
-            printf("!Error occured!\n");
-            (*reaPointer)++; // Increasing the number of reaped processes by 1
-        }
-
-    }
-    return 0;
-}
-
-/** Our key function. Takes the input, parses it into tokens **/
-/** and does the corresponding executions inside. In case of error **/
-/** it also handles according error procedures as well. **/
-int parser(char* input) {
-    error = 0; // Initialized error flag
-    char* tokens[255]; // List of tokens
-    int index = 0; // Will declare the ending index (which has \0) of our input string, initialized as 0
-    char partofString[1024] = ""; // The temporary token holder string. Details will be explained
-    int indexOfFirstQuotation = -1; // Index of the first quotation mark, if not exists, initialized as -1
-    int indexOfLastQuotation = -1; // Index of the last quotation mark, if not exists, initialized as -1
-    int areWeInString; // Checks if we are inside a string while reading the input.
-    // 0 = we are not inside a string, 1 = we are inside a string
-    int stillWhiteSpace = 0; // Checks if we are still reading a whitespace inside the input
-
-    // Checking the (background) zombie processes, reaps them and increase the number of
-    // reaped processes by 1 each time we reap a zombie process
-    pid_t terminated_child;
-    while ((terminated_child = waitpid(-1, NULL, WNOHANG)) > 0) {
-        (*reaPointer) += 1;
-    }
-
-    // Fixing the PATH environment variable, in order to prevent possible errors
-    char* path = getenv("PATH");
-    setenv("PATH", path, 1);
-
-    for (int i=0;i <= strlen(input); i++) {if (input[i] == '"') {indexOfFirstQuotation = i;break;}}
-    for (int i= strlen(input);i >= 0; i--) {if (input[i] == '"') {indexOfLastQuotation = i;break;}}
-
-    // If quotes do not match, give error
-    if (indexOfFirstQuotation==indexOfLastQuotation && indexOfFirstQuotation != -1) {
-        for (int j = 0; j < index; j++) {
-            free(tokens[j]); // Freeing the tokens
-        }
-        error = 1; // Setting the error flag
-        printf("%s\n", "Outside string error!"); // Corresponding error message
-        return 1;
-    }
-
-    // Reading the input and parsing it accordingly
-    for (int i = 0; i <= strlen(input); i++) {
-        char ch = input[i];
-        if (indexOfFirstQuotation <= i && i <= indexOfLastQuotation) {areWeInString=1;} else {areWeInString=0;}
-
-        // We are at the end of our input
-        if (ch == '\0') {
-            // Still inside a string -> ERROR!
-            if (areWeInString==1) {
-                for (int j = 0; j < index; j++) {
-                    free(tokens[j]); // Freeing the tokens
-                }
-                error = 1; // Setting the error flag
-                printf("%s\n", "Inside string error!"); // Corresponding error message
-            }
-            // Graceful ending
-            else {
-                // If the end is not consecutive whitespace
-                if (!stillWhiteSpace) {
-                    tokens[index] = strdup(partofString);
-                    index++;
-                    strcpy(partofString, "");
-                    tokens[index] = NULL;
-                }
-                // If the end is "still whitespace"
-                else {
-                    tokens[index] = NULL;
-                }
-
-                /** F.d.p (for debugging purposes) **/
-                //for (int j = 0; j < index; j++) {
-                //    printf("Token %d is %s\n", j, tokens[j]);
-                //}
-                continue;
-            }
-        }
-
-        // We are at a whitespace which is not inside a string
-        if ((ch == ' ') && (areWeInString == 0)) {
-            // Still whitespace
-            if (stillWhiteSpace) {
-                continue;
-            }
-            // Not consecutive whitespace
-            stillWhiteSpace = 1;
-            tokens[index] = strdup(partofString);
-            index++;
-            strcpy(partofString, "");
-            continue;
-        }
-
-        // Double quotation mark
-        if (ch == '"') {
-            if (input[i-1] == '=') {
-                stillWhiteSpace = 0;
-                tokens[index] = strdup(partofString);
-                index++;
-                strcpy(partofString, "");
-                strncat(partofString, &ch, 1);
-                continue;
-            }
-            else {
-                stillWhiteSpace = 0;
-                strncat(partofString, &ch, 1);
-                continue;
-            }
-        }
-        // Equality symbol, but the previous is not a space
-        if ((ch == '=')&&(input[i-1] != ' ')) {
-            stillWhiteSpace = 0;
-            tokens[index] = strdup(partofString);
-            index++;
-            strcpy(partofString, "=");
-        }
-        // The remaining general cases, like usual characters, numbers, letters, etc.
-        else {
-            if (input[i-1] == '=') {
-                stillWhiteSpace = 0;
-                tokens[index] = strdup(partofString);
-                index++;
-                strcpy(partofString, "");
-                strncat(partofString, &ch, 1);
-                continue;
-            }
-            else {
-                stillWhiteSpace = 0;
-                strncat(partofString, &ch, 1);
-                continue;
-            }
-        }
-    }
-
-    // If an error occurs in the parsing part, do not do any execution
-    // just exit the function by returning 1 immediately
-    if (error == 1) {
-        return 1;
-    }
-
-    /** The parsing part has finished, the rest belongs to the execution **/
-    // Indexes of >,>>,>>>,& (if not exist in the input, initialized as -1)
-    int indexOfBackground = -1;
-    int indexOfRedirection = -1;
-    int indexOfAppend = -1;
-    int indexOfReverseAppend = -1;
-
-    // Checking these indexes
-    for (int a = 0; a<index; a++) {
-        if (strcmp(tokens[a], "&") == 0) {indexOfBackground = a; continue;}
-        if (strcmp(tokens[a], ">") == 0) {indexOfRedirection = a; continue;}
-        if (strcmp(tokens[a], ">>") == 0) {indexOfAppend = a; continue;}
-        if (strcmp(tokens[a], ">>>") == 0) {indexOfReverseAppend = a; continue;}
-    }
-    /** If we do not write anything, do nothing , just open a new prompt **/
-    if (strcmp(tokens[0], "") == 0) {
-        return 0;
-    }
-    /** If the first command is exit, the rest is unimportant, just get out of the program **/
-    if (strcmp(tokens[0], "exit") == 0) {
-        exit(1);
-    }
-    // A flag which checks if we have entered any of these below cases, will be used later on
-    int hasEnteredYet = 0;
-    /** Bello case (one token which is bello) **/
-    if ((strcmp(tokens[0], "bello") == 0) && (index == 1)) {
-        hasEnteredYet = 1; // Setting the flag
-
-        // Opening bello.txt, the contents of bello will be stored in this file
-        FILE* bello = fopen("bello.txt", "w");
-
-        // Checking possible errors
-        if (bello == NULL) {
-            perror("Error opening output.txt");
-            return 1;
-        }
-
-        /** The required information inside bello are below **/
-
-        /** Username **/
-        fprintf(bello, "%s\n", getenv("USER"));
-
-        /** Hostname **/
-        char hostName[255];
-        if (gethostname(hostName, sizeof(hostName)) != 0) {
-            perror("Error getting hostname");
-            error = 1;
-            return 1;
-        }
-        fprintf(bello, "%s\n", hostName);
-
-        /** Last executed command **/
-        fprintf(bello, "%s\n", lastlyExecutedCommand);
-
-        /** TTY **/
-        char *terminal_name = ttyname(0);
-        if (terminal_name != NULL) {
-            fprintf(bello, "%s\n", terminal_name);
-        }
-        else {
-            perror("Error getting terminal name");
-            error = 1;
-            return EXIT_FAILURE;
-        }
-
-        /** Current shell name **/
-        fprintf(bello, "%s\n", getenv("SHELL"));
-
-        /** Home location **/
-        fprintf(bello, "%s\n", getenv("HOME"));
-
-        /** Current time and date **/
-        time_t current_time;
-        current_time = time(NULL);
-        char* time_string = ctime(&current_time);
-        fprintf(bello, "%s", time_string);
-
-        /** Current number of processes being executed (will be modified) **/
-        fprintf(bello, "%d\n", numOfTotal-(*reaPointer)+1);
-
-        /** The required information inside bello are above **/
-
-        // Close bello.txt
-        fclose(bello);
-
-        // Opening bello.txt once again, the contents of bello.txt are in this file
-        int bello_descriptor = open("bello.txt", O_RDONLY);
-
-        // Check for errors in opening the file
-        if (bello_descriptor == -1) {
-            perror("Error opening bello.txt");
-            exit(EXIT_FAILURE);
-        }
-
-        // Read and write the contents of bello.txt to the standard output
-        char readLine[1024];
-        ssize_t bytesRead;
-        while ((bytesRead = read(bello_descriptor, readLine, sizeof(readLine))) > 0) {
-            // Writing the contents onto stdout, 1 is the file descriptor of the standard output
-            write(1, readLine, bytesRead);
-        }
-
-        // Close the file descriptor for reading
-        close(bello_descriptor);
-
-        return 0;
-    }
-
-    /** "Assigning alias" case **/
-    if (strcmp(tokens[0], "alias") == 0) {
-        hasEnteredYet = 1; // Setting the flag
-        // Checks if that variable has already been defined as an alias of some command
-        int isAlreadyDefined = 0;
-
-        // Extracting key and value, removing their possible quotes
-        char* variable = tokens[1];
-        char* value = tokens[3];
-
-        removeQuotes(variable);
-        removeQuotes(value);
-
-        // Alias configuration file opened in read mode
-        // All aliases and their corresponding commands are stored in this file
-        FILE *alias_config_file = fopen("alias_config_file.txt", "r");
-        // Error check
-        if (alias_config_file == NULL) {
-            perror("Error opening the file");
-            error = 1;
-            return 1;
-        }
-
-        // Alias configuration file opened in write mode
-        FILE *temp_file = fopen("temp_file.txt", "w");
-        // Error check
-        if (temp_file == NULL) {
-            perror("Error opening the file");
-            error = 1;
-            fclose(alias_config_file);
-            return 1;
-        }
-
-        // Reading the aliases' variable name (serves as a "key")
-        // and its corresponding command (serves as a "variable")
-        char alias_key_value[256];
-
-        // Iterating through the file to find the aliased command
-        while (fgets(alias_key_value, sizeof(alias_key_value), alias_config_file) != NULL) {
-            // Create a copy of the line to tokenize
-            char lineCopy[256];
-            strcpy(lineCopy, alias_key_value);
-            // Variable name being read
-            char *readVariable = strtok(lineCopy, "=");
-            removeQuotes(readVariable);
-            // Checking whether the variable has already been written before
-            if (strcmp(readVariable, tokens[1]) == 0) {
-                isAlreadyDefined = 1;
-                fprintf(temp_file, "%s=%s\n", tokens[1], tokens[3]);
-            } else {
-                fprintf(temp_file, "%s", alias_key_value);
-            }
-        }
-        // If it is a new variable, just add it at the end of the alias_config_file.txt
-        if (!isAlreadyDefined) {
-            fprintf(temp_file, "%s=%s\n", tokens[1], tokens[3]);
-        }
-
-        // Close the files
-        fclose(temp_file);
-        fclose(alias_config_file);
-
-        // Replace the original file with the temporary file
-        if (rename("temp_file.txt", "alias_config_file.txt") != 0) {
-            perror("Error renaming file");
-            error = 1;
-            return 1;
-        }
-        return 0;
-    }
-
-
-    /** Executing the aliased command **/
-    // Alias configuration file opened in read mode
-    FILE *alias_config_file = fopen("alias_config_file.txt", "rw");
-    // Error check
-    if (alias_config_file == NULL) {
-        perror("Error opening the file");
-        error = 1;
-        return 1;
-    }
-
-    char lineBeingRead[256]; // As its name says, buffer for lines being read through the below while loop
-    // Iterating through the file to find the aliased command
-    while (fgets(lineBeingRead, sizeof(lineBeingRead), alias_config_file) != NULL) {
-        // Create a copy of the line to tokenize
-        char lineCopy[256];
-        strcpy(lineCopy, lineBeingRead);
-
-        // Variable name being read
-        char *readVariable = strtok(lineCopy, "=");
-        removeQuotes(readVariable);
-
-        // Meaning our command is aliased, just execute the command
-        if (strcmp(readVariable, tokens[0]) == 0) {
-            hasEnteredYet = 1;
-
-            // The command which will be executed
-            char *storedCommand = strtok(NULL, "=");
-            if (storedCommand != NULL) {
-                // Remove the newline character from the storedCommand
-                size_t len = strlen(storedCommand);
-                if (len > 0 && storedCommand[len - 1] == '\n') {
-                    storedCommand[len - 1] = '\0';
-                }
-                // Closing the alias_config_file
-                fclose(alias_config_file);
-
-                // Adding the rest arguments for the alias
-                int totalLength = 0;
-                for (int a = 0; a < index; a++) {
-                    if (a == 0) {
-                        totalLength += strlen(storedCommand);
-                    } else {
-                        totalLength += strlen(tokens[a]) + 1;
-                    }
-                }
-
-                // Dynamically allocate memory for wrappedCommand, which is the replaced version
-                // of the stored command, where the alias key is changed with alias value
-                char *wrappedCommand = (char *)malloc(totalLength + 1); // +1 for null terminator
-
-                // Handle memory allocation failure
-                if (wrappedCommand == NULL) {
-                    fprintf(stderr, "Memory allocation failed\n");
-                    error = 1;
-                    exit(EXIT_FAILURE);
-                }
-
-                // Initialize the memory to avoid undefined behavior
-                wrappedCommand[0] = '\0';
-
-                // Wrapping up the command stored inside alias
-                for (int b = 0; b < index; b++) {
-                    if (b == 0) {
-                        strcat(wrappedCommand, storedCommand);
-                        strcat(wrappedCommand, " ");
-                    } else {
-                        strcat(wrappedCommand, tokens[b]);
-                        if (b < index - 1) {
-                            strcat(wrappedCommand, " ");
-                        } else {
-                            // Do nothing
-                        }
-                    }
-                }
-
-                // Removing the possible quotes from the wrapped command
-                removeQuotes(wrappedCommand);
-                // Sending the wrapped command to parser function
-                parser(wrappedCommand);
-
-                // Deallocating the allocated memory
-                free(wrappedCommand);
-            }
-        }
-    }
-
-    // If we had already entered any of the before cases, which was stored
-    // as our flag haEnteredYet, we do not need to enter this part. Otherwise,
-    // we go into this execution part
-    if (!hasEnteredYet) {
-        /** We don't have a background process **/
-        if (indexOfBackground == -1) {
-            /** No > >> >>> operations, directly execute the command **/
-            if ((indexOfRedirection == -1) && (indexOfAppend == -1) && (indexOfReverseAppend == -1)) {
-                numOfTotal += 1; // Increasing the total number of processes by 1
-                if (isInPath(tokens[0])) {
-                    // Creating args array
-                    char *args[index + 1];
-                    for (int b = 0; b < index + 1; b++) { args[b] = tokens[b]; }
-                    // Spawn the execution
-                    spawn(tokens[0], args);
-                }
-            }
-            /** > case **/
-            if (indexOfRedirection != -1) {
-                if ((isInPath(tokens[0])) || (strcmp(tokens[0],"bello") == 0)) {
-                    numOfTotal += 1; // Increasing the total number of processes by 1
-                    // Creating args array
-                    char *args[indexOfRedirection + 1];
-                    for (int b = 0; b < indexOfRedirection + 1; b++) {
-                        if (b != indexOfRedirection) { args[b] = tokens[b]; }
-                        else { args[b] = NULL; }
-                    }
-                    // Spawn, but manually
-                    pid_t child_pid;
-                    child_pid = fork(); // Forking the parent, creating a child
-                    if (child_pid != 0) {
-                        // Parent enters here
-                        int status; // Success-failure status of our child process
-                        waitpid(child_pid,&status, 0); // Waiting for our child process to execute
-
-                        // Check if the child process exited abnormally
-                        if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-                            fprintf(stderr, "Child process could not be executed successfully\n"); // Setting error message
-                            error = 1; // Setting error flag
-                            (*reaPointer) -= 1; // Temporary decrease for the below increase case
-                        }
-                        (*reaPointer) += 1; // Increasing the number of reaped processes by 1 in no error case, else do not increment
-                        return child_pid; // Returns the child pid
-                    } else {
-                        // Child enters here
-                        // File redirection part
-                        int file_descriptor = open(tokens[indexOfRedirection + 1], O_WRONLY | O_CREAT | O_TRUNC,
-                                                   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-                        if (file_descriptor == -1) {
-                            perror("Error opening the file");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-                        if (dup2(file_descriptor, STDOUT_FILENO) == -1) {
-                            perror("Error redirecting standard output");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-                        fflush(stdout);
-                        close(file_descriptor);
-                        // Execution part
-                        // Bello case
-                        if (strcmp(tokens[0],"bello") == 0) {
-                            parser("bello\0");
-                            abort();
-                        }
-                        // Command inside path case
-                        else {
-                            execvp(tokens[0], args);
-                            fprintf(stderr, "An error occurred in execvp\n");
-                            error = 1;
-                            abort();
-                        }
-                    }
-                }
-            }
-            /** >> case **/
-            if (indexOfAppend != -1) {
-                if ((isInPath(tokens[0])) || (strcmp(tokens[0],"bello") == 0)) {
-                    numOfTotal += 1; // Increasing the total number of processes by 1
-                    // Creating args array
-                    char *args[indexOfAppend + 1];
-                    for (int b = 0; b < indexOfAppend + 1; b++) {
-                        if (b != indexOfAppend) { args[b] = tokens[b]; }
-                        else { args[b] = NULL; }
-                    }
-                    // Spawn, but manually
-                    pid_t child_pid;
-                    // Forking the parent, creating a child
-                    child_pid = fork();
-                    if (child_pid != 0) {
-                        // Parent enters here
-                        int status; // Success-failure status of our child process
-                        waitpid(child_pid,&status, 0); // Waiting for our child process to execute
-
-                        // Check if the child process exited abnormally
-                        if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-                            fprintf(stderr, "Child process could not be executed successfully\n"); // Setting error message
-                            error = 1; // Setting error flag
-                            (*reaPointer) -= 1; // Temporary decrease for the below increase case
-                        }
-                        (*reaPointer) += 1; // Increasing the number of reaped processes by 1 in no error case, else do not increment
-                        return child_pid; // Returns the child pid
-                    } else {
-                        // Child enters here
-                        // File descriptor part
-                        int file_descriptor = open(tokens[indexOfAppend + 1], O_WRONLY | O_CREAT | O_APPEND,
-                                                   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-                        if (file_descriptor == -1) {
-                            perror("Error opening the file");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-                        if (dup2(file_descriptor, STDOUT_FILENO) == -1) {
-                            perror("Error redirecting standard output");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-                        fflush(stdout);
-                        close(file_descriptor);
-                        // Execution part
-                        // Bello case
-                        if (strcmp(tokens[0],"bello") == 0) {
-                            parser("bello\0");
-                            abort();
-                        }
-                        // Command inside the path case
-                        else {
-                            execvp(tokens[0], args);
-                            fprintf(stderr, "An error occurred in execvp\n");
-                            error = 1;
-                            abort();
-                        }
-                    }
-                }
-            }
-            /** >>> case **/
-            if (indexOfReverseAppend != -1) {
-                if ((isInPath(tokens[0])) || (strcmp(tokens[0],"bello") == 0)) {
-                    numOfTotal += 1; // Increasing the total number of processes by 1
-                    // Creating args array
-                    char *args[indexOfReverseAppend + 1];
-                    for (int b = 0; b < indexOfReverseAppend + 1; b++) {
-                        if (b != indexOfReverseAppend) { args[b] = tokens[b]; }
-                        else { args[b] = NULL; }
-                    }
-                    // Our pipe for redirections, and a pid_t
-                    // 0 = read , 1 = write
-                    int fd[2];
-                    pid_t child_pid;
-                    // Checking if the pipe has properly created
-                    if (pipe(fd) == -1) {
-                        fprintf(stderr, "Pipe Failed");
-                        return 1;
-                    }
-                    // Forking the parent, creating a child
-                    child_pid = fork();
-                    // In case of fork error
-                    if (child_pid < 0) {fprintf(stderr, "fork Failed");error=1;return 1;}
-
-                    // Parent process
-                    else if (child_pid > 0) {
-                        // Parent enters here
-                        int status; // Success-failure status of our child process
-                        waitpid(child_pid,&status, 0); // Waiting for our child process to execute
-
-                        // Check if the child process exited abnormally
-                        if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-                            fprintf(stderr, "Child process could not be executed successfully\n"); // Setting error message
-                            error = 1; // Setting error flag
-                            (*reaPointer) -= 1; // Temporary decrease for the below increase case
-                        }
-                        (*reaPointer) += 1; // Increasing the number of reaped processes by 1 in no error case, else do not increment
-
-                        // Reads the pipe and stores it in a buffer
-                        close(fd[1]); // Closes the writing end of the pipe
-                        /** Is this capacity enough? **/
-                        char output_str[1024]; // Buffer for output string
-                        ssize_t bytesRead = read(fd[0], output_str, sizeof(output_str) - 1);
-
-                        if (bytesRead == -1) {
-                            perror("Error reading from pipe");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-
-                        // Closes the reading end of the pipe
-                        close(fd[0]);
-
-                        // Reverses the read part from the pipe
-                        char reversed_output[1024];
-                        for (ssize_t iter = bytesRead-2; iter>= 0; iter--) {
-                            reversed_output[bytesRead-2-iter] = output_str[iter];
-                        }
-                        reversed_output[bytesRead-1] = '\n';
-                        reversed_output[bytesRead] = '\0'; // Null-terminate the reversed output
-
-                        // Appends the reversed string to the destination file
-                        // File descriptor part
-                        int file_descriptor = open(tokens[indexOfReverseAppend + 1], O_WRONLY | O_CREAT | O_APPEND,
-                                                   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-                        if (file_descriptor == -1) {
-                            perror("Error opening the file");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-
-                        // Writing to the file, closing the file, exiting
-                        write(file_descriptor, reversed_output, bytesRead); // Write only the actual reversed data
-                        close(file_descriptor);
-
-                        return child_pid;
-                    }
-
-                    // Child process enters here
-                    else {
-                        // Takes the output of the command and redirects it to the pipe
-                        close(fd[0]); // Closes the reading end of the pipe
-                        // Checks pipe writing errors
-                        if (dup2(fd[1], STDOUT_FILENO) == -1) {
-                            perror("Error redirecting standard output");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-                        // Closes the writing end of the pipe
-                        close(fd[1]);
-
-                        // Execution part
-                        // Bello case
-                        if (strcmp(tokens[0],"bello") == 0) {
-                            parser("bello\0");
-                            abort();
-                        }
-                        // Command inside the path case
-                        else {
-                            execvp(tokens[0], args);
-                            fprintf(stderr, "An error occurred in execvp\n");
-                            error = 1;
-                            abort();
-                        }
-                    }
-                }
-            }
-            return 0;
-        }
-        /** We have a background process **/
-        else {
-            /** No > >> >>> operations, directly execute the command **/
-            if ((indexOfRedirection == -1) && (indexOfAppend == -1) && (indexOfReverseAppend == -1)) {
-                if ((isInPath(tokens[0])) || (strcmp(tokens[0],"bello") == 0)) {
-                    // Forking the parent, creating a child
-                    numOfTotal += 1; // Increasing the total number of processes by 1
-                    pid_t child_pid_1;
-                    child_pid_1 = fork();
-                    if (child_pid_1 > 0) {
-                        // Parent sleeps for 1 second, then returns child_pid_1
-                        sleep(1); // This part is added in order to avoid "race conditions"
-                        return child_pid_1;
-                    }
-                    // Parent won't enter this, but child enters
-                    if (child_pid_1 == 0) {
-                        // Creating args array
-                        char *args[index];
-                        for (int b = 0; b < index; b++) {
-                            if (b != index - 1) {
-                                args[b] = tokens[b];
-                            } else {
-                                args[b] = NULL;
-                            }
-                        }
-                        // Execution part
-                        // Bello case
-                        if (strcmp(tokens[0],"bello") == 0) {
-                            parser("bello\0");
-                            abort();
-                        }
-                        // Command inside the path case
-                        else {
-                            execvp(tokens[0], args);
-                            fprintf(stderr, "An error occurred in execvp\n");
-                            error = 1;
-                            abort();
-                        }
-                    }
-                }
-            }
-            /** > case **/
-            if (indexOfRedirection != -1) {
-                if ((isInPath(tokens[0])) || (strcmp(tokens[0],"bello") == 0)) {
-                    // Forking the parent, creating a child
-                    numOfTotal += 1; // Increasing the total number of processes by 1
-                    pid_t child_pid_1;
-                    child_pid_1 = fork();
-                    // Parent enters
-                    if (child_pid_1 > 0) {
-                        // Parent sleeps for 1 second, then returns child_pid_1
-                        sleep(1); // This part is added in order to avoid "race conditions"
-                        return child_pid_1;
-                    }
-                    // Parent won't enter this, but child enters
-                    if (child_pid_1 == 0) {
-                        // Creating args array
-                        char *args[index - 2];
-                        for (int b = 0; b < index - 2; b++) {
-                            if (b != index - 3) {
-                                args[b] = tokens[b];
-                            } else {
-                                args[b] = NULL;
-                            }
-                        }
-                        // File descriptor part (write mode)
-                        int file_descriptor = open(tokens[indexOfRedirection + 1], O_WRONLY | O_CREAT | O_TRUNC,
-                                                   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-                        if (file_descriptor == -1) {
-                            perror("Error opening the file");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-                        if (dup2(file_descriptor, STDOUT_FILENO) == -1) {
-                            perror("Error redirecting standard output");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-                        fflush(stdout);
-                        close(file_descriptor);
-                        // Execution part
-                        // Bello case
-                        if (strcmp(tokens[0],"bello") == 0) {
-                            parser("bello\0");
-                            abort();
-                        }
-                        // Command inside the path case
-                        else {
-                            execvp(tokens[0], args);
-                            fprintf(stderr, "An error occurred in execvp\n");
-                            error = 1;
-                            abort();
-                        }
-                    }
-                }
-            }
-            /** >> case **/
-            if (indexOfAppend != -1) {
-                if ((isInPath(tokens[0])) || (strcmp(tokens[0],"bello") == 0)) {
-                    // Forking the parent, creating a child
-                    numOfTotal += 1; // Increasing the total number of processes by 1
-                    pid_t child_pid_1;
-                    child_pid_1 = fork();
-                    // Parent enters
-                    if (child_pid_1 > 0) {
-                        // Parent sleeps for 1 second, then returns child_pid_1
-                        sleep(1); // This part is added in order to avoid "race conditions"
-                        return child_pid_1;
-                    }
-                    // Parent won't enter this, but child enters
-                    if (child_pid_1 == 0) {
-                        // Creating args array
-                        char *args[index - 2];
-                        for (int b = 0; b < index - 2; b++) {
-                            if (b != index - 3) {
-                                args[b] = tokens[b];
-                            } else {
-                                args[b] = NULL;
-                            }
-                        }
-                        // File descriptor stuff (append mode)
-                        int file_descriptor = open(tokens[indexOfAppend + 1], O_WRONLY | O_CREAT | O_APPEND,
-                                                   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-                        if (file_descriptor == -1) {
-                            perror("Error opening the file");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-                        if (dup2(file_descriptor, STDOUT_FILENO) == -1) {
-                            perror("Error redirecting standard output");
-                            error = 1;
-                            exit(EXIT_FAILURE);
-                        }
-                        fflush(stdout);
-                        close(file_descriptor);
-                        // Execution part
-                        // Bello case
-                        if (strcmp(tokens[0],"bello") == 0) {
-                            parser("bello\0");
-                            abort();
-                        }
-                        // Command inside the path case
-                        else {
-                            execvp(tokens[0], args);
-                            fprintf(stderr, "An error occurred in execvp\n");
-                            error = 1;
-                            abort();
-                        }
-                    }
-                }
-            }
-            /** >>> case **/
-            if (indexOfReverseAppend != -1) {
-                if ((isInPath(tokens[0])) || (strcmp(tokens[0],"bello") == 0)) {
-                    // Forking the parent, creating a child
-                    numOfTotal += 1; // Increasing the total number of processes by 1
-                    pid_t child_pid_1;
-                    child_pid_1 = fork();
-                    // Parent enters
-                    if (child_pid_1 > 0) {
-                        // Parent sleeps for 1 second, then returns child_pid_1
-                        sleep(1); // This part is added in order to avoid "race conditions"
-                        return child_pid_1;
-                    }
-                    // Parent won't enter this, but child enters
-                    if (child_pid_1 == 0) {
-                        // Creating args array
-                        char *args[indexOfReverseAppend + 1];
-                        for (int b = 0; b < indexOfReverseAppend + 1; b++) {
-                            if (b != indexOfReverseAppend) { args[b] = tokens[b]; }
-                            else { args[b] = NULL; }
-                        }
-                        // Our pipe for redirections, and a pid_t
-                        // 0 = read , 1 = write
-                        int fd[2];
-                        pid_t p;
-                        // Checking if the pipe has properly created
-                        if (pipe(fd) == -1) {
-                            fprintf(stderr, "Pipe Failed");
-                            return 1;
-                        }
-                        // Forking the child, creating a grandchild
-                        p = fork();
-                        // In case of fork error
-                        if (p < 0) {fprintf(stderr, "fork Failed");error=1;return 1;}
-
-                        // Child process (parent of grandchild)
-                        else if (p > 0) {
-                            // Child waits for the grandchild
-                            wait(NULL);
-
-                            // Reads the pipe and stores it in a buffer
-                            close(fd[1]); // Closes the writing end of the pipe
-                            char output_str[1024];
-                            ssize_t bytesRead = read(fd[0], output_str, sizeof(output_str) - 1);
-
-                            if (bytesRead == -1) {
-                                perror("Error reading from pipe");
-                                error = 1;
-                                exit(EXIT_FAILURE);
-                            }
-
-                            close(fd[0]); // Closes the reading end of the pipe
-
-                            // Reverses the string at the buffer
-                            char reversed_output[1024];
-                            for (ssize_t iter = bytesRead-2; iter>= 0; iter--) {
-                                reversed_output[bytesRead-2-iter] = output_str[iter];
-                            }
-                            reversed_output[bytesRead-1] = '\n';
-                            reversed_output[bytesRead] = '\0'; // Null-terminate the reversed output
-
-                            // Appends the reversed string to the file
-                            // File descriptor part
-                            int file_descriptor = open(tokens[indexOfReverseAppend + 1], O_WRONLY | O_CREAT | O_APPEND,
-                                                       S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-                            if (file_descriptor == -1) {
-                                perror("Error opening the file");
-                                error = 1;
-                                exit(EXIT_FAILURE);
-                            }
-
-                            // Writing to the file, closing the file, exiting (aborting)
-                            write(file_descriptor, reversed_output, bytesRead); // Write only the actual reversed data
-                            close(file_descriptor);
-
-                            abort();
-                        }
-
-                        // Grandchild process (child of child)
-                        else {
-                            // Takes the output of the command (written at the left of the input), redirects it to the pipe
-                            close(fd[0]); // Closes the reading end of the pipe
-                            // Checks pipe writing errors
-                            if (dup2(fd[1], STDOUT_FILENO) == -1) {
-                                perror("Error redirecting standard output");
-                                error = 1;
-                                exit(EXIT_FAILURE);
-                            }
-                            // Closes the writing end of the pipe
-                            close(fd[1]);
-
-                            // Execution part
-                            // Bello case
-                            if (strcmp(tokens[0],"bello") == 0) {
-                                parser("bello\0");
-                                abort();
-                            }
-                            // Command inside the path case
-                            else {
-                                execvp(tokens[0], args);
-                                fprintf(stderr, "An error occurred in execvp\n");
-                                error = 1;
-                                abort();
-                            }
-                        }
-                        // For double-checking purposes
-                        close(fd[0]); // Closes the reading end of the pipe
-                        close(fd[1]); // Closes the writing end of the pipe
-                    }
-                }
-            }
-            return 0;
-        }
-    }
-    // The end of our parser function
-    return 0;
+/** Including necessary .h files **/
+#define _GNU_SOURCE // For Linux specific calls (CLOCK_MONOTONIC_COARSE, environ, etc.)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/inotify.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <termios.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/** Function prototypes **/
+int parser(char* input);
+struct arena;
+int executeCommand(char** tokens, char* isOperator, int index, char* input, struct arena* arena);
+struct executionPlan;
+int spawn (struct executionPlan* plan, char* commandLine);
+void setPipeSize(int pipeFd);
+void resetChildSignals(sigset_t* childMask);
+struct placement;
+pid_t launchStage(char** arg_list, char* program, int inputFd, int outputFd, int redirectionType, char* fileName, pid_t pgid, int isForeground, sigset_t* childMask, struct placement *placement);
+int isPlaced(struct placement *placement);
+int applyPlacement(struct placement *placement);
+int parseCpuList(const char *list, cpu_set_t *cpus);
+int parseNumber(const char *text, long *value);
+int placementCommand(char **tokens, char *isOperator, int index, char *input, struct arena *arena);
+void startZygote();
+void runZygote(int socketFd);
+struct zygoteRequest;
+struct zygoteReply;
+void zygoteLaunch(struct zygoteRequest *request, char *strings, int inputFd, int outputFd, int socketFd, struct zygoteReply *reply);
+int zygoteChild(void *argument);
+pid_t zygoteSpawnCommand(char** arg_list, char* fullPath, int inputFd, int outputFd, int redirectionType, char* fileName, pid_t pgid, int isForeground, struct placement *placement);
+void execInChild(char* program, char** arg_list, int redirectionType, char* fileName);
+pid_t posixSpawnCommand(char** arg_list, char* fullPath, int inputFd, int outputFd, int redirectionType, char* fileName, pid_t pgid, int isForeground, sigset_t* childMask);
+int isInPath(const char *token);
+void removeQuotes(char *str);
+void *arenaAlloc(struct arena *arena, size_t size);
+void arenaFree(struct arena *arena);
+struct tokenList;
+void pushToken(struct tokenList *list, char *token, char isOperatorToken, struct arena *arena);
+int tokenize(const char *input, struct arena *arena, struct tokenList *list);
+struct globMatcher;
+const char *findSetEnd(const char *set);
+int compileGlob(const char *segment, struct globMatcher *matcher);
+int matchGlob(struct globMatcher *matcher, const char *name);
+struct globMatches;
+void addGlobMatch(struct globMatches *matches, const char *path, size_t length);
+void globDirectory(char *path, size_t pathLength, char **segments, int numOfSegments, int index, struct globMatches *matches);
+int comparePaths(const void *first, const void *second);
+void expandGlob(char *pattern, char *word, struct tokenList *list, struct arena *arena);
+unsigned long hashString(const char *str);
+void clearPathHash();
+void validatePathHash();
+struct trieNode;
+struct pathDirectory;
+struct completion;
+void freeTrie(struct trieNode *node);
+void updateTrie(const char *name, int change);
+void scanPathDirectory(struct pathDirectory *directory, struct timespec modificationTime);
+void refreshCommandTrie();
+void collectTrie(struct trieNode *node, char *name, size_t length, struct completion *completion);
+void addCandidate(struct completion *completion, const char *name, size_t length, const char *suffix);
+void completeCommand(const char *word, struct completion *completion);
+void completePath(const char *word, struct completion *completion);
+int compareCandidates(const void *first, const void *second);
+char *lookupCommand(const char *name);
+void execResolved(char *program, char **arg_list);
+int hashBuiltin(char **tokens, int numOfTokens);
+struct executionPlan *findPlan(const char *line);
+void cachePlan(const char *line, struct executionPlan *plan);
+struct cachedPlan;
+void removePlan(struct cachedPlan *cached);
+void setAlias(const char *key, const char *value);
+void clearAliases();
+void readAliasJournal(FILE *journal);
+void loadAliases();
+void syncAliases();
+void readAliasChanges();
+char *findAlias(const char *key);
+int openAliasFileLocked();
+int compactAliases();
+int appendAlias(const char *key, const char *value);
+int aliasBuiltin(char **tokens, int numOfTokens);
+void reverseBytes(char *dst, const char *src, size_t length);
+int openSpillFile();
+int reverseAppend(int readFd, const char *fileName);
+void initShell(int isInteractive);
+struct jobProcess;
+int watchProcess(pid_t pid);
+void reapProcess(struct jobProcess *process);
+void processChildEvents();
+void waitForChildEvents();
+int hasJobsToReport();
+void markProcessStatus(pid_t pid, int status, struct rusage *usage);
+int addJob(pid_t pgid, pid_t *pids, int numOfProcesses, char *commandLine, int isBackground);
+int hasFreeJob();
+void freeJob(int jobNumber);
+int waitForJob(int jobNumber);
+void describeJob(int jobNumber, const char *state);
+void reportJobs();
+int countLiveProcesses();
+int parseJobSpec(const char *spec);
+int parseSignal(const char *name);
+int listSignals(char **tokens, int numOfTokens);
+int jobsBuiltin(char **tokens, int numOfTokens);
+int fgBuiltin(char **tokens, int numOfTokens);
+int bgBuiltin(char **tokens, int numOfTokens);
+int waitBuiltin(char **tokens, int numOfTokens);
+int killBuiltin(char **tokens, int numOfTokens);
+struct builtin;
+struct builtin *findBuiltin(const char *name);
+int runBuiltin(struct builtin *builtin, char **arguments, int numOfArguments, int redirectionType, char *fileName, int inputType, char *inputSource);
+int runBuiltinWithOutput(struct builtin *builtin, char **arguments, int numOfArguments, int redirectionType, char *fileName);
+int redirectStdin(int inputType, char *inputSource);
+int feedHereString(int pipeFd, const char *text);
+int exitBuiltin(char **tokens, int numOfTokens);
+int belloBuiltin(char **tokens, int numOfTokens);
+int timeCommand(char **tokens, char *isOperator, int index, char *input, struct arena *arena);
+double nowMicroseconds();
+void recordLatency(int phase, double microseconds);
+int statsBuiltin(char **tokens, int numOfTokens);
+int startTracing();
+double traceClock();
+void recordSpan(const char *name, const char *detail, double start, double end);
+void writeTraceRecord(const char *name, const char *detail, double start, double duration, pid_t pid, pid_t tid, int status);
+void writeJsonString(FILE *file, const char *text);
+int dumpTrace(const char *fileName);
+int traceBuiltin(char **tokens, int numOfTokens);
+pid_t launchWorker(char **arg_list, char *fullPath, int inputFd, int outputFd, int errorFd, sigset_t *childMask);
+int copyToFd(int sourceFd, int destinationFd);
+int parallelBuiltin(char **tokens, int numOfTokens);
+int writeAll(int fd, const char *data, size_t length);
+int drainPipe(int pipeFd, int destinationFd, size_t length, int *canSplice);
+int teeBuiltin(char **tokens, int numOfTokens);
+size_t countNewlines(const char *data, size_t length);
+size_t skipLines(const char *data, size_t length, long *numOfLines);
+const char *findString(const char *data, size_t length, const char *pattern, size_t patternLength);
+struct filter;
+struct filter *prepareFilter(char **arguments);
+int parseCutList(struct filter *filter, const char *list);
+int startFilter(struct filter *filter, int inputFd, int outputFd, int redirectionType, char *fileName);
+int finishFilters(struct filter **filters, int numOfFilters, int isStopped);
+void releaseFilter(struct filter *filter);
+void *runFilter(void *argument);
+ssize_t readFilterInput(struct filter *filter, char *buffer, size_t length);
+char *reserveFilterOutput(struct filter *filter, size_t length);
+int emitFilterOutput(struct filter *filter, const char *data, size_t length);
+int flushFilterOutput(struct filter *filter);
+int runHead(struct filter *filter);
+int runTail(struct filter *filter);
+int runTailOfFile(struct filter *filter, off_t size);
+int runWc(struct filter *filter);
+int runLineFilter(struct filter *filter);
+int grepBlock(struct filter *filter, const char *data, size_t length, long *numOfSelected);
+int cutBlock(struct filter *filter, const char *data, size_t length);
+int revBlock(struct filter *filter, const char *data, size_t length);
+int openHistory();
+void resetHistory();
+void syncHistory();
+void indexHistory();
+char *historyEntry(long number, size_t *length);
+long findHistoryEntry(off_t offset);
+long searchHistory(const char *query, long before);
+long addHistory(const char *line);
+char *lastCommand();
+int historyBuiltin(char **tokens, int numOfTokens);
+struct lineEditor;
+void refreshLine(struct lineEditor *editor);
+void replaceLine(struct lineEditor *editor, const char *text, size_t length);
+void completeLine(struct lineEditor *editor);
+int readEditorKey(struct lineEditor *editor);
+char *readInteractiveLine(const char *prompt);
+struct scriptNode;
+struct scriptParser;
+void skipBlanks(struct scriptParser *parser);
+void skipSeparators(struct scriptParser *parser);
+int isWordAt(const char *position, const char *word);
+void scriptSyntaxError(struct scriptParser *parser);
+struct scriptNode *newNode(struct scriptParser *parser, int type);
+char *scanWords(struct scriptParser *parser, const char *stops);
+int expectKeyword(struct scriptParser *parser, const char *keyword);
+size_t scanName(const char *position);
+struct scriptNode *parseList(struct scriptParser *parser, const char **terminators, int isTopLevel);
+struct scriptNode *parseAndOr(struct scriptParser *parser);
+struct scriptNode *parseCommand(struct scriptParser *parser);
+struct scriptNode *parseSimpleCommand(struct scriptParser *parser);
+struct scriptNode *parseIf(struct scriptParser *parser);
+struct scriptNode *parseLoop(struct scriptParser *parser, int type);
+struct scriptNode *parseFor(struct scriptParser *parser);
+struct scriptNode *parseCase(struct scriptParser *parser);
+struct scriptNode *parseFunctionBody(struct scriptParser *parser, const char *name, size_t nameLength);
+int checkScript(char *text);
+void runScriptText(char *text);
+int runNode(struct scriptNode *node);
+int runCondition(struct scriptNode *node);
+int endsLoop();
+int isInterrupted();
+int runSimpleCommand(char *text);
+int runFor(struct scriptNode *node);
+int runCase(struct scriptNode *node);
+int matchCasePattern(const char *pattern, size_t length, const char *value);
+char *findVariable(const char *name);
+void setVariable(const char *name, const char *value);
+struct function;
+struct function *findFunction(const char *name, size_t length);
+void defineFunction(const char *name, struct scriptNode *body);
+int callFunction(struct function *function, char **arguments, int numOfArguments);
+struct textBuffer;
+void appendText(struct textBuffer *buffer, const char *text, size_t length, int escape);
+void appendParameter(struct textBuffer *buffer, const char *name, size_t length, int escape);
+char *expandText(const char *text, int isRaw);
+long evaluateArithmetic(const char *expression, int *hasFailed);
+struct arithmetic;
+long parseArithmetic(struct arithmetic *arithmetic, int minimumPrecedence);
+long parseArithmeticOperand(struct arithmetic *arithmetic);
+struct testParser;
+int testOr(struct testParser *test);
+int testAnd(struct testParser *test);
+int testPrimary(struct testParser *test);
+int testUnary(const char *operator, const char *operand);
+int testBinary(struct testParser *test, const char *left, const char *operator, const char *right);
+int isTestBinary(const char *operator);
+int testBuiltin(char **tokens, int numOfTokens);
+int trueBuiltin(char **tokens, int numOfTokens);
+int falseBuiltin(char **tokens, int numOfTokens);
+int loopControlBuiltin(char **tokens, int numOfTokens);
+int returnBuiltin(char **tokens, int numOfTokens);
+int runLine(char *line, int isEndOfInput);
+void runTypedLine(const char *line);
+char *readWholeFile(int fd, size_t *length);
+int runBuffer(char *buffer, size_t length);
+int runScript(const char *scriptName);
+struct serveOutput;
+int serveCommands(const char *socketPath);
+int listenOnSocket(const char *socketPath);
+void warmServerCaches();
+void runServeWorker(int clientFd);
+void finishServeWorker();
+void sendServeControl(char type, int status);
+void *forwardServeOutput(void *argument);
+int drainServeOutput(struct serveOutput *output, int fd, char type);
+int readFrame(int fd, char *type, char **payload, uint32_t *length);
+int writeFrame(struct serveOutput *output, char type, const void *payload, uint32_t length);
+int readExactly(int fd, void *buffer, size_t length);
+
+/** Global variables **/
+int error; // An integer error flag. 1 indicates error, 0 indicates non-error
+int lastStatus = 0; // Exit status of the last command line, the exit status of the shell at the end
+extern char **environ; // Environment of the shell, passed as it is to execve
+
+/** Per-command arena and token list **/
+// Everything the tokenizer produces for one command line is allocated from an arena, a chain of
+// large blocks which is freed in one shot once the command has been executed
+#define ARENA_BLOCK_SIZE 4096 // Minimum size of an arena block
+struct arenaBlock {
+    struct arenaBlock *next; // The previously allocated block
+    size_t used; // Bytes of data already handed out
+    size_t capacity; // Size of data
+    char data[]; // The memory itself
+};
+struct arena {
+    struct arenaBlock *head; // The block we are currently allocating from, NULL if none yet
+};
+// The tokens of a command line. Operators (| & > >> >>>) are tokens of their own even without
+// spaces around them, and isOperator tells them apart from the same text inside quotes
+struct tokenList {
+    char **tokens; // The tokens, NULL terminated
+    char *isOperator; // isOperator[i] is 1 if tokens[i] is an unquoted operator
+    int numOfTokens; // Number of tokens
+    int capacity; // Size of the two arrays
+};
+
+/** Glob expansion **/
+// A word with an unquoted * ? or [...] is a pattern, replaced by the (sorted) paths matching it,
+// or kept as it is if nothing matches. A ** segment matches any number of directories. Every
+// segment of the pattern is compiled into a small program for the matcher, and the directories
+// are read with getdents64 into one large buffer, using the types inside the entries so only
+// the entries of an unknown type (or symbolic links which must be followed) are stat'ed
+#define GLOB_BUFFER_SIZE (1 << 20) // Size of the getdents64 buffer
+#define GLOB_PATH_MAX 4096 // Longest path a pattern may produce
+#define GLOB_LITERAL 0 // Operations of the compiled matcher: one given byte
+#define GLOB_ANY 1 // ? any byte
+#define GLOB_STAR 2 // * any number of bytes
+#define GLOB_CLASS 3 // [...] a byte inside a set
+struct globOperation {
+    unsigned char type; // One of the GLOB_ values
+    unsigned char character; // The byte of a GLOB_LITERAL
+    unsigned char set[32]; // The bytes of a GLOB_CLASS, as a bitmap
+};
+struct globMatcher {
+    struct globOperation *operations; // The compiled segment
+    int numOfOperations; // Number of operations
+    int startsWithDot; // 1 if the segment starts with a literal dot, only then it matches hidden names
+};
+struct linuxDirent64 {
+    uint64_t d_ino; // Inode number
+    int64_t d_off; // Offset of the next entry
+    unsigned short d_reclen; // Size of this entry
+    unsigned char d_type; // Type of the file
+    char d_name[]; // Its name, NULL terminated
+};
+struct globMatches {
+    char **paths; // Matched paths (allocated from the arena)
+    size_t numOfPaths; // Number of paths
+    size_t capacity; // Size of paths
+    struct arena *arena; // The arena of the command line
+};
+char *globBuffer = NULL; // The getdents64 buffer, allocated on the first expansion
+int lineIsGlobbed = 0; // 1 if a word of the line being parsed was a pattern, its plan is not cached (the files may change)
+
+#define MAX_ALIAS_DEPTH 16 // How deep aliases may expand into other aliases
+char *aliasesBeingExpanded[MAX_ALIAS_DEPTH]; // Names of the aliases we are expanding right now
+int aliasDepth = 0; // Number of names inside aliasesBeingExpanded
+
+/** PATH hash table, which works like bash's "hash" **/
+// Every command name we have resolved is stored here together with its absolute path,
+// so we do not need to search the PATH directories (and call access() on each of them) again
+#define PATH_HASH_SIZE 256 // Number of buckets of the table (a power of 2)
+struct pathHashEntry {
+    char *name; // Name of the command (serves as a "key")
+    char *fullPath; // Absolute path of the command (serves as a "value")
+    int hits; // How many times this entry has been used, printed by the hash builtin
+    struct pathHashEntry *next; // Next entry inside the same bucket
+};
+struct pathDirectory {
+    char *directory; // One directory of PATH
+    struct timespec modificationTime; // Its last known mtime, a change means a binary was added or removed
+    char **names; // The executables inside it, as they are inside the command trie
+    int numOfNames; // Number of names inside names
+    struct timespec scannedTime; // Its mtime when names was read, tv_nsec is -1 if never read
+};
+struct pathHashEntry *pathHashTable[PATH_HASH_SIZE]; // The buckets of the table
+struct pathDirectory *pathDirectories = NULL; // Directories of PATH, in the order of PATH
+int numOfPathDirectories = 0; // Number of directories inside pathDirectories
+char *hashedPathValue = NULL; // The PATH value our table was built for, NULL if not built yet
+time_t lastPathCheck = 0; // Last time (in seconds, monotonic) we have checked the mtimes of the directories
+
+/** Command trie, used for tab completion **/
+// Every executable inside the PATH directories is inserted into a prefix trie, so the commands
+// starting with a prefix are found by walking the prefix, without listing any directory. A
+// directory is read again only when its mtime has changed, by removing its old names and
+// inserting the new ones. A name inside several directories is counted, not duplicated
+struct trieNode {
+    char character; // The byte leading to this node from its parent
+    int numOfDirectories; // Number of directories having the name ending here, 0 if no name ends here
+    int numOfNames; // Number of names inside this subtree, a subtree without names is skipped
+    struct trieNode *child; // First child, the children are sorted by character
+    struct trieNode *sibling; // Next child of the parent
+};
+struct trieNode *commandTrie = NULL; // Root of the trie, NULL until the first completion
+struct completion {
+    char **candidates; // Words which can replace the word being completed, a directory ends with '/'
+    int numOfCandidates; // Number of words inside candidates
+    int capacity; // Size of candidates
+    size_t displayOffset; // Only the part of a candidate after this offset is listed (its directory is not)
+};
+#define COMPLETION_LIST_LIMIT 200 // More candidates than this are only counted, not listed
+
+/** Alias table **/
+// All aliases are kept in memory, so looking up tokens[0] does not need any file I/O. The
+// alias_config_file.txt is an append-only journal of "key=value" lines (a later line overrides
+// an earlier one), which is compacted once it contains too many overridden lines. Changes made
+// by other shell instances are noticed through inotify and read into the table
+#define ALIAS_FILE "alias_config_file.txt" // The journal file
+#define ALIAS_TEMP_FILE "temp_file.txt" // Temporary file used while compacting the journal
+#define ALIAS_TABLE_INITIAL_SIZE 256 // Initial number of buckets of the table (a power of 2), doubled as it fills
+struct aliasEntry {
+    char *key; // Name of the alias
+    char *value; // The command it stands for
+    struct aliasEntry *next; // Next entry inside the same bucket
+};
+struct aliasEntry **aliasTable = NULL; // The buckets of the table
+size_t aliasTableSize = 0; // Number of buckets, kept at least as large as numOfAliases
+size_t numOfAliases = 0; // Number of distinct aliases inside the table
+size_t numOfJournalLines = 0; // Number of lines inside the journal (overridden ones included)
+int aliasesLoaded = 0; // 1 after the journal has been read for the first time
+off_t aliasFileOffset = 0; // How much of the journal we have already read
+ino_t aliasFileInode = 0; // Inode of the journal we have read, changes when it is compacted
+int aliasInotifyFd = -1; // inotify descriptor watching the directory of the journal, -1 if not available
+
+/** >>> (reverse append) engine **/
+#define REVERSE_MEMORY_LIMIT (1 << 20) // Output up to this size is kept in memory, larger output is spilled to a temp file
+#define REVERSE_CHUNK (1 << 20) // Size of the reversed blocks we append with a single write
+#define CAPTURE_PIPE_SIZE (1 << 20) // Requested pipe buffer size for the >>> capture pipe
+
+/** Process launch backend **/
+// Commands are launched with posix_spawn, which uses clone(CLONE_VM|CLONE_VFORK) and so does not
+// copy our page tables, no matter how large the shell has grown. fork is still used for builtins
+// running outside the shell (they run our own code in the child) and for the background >>>
+// helper. Setting the environment variable MYSHELL_SPAWN=fork before starting the shell makes
+// every launch use fork (for comparison)
+int useForkBackend = 0; // 1 if every launch must use fork
+
+/** Redirection types of a command **/
+#define REDIRECT_NONE 0 // No redirection
+#define REDIRECT_WRITE 1 // > (truncate and write)
+#define REDIRECT_APPEND 2 // >> (append)
+#define REDIRECT_REVERSE 3 // >>> (reverse append)
+#define INPUT_NONE 0 // Input of the first stage is the shell's stdin
+#define INPUT_FILE 1 // < (the file)
+#define INPUT_STRING 2 // <<< (the string and a newline, fed through a pipe)
+
+/** Placement of a job (the pin, nice and ionice prefixes) **/
+// A command line may start with prefixes which place every process of its job: pin (CPU
+// affinity, sched_setaffinity), nice (scheduling priority, setpriority) and ionice (I/O
+// priority, ioprio_set). They are applied inside the child between fork and exec, so no extra
+// program like taskset is executed. With MYSHELL_SPREAD_JOBS=1 set before starting the shell,
+// every background job which is not pinned goes to the next CPU we may run on, round-robin
+#define IOPRIO_CLASS_SHIFT 13 // The I/O priority is its class shifted by this, plus its level
+#define IOPRIO_WHO_PROCESS 1 // ioprio_set target: a single process
+struct placement {
+    int hasCpus; // 1 if the processes are pinned to cpus
+    cpu_set_t cpus; // The CPUs they may run on
+    int niceness; // Added to their nice value (0 means unchanged)
+    int ioPriority; // Their I/O priority (class << IOPRIO_CLASS_SHIFT | level), 0 means unchanged
+};
+struct placement linePlacement; // The placement given by the prefixes of the line being executed
+int spreadBackgroundJobs = 0; // 1 if background jobs are spread over the CPUs (MYSHELL_SPREAD_JOBS=1)
+cpu_set_t shellCpus; // The CPUs the shell may run on, the ones jobs are spread over
+int nextSpreadCpu = 0; // Where the search for the CPU of the next background job starts
+
+/** Zygote **/
+// With MYSHELL_ZYGOTE=1 set before starting the shell, commands are launched by a zygote: a helper
+// forked at startup, while the shell is still small, which never grows. The shell sends it the
+// resolved stage (the absolute path, argv, redirection, placement, and the descriptors of its pipes
+// with SCM_RIGHTS) over a socketpair, so nothing is looked up, forked or copied on our side. It
+// clones the child with CLONE_PARENT, which makes the child ours: it is reaped and controlled like
+// any other. The zygote's environment and working directory are the ones the shell has started
+// with. The working directory never changes, but a script may change an environment variable:
+// from then on the zygote is not used any more (isZygoteStale), as its children would get the old
+// environment. A stage it cannot take (too large a request) is launched as usual
+#define ZYGOTE_MESSAGE_MAX 65536 // Largest request (the header and the strings)
+struct zygoteRequest {
+    pid_t pgid; // Process group of the child, 0 for a new one
+    int isForeground; // 1 if the child takes the terminal
+    int redirectionType; // REDIRECT_NONE, REDIRECT_WRITE or REDIRECT_APPEND
+    int hasInputFd; // 1 if a descriptor for its stdin comes with the request
+    int hasOutputFd; // 1 if one for its stdout comes with it (after the stdin one)
+    int numOfArguments; // Number of strings of its argv
+    struct placement placement; // Applied before exec
+}; // Followed by the program, the file name ("" if none) and the arguments, each NULL terminated
+struct zygoteReply {
+    pid_t pid; // The child, -1 if it could not be created
+    int errorNumber; // errno of what has failed (clone, the redirection or exec), 0 on success
+};
+struct zygoteLaunch {
+    struct zygoteRequest *request; // The request
+    char *program; // Absolute path of the program
+    char *fileName; // File of the redirection ("" if none)
+    char **arguments; // argv, NULL terminated
+    int inputFd; // Descriptor for its stdin, -1 if none
+    int outputFd; // Descriptor for its stdout, -1 if none
+    int socketFd; // The zygote's socket, closed by the child
+    int errorNumber; // Set by the child if it fails before exec
+};
+#define ZYGOTE_STACK_SIZE (256 * 1024) // Stack of a child until it executes its program
+int zygoteFd = -1; // Our end of the zygote's socketpair, -1 if there is no zygote
+int isZygoteStale = 0; // 1 once our environment differs from the zygote's, it launches nothing then
+
+/** Stream filters **/
+// The stages head, tail, wc, grep, cut and rev of a foreground pipeline run on threads of the shell
+// instead of being spawned, as long as their options are ones we implement (otherwise the program
+// of the PATH is launched as usual): head -n/-c N, tail -n [+]N, wc -l or -c, grep [-F] [-v] [-c]
+// with a fixed string, cut -f LIST [-d C] or -b/-c LIST, and rev, each with at most one file
+// operand. Their inner loops are vectorized (with AVX2 where the CPU has it). A thread stage reads
+// and writes the pipes of its neighbours (or the files of < and >) like a process would, and is
+// waited for through an eventfd inside the event loop, so Ctrl-C still stops it. Background and
+// placed jobs, pipelines with a forked builtin and stages reading the terminal keep processes, as
+// a thread could not be stopped, placed, or hidden from a forked child. MYSHELL_FILTERS=0 set
+// before starting the shell turns them off (for comparison)
+#define FILTER_HEAD 0 // Types of the filters
+#define FILTER_TAIL 1
+#define FILTER_WC 2
+#define FILTER_GREP 3
+#define FILTER_CUT 4
+#define FILTER_REV 5
+#define FILTER_BLOCK_SIZE (1 << 17) // Bytes a filter reads at a time
+#define FILTER_OUTPUT_SIZE (1 << 16) // Output a filter collects before writing it
+#define CUT_MAX_FIELD 256 // cut may select fields (or bytes) up to this one, and an open range ("N-") beyond
+struct filter {
+    int type; // One of the FILTER_ values
+    long count; // Lines (or bytes) of head and tail
+    int isFromStart; // 1 for tail -n +N, which starts at line N
+    int countsBytes; // 1 for head -c, wc -c, cut -b and cut -c
+    char *pattern; // The string of grep
+    size_t patternLength; // Its length
+    int isInverted; // 1 for grep -v
+    int isCounting; // 1 for grep -c
+    char delimiter; // The delimiter of cut -f
+    unsigned char selected[CUT_MAX_FIELD + 1]; // selected[n] is 1 if cut selects field (or byte) n
+    long lastSelected; // The last field selected inside selected
+    long openFrom; // cut also selects every field from this one on, 0 if none
+    int isUtf8; // 1 if rev keeps the UTF-8 sequences of a line in order
+    char *fileName; // The file operand (wc prints it), NULL if the stage reads its stdin
+    int inputFd; // Where the stage reads from, owned by its thread
+    int outputFd; // Where the stage writes to, owned by its thread
+    char *output; // Output collected meanwhile
+    size_t outputLength; // Bytes inside output
+    size_t outputCapacity; // Size of output
+    int isCancelled; // Set by the shell on Ctrl-C, the thread stops at its next block
+    int isDone; // Set by the thread once it has closed its descriptors
+    int status; // Exit status of the stage
+    int references; // The thread and the shell, the last one to let go frees the filter
+    pthread_t thread; // The thread running the stage
+};
+const char *filterNames[] = {"head", "tail", "wc", "grep", "cut", "rev", NULL}; // Indexed by the FILTER_ values
+struct tailBlock {
+    char *data; // A block of the input of tail
+    size_t length; // Bytes inside data
+    size_t numOfNewlines; // Newlines inside data
+};
+int useStreamFilters = 1; // 0 if the filters are always spawned as programs (MYSHELL_FILTERS=0)
+int filterEventFd = -1; // eventfd every filter thread writes at its end, watched by childEpollFd
+
+/** Execution plans **/
+// What a command line turns into once it has been tokenized, alias expanded and resolved: the
+// argv of every stage of its pipeline together with the absolute path of its program, the
+// redirection and the background flag. The plans of launched lines are kept in an LRU cache keyed
+// by the raw line, so typing (or looping over) the same line again goes straight to spawn. A
+// cached plan is thrown away once the alias table or the PATH hash table has changed since it was made
+#define PLAN_CACHE_SIZE 128 // Maximum number of cached plans, the least recently used one is evicted
+#define PLAN_HASH_SIZE 256 // Number of buckets of the cache (a power of 2)
+struct executionPlan {
+    char ***stages; // argv of every stage of the pipeline, each NULL terminated
+    char **programs; // Absolute path of the program of every stage (the name itself for a builtin)
+    int numOfStages; // Number of stages
+    int redirectionType; // One of the REDIRECT_ values, applies to the last stage
+    char *fileName; // File of the redirection, NULL if none
+    int isBackground; // 1 if the line ends with &
+    int inputType; // One of the INPUT_ values, applies to the first stage
+    char *inputSource; // File of <, or the string of <<<, NULL if none
+    struct placement placement; // Applied to every stage
+};
+struct cachedPlan {
+    char *line; // The raw command line (serves as a "key")
+    struct executionPlan plan; // Its plan (serves as a "value")
+    struct arena arena; // Owns the line and everything the plan points to
+    unsigned long aliasGeneration; // Value of aliasGeneration when the plan was made
+    unsigned long pathGeneration; // Value of pathGeneration when the plan was made
+    struct cachedPlan *next; // Next plan inside the same bucket
+    struct cachedPlan *newer; // Neighbours inside the LRU list
+    struct cachedPlan *older;
+};
+struct cachedPlan *planHashTable[PLAN_HASH_SIZE]; // The buckets of the cache
+struct cachedPlan *newestPlan = NULL; // Head of the LRU list, the most recently used plan
+struct cachedPlan *oldestPlan = NULL; // Tail of the LRU list, the next one to be evicted
+int numOfCachedPlans = 0; // Number of plans inside the cache
+unsigned long aliasGeneration = 0; // Incremented on every change of the alias table
+unsigned long pathGeneration = 0; // Incremented every time the PATH hash table is emptied
+
+/** Job control **/
+// Every command we launch is a job. Its processes run in their own process group, and the
+// terminal is given to that group while it is in the foreground. Children are reaped by
+// processChildEvents (see the event loop below), which records their new state in the table below
+#define MAX_JOBS 256 // Size of the job table, job numbers are the indexes + 1
+#define JOB_FREE 0 // The slot is not in use
+#define JOB_RUNNING 1 // At least one process of the job is running
+#define JOB_STOPPED 2 // All the processes which are still alive are stopped
+#define JOB_DONE 3 // All the processes have terminated
+struct jobProcess {
+    pid_t pid; // Process id
+    int state; // JOB_RUNNING, JOB_STOPPED or JOB_DONE, for this process only
+    int status; // Its wait status, once it has terminated
+    int pidfd; // A pidfd of the process while it has not been reaped, -1 if the kernel has no pidfds
+    double launchTime; // When it has been launched (microseconds), 0 unless we are tracing
+};
+struct job {
+    int state; // One of the JOB_ values, updated by processChildEvents
+    pid_t pgid; // Process group of the job (the pid of its first process)
+    struct jobProcess *processes; // The processes of the job
+    int numOfProcesses; // Number of processes inside processes
+    int isBackground; // 1 if started with & (or continued with bg)
+    int isNotified; // 1 once its current state has been reported to the user
+    char *commandLine; // The command line, as typed
+    struct rusage usage; // Resource usage of its terminated processes, summed up (max RSS is the largest one)
+};
+struct job jobTable[MAX_JOBS]; // The job table
+int currentJob = 0; // Job number of the "current" job (%+), 0 if none
+int previousJob = 0; // Job number of the "previous" job (%-), 0 if none
+struct signalName {
+    const char *name; // Name without the SIG prefix
+    int number; // Signal number
+};
+const struct signalName signalNames[] = { // Known by kill, in increasing order of their numbers
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"ILL", SIGILL}, {"TRAP", SIGTRAP},
+    {"ABRT", SIGABRT}, {"BUS", SIGBUS}, {"FPE", SIGFPE}, {"KILL", SIGKILL}, {"USR1", SIGUSR1},
+    {"SEGV", SIGSEGV}, {"USR2", SIGUSR2}, {"PIPE", SIGPIPE}, {"ALRM", SIGALRM}, {"TERM", SIGTERM},
+    {"CHLD", SIGCHLD}, {"CONT", SIGCONT}, {"STOP", SIGSTOP}, {"TSTP", SIGTSTP}, {"TTIN", SIGTTIN},
+    {"TTOU", SIGTTOU}, {"URG", SIGURG}, {"XCPU", SIGXCPU}, {"XFSZ", SIGXFSZ}, {"VTALRM", SIGVTALRM},
+    {"PROF", SIGPROF}, {"WINCH", SIGWINCH}, {"IO", SIGIO}, {"SYS", SIGSYS}, {NULL, 0}
+};
+int shellIsInteractive = 0; // 1 if we are reading commands from a terminal, job control is done only then
+struct termios shellTermios; // Terminal settings of an interactive shell, restored after every line we edit
+pid_t shellPgid; // Process group of the shell itself
+struct rusage lastJobUsage; // Resource usage of the last foreground job which has terminated, read by time
+int hasLastJobUsage = 0; // 1 if lastJobUsage has been set since time has cleared it
+
+/** Event loop **/
+// The shell never runs a signal handler and never polls for its children: it sleeps only inside
+// epoll_wait. SIGCHLD (and SIGINT and SIGWINCH in interactive mode) stay blocked and are read from
+// a signalfd instead, and every process of a job is watched through a pidfd, which becomes readable
+// once it has terminated. A process is reaped through its pidfd (waitid P_PIDFD), so its pid cannot
+// have been reused by an unrelated process meanwhile. SIGCHLD is still needed for the stops and
+// continues, which a pidfd does not report
+#define MAX_EVENTS 64 // Events taken by one epoll_wait
+int childEpollFd = -1; // epoll instance watching the signalfd and the pidfds
+int signalFd = -1; // The signalfd of shellSignals
+sigset_t shellSignals; // The signals which are read from signalFd
+sigset_t childSignalMask; // The signal mask the shell has started with, every child gets it back
+int inputEpollFd = -1; // epoll instance watching the terminal and childEpollFd, for the line editor
+int isInterruptPending = 0; // 1 once a SIGINT has arrived, cleared by whoever handles it
+int isWindowResized = 0; // 1 once a SIGWINCH has arrived, cleared by whoever handles it
+
+/** Session statistics, printed by the stats builtin **/
+// The latency of every phase of a command is put into a histogram with power of 2 buckets
+// (bucket i counts the samples between 2^i and 2^(i+1) microseconds)
+#define PHASE_PARSE 0 // Tokenizing the line
+#define PHASE_RESOLVE 1 // Alias expansion, redirections and PATH lookup (or the plan cache lookup), up to spawn
+#define PHASE_SPAWN 2 // Launching every process of the job
+#define PHASE_WAIT 3 // Waiting for a foreground job
+#define NUM_OF_PHASES 4
+#define NUM_OF_LATENCY_BUCKETS 32
+const char *phaseNames[NUM_OF_PHASES] = {"parse", "resolve", "spawn", "wait"};
+struct latencyHistogram {
+    unsigned long buckets[NUM_OF_LATENCY_BUCKETS]; // Number of samples inside each bucket
+    unsigned long numOfSamples; // Number of samples
+    double totalMicroseconds; // Sum of the samples, for the mean
+    double maxMicroseconds; // The largest sample
+};
+struct latencyHistogram latencyHistograms[NUM_OF_PHASES]; // One histogram per phase
+double resolveStart = 0; // When the resolve phase of the current command has started (microseconds)
+int isBeingTimed = 0; // 1 while a command prefixed with time runs, its plan is not cached (the line has the prefix)
+unsigned long numOfForks = 0; // Processes created with fork
+unsigned long numOfPosixSpawns = 0; // Processes created with posix_spawn
+unsigned long numOfExecs = 0; // Programs executed (posix_spawn, or fork for an external command)
+unsigned long numOfLaunchFailures = 0; // Processes which could not be launched
+unsigned long numOfZygoteLaunches = 0; // Processes launched by the zygote
+unsigned long numOfFilterStages = 0; // Stages run as filter threads instead of processes
+unsigned long numOfFailedJobs = 0; // Foreground jobs which have exited with a non-zero status
+
+/** Tracing **/
+// An opt-in tracer (MYSHELL_TRACE=1, or "trace on") recording spans of the work done for every
+// command: tokenizing, alias journal reads, isInPath, fork, posix_spawn and zygote launches, the
+// builtins, the filter threads and the waits. The children are covered as well, the span of a
+// process runs from its launch until its pidfd reports its end. The spans go into a ring shared by
+// the threads of the shell without a lock: a writer takes a slot by incrementing traceHead
+// atomically, fills it, then publishes it by storing its sequence number (a reader skips a slot
+// whose sequence number is not the expected one, or has changed while it was being copied). Once
+// the ring is full the oldest spans are overwritten. "trace dump file.json" writes them in the
+// Chrome trace format (chrome://tracing, ui.perfetto.dev). While tracing is off, the only cost is
+// the test of isTracing
+#define TRACE_BUFFER_SIZE 65536 // Spans kept inside the ring (a power of 2)
+#define TRACE_DETAIL_SIZE 80 // Bytes of the detail of a span, including the '\0' (a longer one is cut)
+struct traceRecord {
+    uint64_t sequence; // Index of the span + 1 once it is complete, 0 while it is being written
+    const char *name; // What the span measures, a string literal
+    char detail[TRACE_DETAIL_SIZE]; // Its subject (a command line, a program...), may be empty
+    double start; // When it has started (microseconds, CLOCK_MONOTONIC like nowMicroseconds)
+    double duration; // Microseconds
+    pid_t pid; // The shell, or the child for the span of a process
+    pid_t tid; // The thread which has recorded it, or the child for the span of a process
+    int status; // Wait status of the child for the span of a process, -1 for the other spans
+};
+int isTracing = 0; // 1 while spans are recorded
+struct traceRecord *traceBuffer = NULL; // The ring, allocated once tracing is turned on for the first time
+uint64_t traceHead = 0; // Number of spans recorded so far, the next one goes to slot traceHead % TRACE_BUFFER_SIZE
+
+/** tee builtin **/
+// tee copies its stdin to its stdout and to files. When its stdin is a pipe (it is a stage of a
+// pipeline) the data is duplicated inside the kernel: tee(2) copies the pipe's buffers into a
+// scratch pipe without consuming them, the scratch pipe is spliced into one output, and the last
+// output gets the input itself with splice(2). Only an output which cannot be spliced into (a
+// terminal) is written from user space
+#define TEE_CHUNK (1 << 20) // Bytes duplicated at once, the scratch pipe is made this large if allowed
+struct teeOutput {
+    int fd; // The output
+    int canSplice; // 0 once splice has refused it, it is written from user space then
+    const char *name; // Its name, for the error messages
+};
+
+/** Command history **/
+// Every line typed into an interactive shell is appended (under flock) to a history file shared by
+// all the shells, $HOME/.myshell_history (or the path inside MYSHELL_HISTORY). The file is mapped
+// read-only and the lines other shells append are picked up by remapping it. The entries are
+// located through an array of their offsets, and a trigram index (every 3 byte substring of an
+// entry, hashed into a bucket) lists the entries which may contain a given substring, so a
+// search only verifies the entries of the shortest list instead of scanning the whole history.
+// The index is built on the first search and extended incrementally afterwards
+#define HISTORY_FILE ".myshell_history" // Name of the history file inside $HOME
+#define HISTORY_INDEX_SIZE 65536 // Number of buckets of the trigram index (a power of 2)
+struct historyPostingList {
+    uint32_t *entries; // Numbers of the entries having a trigram of this bucket, in increasing order
+    uint32_t numOfEntries; // Number of entries inside entries
+    uint32_t capacity; // Size of entries
+};
+int historyFd = -1; // The history file, -1 if it is not open
+int historyOpenFailed = 0; // 1 if the history file could not be opened, it is not tried again
+ino_t historyInode = 0; // Inode of the history file we have mapped
+char *historyMap = NULL; // The mapped history file, NULL if nothing is mapped
+size_t historyMapLength = 0; // Length of the mapping
+size_t historyLength = 0; // Bytes of complete lines we know about
+uint64_t *historyOffsets = NULL; // Offset of every entry, followed by historyLength
+long numOfHistoryEntries = 0; // Number of entries
+long historyOffsetsCapacity = 0; // Size of historyOffsets
+char *historyPath = NULL; // Path of the history file
+struct historyPostingList *historyIndex = NULL; // The trigram index, NULL until the first search
+long numOfIndexedEntries = 0; // Number of entries inside the trigram index
+long lastCommandEntry = -1; // Entry of the last successful line of this interactive shell, -1 if none
+char *lastCommandLine = NULL; // The last successful command of a script (a copy, the script's buffer may be gone)
+#define HISTORY_MAP_SLACK (1 << 20) // The mapping is this much longer than the file, so appends rarely need a remap
+// The bucket of the trigram starting at p (Fibonacci hashing of its 3 bytes)
+#define TRIGRAM_BUCKET(p) (((((uint32_t) (unsigned char) (p)[0] << 16) | ((uint32_t) (unsigned char) (p)[1] << 8) | \
+                            (unsigned char) (p)[2]) * 2654435761u) >> 16)
+
+/** Server mode **/
+// "myshell --serve /path.sock" turns the shell into a server for local clients, so they do not pay
+// for starting a shell per command. Every connection gets a worker process forked from the
+// server, which inherits its warm alias table and PATH hash (the server fills the PATH hash with
+// every command of the PATH before forking). At most MYSHELL_SERVE_WORKERS workers (by default,
+// one per CPU) run at once, the further connections wait inside the listen queue. A client sends
+// batches of command lines. The worker runs them one after the other, like the lines of a script
+// (a variable or a function carries over to the next command of the connection), and streams
+// back what every command writes to stdout and stderr, followed by its exit status. Each message
+// is a frame: its type (1 byte), the length of its payload (4 bytes, network byte order), then
+// the payload.
+// A client sends 'B' (a batch, every command line terminated by a NUL byte). The worker sends
+// 'O' (stdout data), 'E' (stderr data), 'S' (exit status of a command, 4 bytes, network byte
+// order) and 'D' (empty, the batch is done). exit inside a batch ends the connection after its 'S'.
+// Whoever can connect can run commands as the server's user, so the socket is created with mode
+// 0600 (only that user may connect). Put it into a directory that other users cannot write to.
+#define FRAME_BATCH 'B' // Types of the frames
+#define FRAME_STDOUT 'O'
+#define FRAME_STDERR 'E'
+#define FRAME_STATUS 'S'
+#define FRAME_DONE 'D'
+#define FRAME_HEADER_SIZE 5 // Type and length
+#define MAX_BATCH_SIZE (16 * 1024 * 1024) // A larger batch is refused (the connection is closed)
+#define SERVE_BUFFER_SIZE 65536 // Bytes of output forwarded at a time
+struct serveOutput {
+    int clientFd; // The connection
+    int outputFd; // Reading ends of the pipes which are the worker's stdout and stderr
+    int errorFd;
+    int controlFd; // Reading end of the pipe the worker sends serveControl messages into
+    int isClientGone; // 1 once sending has failed, the output is still drained but thrown away
+};
+struct serveControl {
+    char type; // FRAME_STATUS or FRAME_DONE
+    int status; // The exit status of the command
+};
+pid_t serveWorkerPid = 0; // Our pid if we are a server worker, 0 otherwise
+int serveControlFd = -1; // Writing end of the worker's control pipe
+int isServedCommandRunning = 0; // 1 while the worker runs a command of its client (exit reports its status)
+pthread_t serveOutputThread; // The thread of the worker forwarding the output
+unsigned long servedPathGeneration = -1; // pathGeneration when the server last filled the PATH hash
+
+/** Line editor of an interactive shell **/
+// The terminal is put into raw mode while a line is typed, so the editor sees every key: Up and
+// Down walk the history, Ctrl-R searches it backwards (incrementally, through the trigram index)
+struct lineEditor {
+    const char *prompt; // The prompt, redrawn with the line
+    char *buffer; // The line being edited (not NULL terminated while editing)
+    size_t length; // Bytes inside buffer
+    size_t capacity; // Size of buffer
+    size_t shownLength; // How much of buffer is already on the screen
+    char *saved; // The new line, while an older entry is shown by Up
+    size_t savedLength; // Bytes inside saved
+    long historyPosition; // The entry shown, numOfHistoryEntries for the new line
+    int isSearching; // 1 while in Ctrl-R mode
+    char query[256]; // What has been typed after Ctrl-R (NULL terminated)
+    size_t queryLength; // Bytes inside query
+    long match; // The entry the query has matched, -1 if none
+};
+char editorInput[4096]; // Keys read from the terminal, which may hold the start of the next line too
+size_t editorInputStart = 0; // The first key inside editorInput which has not been handled
+size_t editorInputLength = 0; // Number of keys inside editorInput
+
+/** Scripting **/
+// Control flow (if, while, until, for, case, functions, && || and !) is parsed once into a tree of
+// script nodes, which is evaluated inside the shell. Only the simple commands at its leaves go
+// through parser() (after their $ expansions), so a loop of builtins and assignments never forks.
+// A script is parsed and run one top-level command (one line, with the lines of its constructs)
+// at a time, so a function defined by one line can be called by the next
+#define NODE_COMMAND 0 // A simple command or pipeline, text is its line
+#define NODE_LIST 1 // Commands run one after the other, first is the first of them (chained by next)
+#define NODE_AND 2 // first && second
+#define NODE_OR 3 // first || second
+#define NODE_NOT 4 // ! first
+#define NODE_IF 5 // if first; then second; else third (third is NULL, a list, or the NODE_IF of an elif)
+#define NODE_WHILE 6 // while first; do second; done
+#define NODE_UNTIL 7 // until first; do second; done
+#define NODE_FOR 8 // for text in words; do second; done (words is NULL for "$@")
+#define NODE_CASE 9 // case text in ... esac, first is the first NODE_CASE_ITEM (chained by next)
+#define NODE_CASE_ITEM 10 // text is the patterns (separated by |), second is the list run on a match
+#define NODE_FUNCTION 11 // Defines the function text, second is its body
+struct scriptNode {
+    int type; // One of the NODE_ values
+    char *text; // Command line, variable, word or name, as written (expanded when it runs)
+    char *words; // The words of a for loop
+    struct scriptNode *first; // The children, their meaning depends on the type
+    struct scriptNode *second;
+    struct scriptNode *third;
+    struct scriptNode *next; // Next node of the same list
+};
+#define PARSE_OK 0 // The text has been parsed
+#define PARSE_INCOMPLETE 1 // The text has ended inside a construct or a quote, more lines are needed
+#define PARSE_ERROR 2 // A syntax error
+struct scriptParser {
+    char *position; // The next character to parse
+    struct arena arena; // Owns the nodes and their text
+    int status; // One of the PARSE_ values
+    int isQuiet; // 1 if syntax errors are not printed
+    int endsWithAmpersand; // 1 if the last simple command has ended with a single &
+};
+#define CONTROL_NONE 0 // What the commands being run must do next: carry on
+#define CONTROL_BREAK 1 // Leave controlLevels loops
+#define CONTROL_CONTINUE 2 // Leave controlLevels - 1 loops, then start the next iteration
+#define CONTROL_RETURN 3 // Leave the function
+#define CONTROL_INTERRUPT 4 // Ctrl-C, leave everything up to the top-level command
+int scriptControl = CONTROL_NONE; // One of the CONTROL_ values
+int controlLevels = 0; // Loops which break and continue still have to leave
+int loopDepth = 0; // Loops we are inside (of the current function)
+int functionDepth = 0; // Function calls we are inside
+#define MAX_FUNCTION_DEPTH 1000 // Deepest recursion of function calls
+int isCondition = 0; // 1 while the condition of an if, a loop, && or || runs, its failures are not reported
+int isArenaKept = 0; // 1 once the top-level command being run has defined a function (which lives inside its arena)
+#define VARIABLE_HASH_SIZE 256 // Number of buckets of the shell variables (a power of two)
+struct variable {
+    char *name; // Name of the variable (serves as a "key")
+    char *value; // Its value (serves as a "value")
+    struct variable *next; // Next variable inside the same bucket
+};
+struct variable *variableTable[VARIABLE_HASH_SIZE]; // Shell variables, a variable not found here is looked up in the environment
+#define FUNCTION_HASH_SIZE 64 // Number of buckets of the functions (a power of two)
+struct function {
+    char *name; // Name of the function
+    struct scriptNode *body; // Its body, inside the arena of the line which has defined it
+    struct function *next; // Next function inside the same bucket
+};
+struct function *functionTable[FUNCTION_HASH_SIZE]; // The defined functions
+int numOfFunctions = 0; // Number of functions, no command is looked up as a function while it is 0
+char *shellName = "myshell"; // $0
+char **positionalArguments = NULL; // $1, $2, ... of the script, or of the function being run
+int numOfPositionalArguments = 0; // $#
+char *pendingLines = NULL; // Lines typed so far of a command which is not complete yet, NULL if none
+struct textBuffer {
+    char *data; // The text, NULL terminated
+    size_t length; // Bytes inside data
+    size_t capacity; // Size of data
+};
+#define ESCAPE_NONE 0 // How an expanded value is written into a command line: as it is
+#define ESCAPE_WORD 1 // With a backslash before every character the tokenizer would treat specially
+#define ESCAPE_DOUBLE_QUOTES 2 // With a backslash before the characters special inside "..."
+struct arithmetic {
+    const char *position; // The next character of the expression
+    int hasFailed; // 1 on a syntax error, 2 on a division by zero
+};
+struct arithmeticOperator {
+    const char *text; // The operator
+    int precedence; // Higher binds tighter
+};
+// Binary operators of $(( )), the longer ones first (so <= is not taken for <)
+struct arithmeticOperator arithmeticOperators[] = {
+    {"||", 1}, {"&&", 2}, {"==", 3}, {"!=", 3}, {"<=", 4}, {">=", 4}, {"<", 4}, {">", 4},
+    {"+", 5}, {"-", 5}, {"*", 6}, {"/", 6}, {"%", 6}, {NULL, 0}
+};
+struct testParser {
+    char **arguments; // The arguments of test (without the ] of [)
+    int numOfArguments; // Number of arguments
+    int position; // The next argument to parse
+    int hasFailed; // 1 on a syntax error
+};
+
+/** Builtins **/
+// Commands which are run by the shell itself. A builtin alone in the foreground runs inside the
+// shell process (with its redirection applied by swapping the stdout for the duration of the call),
+// a background one, or one inside a pipeline, runs inside a forked child
+struct builtin {
+    const char *name; // Name of the builtin
+    int (*function)(char **tokens, int numOfTokens); // Gets the NULL terminated arguments, returns the status
+};
+struct builtin builtinTable[] = {
+    {"exit", exitBuiltin},
+    {"bello", belloBuiltin},
+    {"jobs", jobsBuiltin},
+    {"fg", fgBuiltin},
+    {"bg", bgBuiltin},
+    {"wait", waitBuiltin},
+    {"kill", killBuiltin},
+    {"hash", hashBuiltin},
+    {"alias", aliasBuiltin},
+    {"stats", statsBuiltin},
+    {"trace", traceBuiltin},
+    {"parallel", parallelBuiltin},
+    {"history", historyBuiltin},
+    {"tee", teeBuiltin},
+    {"test", testBuiltin},
+    {"[", testBuiltin},
+    {"true", trueBuiltin},
+    {"false", falseBuiltin},
+    {":", trueBuiltin},
+    {"break", loopControlBuiltin},
+    {"continue", loopControlBuiltin},
+    {"return", returnBuiltin},
+    {NULL, NULL}
+};
+
+/** Our helping functions **/
+// As its name shows, it removes the first and last quotes of a string input str
+void removeQuotes(char *str) {
+    char *src = str, *dst = str;
+    while (*src) {
+        if ((*src != '"') || ((*src == '"')&&(src!=str)&&(*(src+1) != '\0'))) {
+            *dst = *src;
+            dst++;
+        }
+        src++;
+    }
+    *dst = '\0';  // Null-terminate the modified string
+}
+// Hands out size bytes (aligned to 16) from the arena, adding a new block when needed
+void *arenaAlloc(struct arena *arena, size_t size) {
+    size = (size + 15) & ~(size_t) 15;
+    if ((arena->head == NULL) || (arena->head->used + size > arena->head->capacity)) {
+        size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        struct arenaBlock *block = malloc(sizeof(struct arenaBlock) + capacity);
+        if (block == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        block->next = arena->head;
+        block->used = 0;
+        block->capacity = capacity;
+        arena->head = block;
+    }
+    void *memory = arena->head->data + arena->head->used;
+    arena->head->used += size;
+    return memory;
+}
+// Frees everything allocated from the arena
+void arenaFree(struct arena *arena) {
+    while (arena->head != NULL) {
+        struct arenaBlock *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+}
+// Appends a token to the list, doubling the arrays when they are full
+void pushToken(struct tokenList *list, char *token, char isOperatorToken, struct arena *arena) {
+    if (list->numOfTokens + 1 >= list->capacity) {
+        int newCapacity = list->capacity * 2;
+        char **newTokens = arenaAlloc(arena, newCapacity * sizeof(char *));
+        char *newIsOperator = arenaAlloc(arena, newCapacity);
+        memcpy(newTokens, list->tokens, list->numOfTokens * sizeof(char *));
+        memcpy(newIsOperator, list->isOperator, list->numOfTokens);
+        list->tokens = newTokens;
+        list->isOperator = newIsOperator;
+        list->capacity = newCapacity;
+    }
+    list->tokens[list->numOfTokens] = token;
+    list->isOperator[list->numOfTokens] = isOperatorToken;
+    list->numOfTokens++;
+    list->tokens[list->numOfTokens] = NULL;
+}
+// Our tokenizer. Splits the input into tokens in a single pass, with the usual shell rules:
+// words are separated by spaces and tabs, '...' keeps everything literally, "..." keeps
+// everything literally except \" \\ \$ and \`, a backslash outside quotes escapes the next
+// character, and the unquoted operators | & > >> >>> < <<< are tokens of their own. The quotes are
+// removed from the tokens. The text of all the tokens is written into one arena buffer, which
+// cannot be longer than twice the input (every character plus a terminator after each token).
+// If the input has glob characters, every word is also written as a pattern (with the quoted
+// glob characters escaped by a backslash), and a word with unquoted ones is expanded.
+// Returns 0 on success, 1 if a quote is not closed
+int tokenize(const char *input, struct arena *arena, struct tokenList *list) {
+    size_t length = strlen(input);
+    char *output = arenaAlloc(arena, 2 * length + 2); // Text of the tokens, each one null terminated
+    char *tokenStart = NULL; // Start of the word we are inside, NULL if we are between words
+    char *pattern = strpbrk(input, "*?[") != NULL ? arenaAlloc(arena, 2 * length + 2) : NULL; // Patterns of the words
+    char *patternStart = pattern; // Pattern of the word we are inside
+    int isGlob = 0; // 1 if the word we are inside has an unquoted glob character
+
+    list->capacity = 16;
+    list->numOfTokens = 0;
+    list->tokens = arenaAlloc(arena, list->capacity * sizeof(char *));
+    list->isOperator = arenaAlloc(arena, list->capacity);
+    list->tokens[0] = NULL;
+
+    for (const char *ptr = input; ; ptr++) {
+        char ch = *ptr;
+
+        // Whitespace or the end, finishing the current word
+        if ((ch == '\0') || (ch == ' ') || (ch == '\t') || (ch == '\n')) {
+            if (tokenStart != NULL) {
+                *output++ = '\0';
+                if (isGlob) {
+                    *pattern++ = '\0';
+                    expandGlob(patternStart, tokenStart, list, arena);
+                } else {
+                    pushToken(list, tokenStart, 0, arena);
+                }
+                tokenStart = NULL;
+            }
+            if (ch == '\0') {
+                break;
+            }
+            continue;
+        }
+
+        // Operators, which also finish the current word
+        if ((ch == '|') || (ch == '&') || (ch == '>') || (ch == '<')) {
+            if (tokenStart != NULL) {
+                *output++ = '\0';
+                if (isGlob) {
+                    *pattern++ = '\0';
+                    expandGlob(patternStart, tokenStart, list, arena);
+                } else {
+                    pushToken(list, tokenStart, 0, arena);
+                }
+                tokenStart = NULL;
+            }
+            // > >> >>> (and < << <<<) are one operator, the others are always one character
+            int operatorLength = 1;
+            while (((ch == '>') || (ch == '<')) && (operatorLength < 3) && (ptr[operatorLength] == ch)) {
+                operatorLength++;
+            }
+            char *operatorStart = output;
+            memcpy(output, ptr, operatorLength);
+            output += operatorLength;
+            *output++ = '\0';
+            pushToken(list, operatorStart, 1, arena);
+            ptr += operatorLength - 1;
+            continue;
+        }
+
+        // Anything else belongs to a word (quotes included, even an empty "" is a word)
+        if (tokenStart == NULL) {
+            tokenStart = output;
+            patternStart = pattern;
+            isGlob = 0;
+        }
+        char *wordStart = output; // What this character adds to the word, for its pattern
+        int isQuoted = 1;
+        if (ch == '\'') {
+            // Single quotes, everything is literal until the closing quote
+            for (ptr++; (*ptr != '\0') && (*ptr != '\''); ptr++) {
+                *output++ = *ptr;
+            }
+            if (*ptr == '\0') {
+                printf("%s\n", "Inside string error!"); // Corresponding error message
+                return 1;
+            }
+        }
+        else if (ch == '"') {
+            // Double quotes, only \" \\ \$ \` are escapes
+            for (ptr++; (*ptr != '\0') && (*ptr != '"'); ptr++) {
+                if ((*ptr == '\\') && (ptr[1] != '\0') && (strchr("\"\\$`", ptr[1]) != NULL)) {
+                    ptr++;
+                }
+                *output++ = *ptr;
+            }
+            if (*ptr == '\0') {
+                printf("%s\n", "Inside string error!"); // Corresponding error message
+                return 1;
+            }
+        }
+        else if ((ch == '\\') && (ptr[1] != '\0')) {
+            // Backslash, the next character is taken literally
+            ptr++;
+            *output++ = *ptr;
+        }
+        else {
+            // The remaining general cases, like usual characters, numbers, letters, etc.
+            *output++ = ch;
+            isQuoted = 0;
+            // A [ is only a pattern with its ] inside the same word (so the [ of test is not globbed)
+            const char *setEnd;
+            if ((ch == '*') || (ch == '?')) {isGlob = 1;}
+            else if ((ch == '[') && ((setEnd = findSetEnd(ptr)) != NULL) && (strcspn(ptr, " \t\n") > (size_t) (setEnd - ptr))) {isGlob = 1;}
+        }
+        if (pattern != NULL) {
+            for (char *c = wordStart; c < output; c++) {
+                if (isQuoted && (strchr("*?[]\\", *c) != NULL)) {*pattern++ = '\\';}
+                *pattern++ = *c;
+            }
+        }
+    }
+    return 0;
+}
+// Returns the ] closing the set which starts at the [ of a pattern, NULL if it is not closed.
+// Its first byte (after a ! or ^) is always a member, even if it is a ]
+const char *findSetEnd(const char *set) {
+    const char *d = set + 1;
+    if ((*d == '!') || (*d == '^')) {d++;}
+    for (int isFirst = 1; *d != '\0'; d++, isFirst = 0) {
+        if ((*d == '\\') && (d[1] != '\0')) {
+            d++;
+        } else if ((*d == ']') && !isFirst) {
+            return d;
+        }
+    }
+    return NULL;
+}
+// Compiles one segment of a pattern (a part between slashes) for matchGlob. A [ without its ]
+// is an ordinary character. Returns the number of operations which are not GLOB_LITERAL, so 0
+// means the segment is a plain name
+int compileGlob(const char *segment, struct globMatcher *matcher) {
+    matcher->operations = malloc((strlen(segment) + 1) * sizeof(struct globOperation));
+    matcher->numOfOperations = 0;
+    matcher->startsWithDot = 0;
+    int numOfWildcards = 0;
+    const char *setEnd;
+    for (const char *c = segment; *c != '\0'; c++) {
+        struct globOperation *operation = &matcher->operations[matcher->numOfOperations];
+        if (*c == '*') {
+            // Consecutive stars are one star
+            if ((matcher->numOfOperations > 0) && (operation[-1].type == GLOB_STAR)) {continue;}
+            operation->type = GLOB_STAR;
+        } else if (*c == '?') {
+            operation->type = GLOB_ANY;
+        } else if ((*c == '[') && ((setEnd = findSetEnd(c)) != NULL)) {
+            // A set, "]" right after [ (or [!) is one of its bytes, a-z is a range
+            operation->type = GLOB_CLASS;
+            memset(operation->set, 0, sizeof(operation->set));
+            const char *d = c + 1;
+            int isNegated = (*d == '!') || (*d == '^');
+            if (isNegated) {d++;}
+            for (; d < setEnd; d++) {
+                if (*d == '\\') {d++;}
+                unsigned char low = *d, high = *d;
+                if ((d[1] == '-') && (d + 2 < setEnd)) {
+                    d += 2;
+                    if (*d == '\\') {d++;}
+                    high = *d;
+                }
+                for (int b = low; b <= high; b++) {
+                    operation->set[b >> 3] |= 1 << (b & 7);
+                }
+            }
+            if (isNegated) {
+                for (int b = 0; b < 32; b++) {operation->set[b] = ~operation->set[b];}
+            }
+            c = setEnd;
+        } else {
+            if ((*c == '\\') && (c[1] != '\0')) {c++;}
+            operation->type = GLOB_LITERAL;
+            operation->character = *c;
+            if ((matcher->numOfOperations == 0) && (*c == '.')) {matcher->startsWithDot = 1;}
+        }
+        if (operation->type != GLOB_LITERAL) {numOfWildcards++;}
+        matcher->numOfOperations++;
+    }
+    return numOfWildcards;
+}
+// Returns 1 if name matches the compiled segment. A star first matches nothing, and on a
+// mismatch the last star takes one more byte (so no recursion, and a single star is linear)
+int matchGlob(struct globMatcher *matcher, const char *name) {
+    if ((name[0] == '.') && !matcher->startsWithDot) {
+        return 0;
+    }
+    struct globOperation *operations = matcher->operations;
+    int numOfOperations = matcher->numOfOperations;
+    int position = 0; // The operation to match
+    int starPosition = -1; // The last star seen, -1 if none
+    const char *starName = NULL; // Where the bytes matched by that star end
+    const char *c = name;
+    while (*c != '\0') {
+        if (position < numOfOperations) {
+            struct globOperation *operation = &operations[position];
+            unsigned char byte = *c;
+            if (operation->type == GLOB_STAR) {
+                starPosition = position++;
+                starName = c;
+                continue;
+            }
+            if ((operation->type == GLOB_ANY) ||
+                ((operation->type == GLOB_LITERAL) && (operation->character == byte)) ||
+                ((operation->type == GLOB_CLASS) && (operation->set[byte >> 3] & (1 << (byte & 7))))) {
+                position++;
+                c++;
+                continue;
+            }
+        }
+        if (starPosition == -1) {
+            return 0;
+        }
+        position = starPosition + 1;
+        c = ++starName;
+    }
+    while ((position < numOfOperations) && (operations[position].type == GLOB_STAR)) {
+        position++;
+    }
+    return position == numOfOperations;
+}
+// Adds a copy of the first length bytes of path to the matches
+void addGlobMatch(struct globMatches *matches, const char *path, size_t length) {
+    if (matches->numOfPaths == matches->capacity) {
+        matches->capacity = matches->capacity == 0 ? 64 : matches->capacity * 2;
+        matches->paths = realloc(matches->paths, matches->capacity * sizeof(char *));
+    }
+    char *copy = arenaAlloc(matches->arena, length + 1);
+    memcpy(copy, path, length);
+    copy[length] = '\0';
+    matches->paths[matches->numOfPaths++] = copy;
+}
+// Matches the segments from index on inside the directory path (its first pathLength bytes,
+// "" for the current directory, otherwise ending with a slash). The names to descend into are
+// collected before descending, so a single getdents64 buffer serves every level
+void globDirectory(char *path, size_t pathLength, char **segments, int numOfSegments, int index, struct globMatches *matches) {
+    if (index == numOfSegments) {
+        addGlobMatch(matches, path, pathLength > 1 ? pathLength - 1 : pathLength);
+        return;
+    }
+    int isLast = index == numOfSegments - 1;
+    int isRecursive = strcmp(segments[index], "**") == 0;
+    struct globMatcher matcher;
+    int numOfWildcards = compileGlob(isRecursive ? "*" : segments[index], &matcher);
+
+    // A plain name is not searched for, only its existence is checked at the end
+    if (numOfWildcards == 0) {
+        size_t length = matcher.numOfOperations;
+        if (pathLength + length + 2 < GLOB_PATH_MAX) {
+            for (int i = 0; i < matcher.numOfOperations; i++) {
+                path[pathLength + i] = matcher.operations[i].character;
+            }
+            path[pathLength + length] = '\0';
+            if (!isLast) {
+                path[pathLength + length] = '/';
+                globDirectory(path, pathLength + length + 1, segments, numOfSegments, index + 1, matches);
+            } else if (faccessat(AT_FDCWD, path, F_OK, AT_SYMLINK_NOFOLLOW) == 0) {
+                addGlobMatch(matches, path, pathLength + length);
+            }
+        }
+        free(matcher.operations);
+        return;
+    }
+
+    // ** also matches no directory at all
+    if (isRecursive && !isLast) {
+        globDirectory(path, pathLength, segments, numOfSegments, index + 1, matches);
+    }
+
+    path[pathLength] = '\0';
+    int directoryFd = open(pathLength > 0 ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd == -1) {
+        free(matcher.operations);
+        return;
+    }
+    if (globBuffer == NULL) {
+        globBuffer = malloc(GLOB_BUFFER_SIZE);
+    }
+    char **subdirectories = NULL; // Names to descend into
+    size_t numOfSubdirectories = 0, capacity = 0;
+    long bytesRead;
+    while ((bytesRead = syscall(SYS_getdents64, directoryFd, globBuffer, GLOB_BUFFER_SIZE)) > 0) {
+        for (long offset = 0; offset < bytesRead;) {
+            struct linuxDirent64 *entry = (struct linuxDirent64 *) (globBuffer + offset);
+            offset += entry->d_reclen;
+            char *name = entry->d_name;
+            if ((name[0] == '.') && ((name[1] == '\0') || ((name[1] == '.') && (name[2] == '\0')))) {
+                continue;
+            }
+            if (!matchGlob(&matcher, name)) {
+                continue;
+            }
+            size_t nameLength = strlen(name);
+            if (pathLength + nameLength + 2 >= GLOB_PATH_MAX) {
+                continue;
+            }
+            if (isLast) {
+                memcpy(path + pathLength, name, nameLength);
+                addGlobMatch(matches, path, pathLength + nameLength);
+                if (!isRecursive) {continue;}
+            }
+
+            // Only directories can be descended into, ** does not follow symbolic links
+            int isDirectory = entry->d_type == DT_DIR;
+            if ((entry->d_type == DT_UNKNOWN) || ((entry->d_type == DT_LNK) && !isRecursive)) {
+                struct stat fileInfo;
+                int flags = entry->d_type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW;
+                isDirectory = (fstatat(directoryFd, name, &fileInfo, flags) == 0) && S_ISDIR(fileInfo.st_mode);
+            }
+            if (isDirectory) {
+                if (numOfSubdirectories == capacity) {
+                    capacity = capacity == 0 ? 16 : capacity * 2;
+                    subdirectories = realloc(subdirectories, capacity * sizeof(char *));
+                }
+                subdirectories[numOfSubdirectories++] = strdup(name);
+            }
+        }
+    }
+    close(directoryFd);
+    free(matcher.operations);
+
+    // Descending, a ** stays at the same segment
+    for (size_t i = 0; i < numOfSubdirectories; i++) {
+        size_t nameLength = strlen(subdirectories[i]);
+        memcpy(path + pathLength, subdirectories[i], nameLength);
+        path[pathLength + nameLength] = '/';
+        globDirectory(path, pathLength + nameLength + 1, segments, numOfSegments, isRecursive ? index : index + 1, matches);
+        free(subdirectories[i]);
+    }
+    free(subdirectories);
+}
+// Comparison function for qsort
+int comparePaths(const void *first, const void *second) {
+    return strcmp(*(char *const *) first, *(char *const *) second);
+}
+// Replaces a word with the sorted paths matching its pattern, or pushes the word itself if
+// nothing matches. The pattern is split into its segments in place. A pattern ending with a slash
+// (like */) only matches directories (symbolic links to them too), which keep the slash. A
+// pattern with more segments than a path of GLOB_PATH_MAX bytes can have matches nothing, it is
+// also left as it is
+void expandGlob(char *pattern, char *word, struct tokenList *list, struct arena *arena) {
+    lineIsGlobbed = 1;
+    char *segments[GLOB_PATH_MAX / 2];
+    int numOfSegments = 0;
+    char path[GLOB_PATH_MAX];
+    size_t pathLength = 0;
+    if (pattern[0] == '/') {
+        path[pathLength++] = '/';
+    }
+    // The trailing slash is lost when the pattern is split
+    size_t patternLength = strlen(pattern);
+    int isDirectoryOnly = (patternLength > 0) && (pattern[patternLength - 1] == '/');
+    for (char *segment = strtok(pattern, "/"); segment != NULL; segment = strtok(NULL, "/")) {
+        if (numOfSegments == GLOB_PATH_MAX / 2) {
+            pushToken(list, word, 0, arena);
+            return;
+        }
+        segments[numOfSegments++] = segment;
+    }
+
+    struct globMatches matches = {NULL, 0, 0, arena};
+    if (numOfSegments > 0) {
+        globDirectory(path, pathLength, segments, numOfSegments, 0, &matches);
+    }
+    if (isDirectoryOnly) {
+        size_t numOfDirectories = 0;
+        struct stat fileInfo;
+        for (size_t i = 0; i < matches.numOfPaths; i++) {
+            if ((stat(matches.paths[i], &fileInfo) == 0) && S_ISDIR(fileInfo.st_mode)) {
+                size_t length = strlen(matches.paths[i]);
+                char *directory = arenaAlloc(arena, length + 2);
+                memcpy(directory, matches.paths[i], length);
+                directory[length] = '/';
+                directory[length + 1] = '\0';
+                matches.paths[numOfDirectories++] = directory;
+            }
+        }
+        matches.numOfPaths = numOfDirectories;
+    }
+    if (matches.numOfPaths == 0) {
+        pushToken(list, word, 0, arena);
+    } else {
+        qsort(matches.paths, matches.numOfPaths, sizeof(char *), comparePaths);
+        for (size_t i = 0; i < matches.numOfPaths; i++) {
+            pushToken(list, matches.paths[i], 0, arena);
+        }
+    }
+    free(matches.paths);
+}
+// Creates the child processes of a pipeline (a single command is a pipeline with one stage),
+// which is described by the execution plan, as a new job. Every stage runs concurrently
+// inside the job's process group, the stdout of each stage is connected to the stdin of the next
+// one with a pipe, and the redirection (if any) applies to the last stage. A foreground job is
+// waited for, a background job is only announced. Returns the exit status of a foreground job
+// (0 for a background one), 1 if it could not be launched
+int spawn (struct executionPlan* plan, char* commandLine) {
+    double spawnStart = nowMicroseconds();
+    recordLatency(PHASE_RESOLVE, spawnStart - resolveStart);
+    recordSpan("resolve", commandLine, resolveStart, spawnStart);
+    // A job which could not be put into the table would never be waited for nor reaped, so it is
+    // not launched at all. The background jobs which have finished are only removed before each
+    // prompt, a loop of commands may fill the table in between: they are removed (and reported)
+    // first
+    if (!hasFreeJob()) {
+        reportJobs();
+    }
+    if (!hasFreeJob()) {
+        fprintf(stderr, "Error: job table is full (%d jobs)\n", MAX_JOBS);
+        numOfLaunchFailures++;
+        error = 1;
+        return 1;
+    }
+    int numOfStages = plan->numOfStages;
+    int redirectionType = plan->redirectionType;
+    char *fileName = plan->fileName;
+    int isBackground = plan->isBackground;
+
+    // The placement of the job. A background job which is not pinned may get the next CPU
+    struct placement placement = plan->placement;
+    if (isBackground && spreadBackgroundJobs && !placement.hasCpus) {
+        for (int n = 0; n < CPU_SETSIZE; n++) {
+            int cpu = (nextSpreadCpu + n) % CPU_SETSIZE;
+            if (CPU_ISSET(cpu, &shellCpus)) {
+                CPU_ZERO(&placement.cpus);
+                CPU_SET(cpu, &placement.cpus);
+                placement.hasCpus = 1;
+                nextSpreadCpu = cpu + 1;
+                break;
+            }
+        }
+    }
+
+    // Children are reaped only by processChildEvents, which runs once the job is inside the table
+    // (so the process group also stays alive while we are adding stages to it, as its leader
+    // cannot be reaped meanwhile)
+
+    // Pending output must not be duplicated into the children
+    fflush(stdout);
+
+    pid_t pids[numOfStages + 2]; // The processes of the job (the stages and the >>> and <<< helpers)
+    double launchTimes[numOfStages + 2]; // When each of them has been launched, for the tracer (0 if not tracing)
+    int numOfProcesses = 0; // Number of processes inside pids
+    pid_t pgid = 0; // Process group of the job, the pid of its first process
+    int hasFailed = 0; // Becomes 1 if a stage could not be launched
+
+    // The input of the first stage: the file of <, or a pipe the string of <<< is fed into
+    // (-1 means the terminal). A string which fits into the pipe is written at once, so the shell
+    // never blocks on it. A larger one is fed by a helper process (feedFd stays open for it)
+    int inputFd = -1;
+    int feedFd = -1; // Writing end of the <<< pipe, while a helper must feed it
+    if (plan->inputType == INPUT_FILE) {
+        inputFd = open(plan->inputSource, O_RDONLY | O_CLOEXEC);
+        if (inputFd == -1) {
+            fprintf(stderr, "Error opening %s: %s\n", plan->inputSource, strerror(errno));
+            error = 1;
+            return 1;
+        }
+    } else if (plan->inputType == INPUT_STRING) {
+        int feedPipe[2];
+        if (pipe2(feedPipe, O_CLOEXEC) == -1) {
+            fprintf(stderr, "Pipe Failed\n");
+            error = 1;
+            return 1;
+        } else {
+            inputFd = feedPipe[0];
+            feedFd = feedPipe[1];
+        }
+        size_t length = strlen(plan->inputSource);
+        int pipeSize = fcntl(feedFd, F_GETPIPE_SZ);
+        if ((pipeSize != -1) && (length + 1 <= (size_t) pipeSize)) {
+            struct iovec vectors[2] = {{plan->inputSource, length}, {"\n", 1}};
+            if (writev(feedFd, vectors, 2) != (ssize_t) length + 1) {
+                perror("Error writing the here-string");
+                close(inputFd);
+                close(feedFd);
+                error = 1;
+                return 1;
+            }
+            close(feedFd);
+            feedFd = -1;
+        }
+    }
+
+    // The pipe for the >>> case, the last stage writes into it. A foreground job is drained by the
+    // shell itself, a background job by a helper process, which is the first process of the job
+    // 0 = read , 1 = write
+    int captureFd[2] = {-1, -1};
+    if (redirectionType == REDIRECT_REVERSE) {
+        // Checking if the pipe has properly created
+        if (pipe2(captureFd, O_CLOEXEC) == -1) {
+            fprintf(stderr, "Pipe Failed\n");
+            if (inputFd != -1) {close(inputFd);}
+            if (feedFd != -1) {close(feedFd);}
+            error = 1;
+            return 1;
+        }
+        fcntl(captureFd[0], F_SETPIPE_SZ, CAPTURE_PIPE_SIZE); // A larger pipe means fewer context switches, ignored if refused
+        if (isBackground) {
+            double helperStart = traceClock();
+            pid_t helper = fork();
+            // In case of fork error
+            if (helper < 0) {
+                perror("fork Failed");
+                numOfLaunchFailures++;
+                close(captureFd[0]);
+                close(captureFd[1]);
+                if (inputFd != -1) {close(inputFd);}
+                if (feedFd != -1) {close(feedFd);}
+                error = 1;
+                return 1;
+            }
+            // Helper process, reads the pipe while the pipeline is running, then exits
+            if (helper == 0) {
+                setpgid(0, 0);
+                resetChildSignals(&childSignalMask);
+                close(captureFd[1]); // Closes the writing end of the pipe
+                if (feedFd != -1) {close(feedFd);} // The stages must see the end of the <<< string
+                exit(reverseAppend(captureFd[0], fileName));
+            }
+            numOfForks++;
+            setpgid(helper, helper);
+            pgid = helper;
+            launchTimes[numOfProcesses] = helperStart;
+            pids[numOfProcesses++] = helper;
+            close(captureFd[0]); // Only the helper reads it
+            captureFd[0] = -1;
+        }
+    }
+
+    // The stages which may run as filter threads (see the Stream filters section): only inside a
+    // foreground job without a placement, without a builtin (its forked child would keep the
+    // descriptors of the threads) and which does not need a helper for both <<< and >>>
+    int canRunFilters = useStreamFilters && !isBackground && !isPlaced(&placement) && !((feedFd != -1) && (captureFd[0] != -1));
+    for (int i = 0; (i < numOfStages) && canRunFilters; i++) {
+        if (findBuiltin(plan->programs[i]) != NULL) {canRunFilters = 0;}
+    }
+    struct filter *filters[numOfStages]; // The stages running as threads
+    int numOfFilters = 0;
+    int isLastStageFilter = 0; // 1 if the status of the job is the one of a filter
+
+    // Launching the stages from left to right. inputFd is the reading end of the pipe coming from
+    // the previous stage
+    for (int i = 0; (i < numOfStages) && !hasFailed; i++) {
+        int pipeFd[2] = {-1, -1};
+        int outputFd = -1;
+        if (i < numOfStages - 1) {
+            // The pipe to the next stage, close-on-exec so that only the stages it is dup'ed into keep it
+            if (pipe2(pipeFd, O_CLOEXEC) == -1) {
+                fprintf(stderr, "Pipe Failed\n");
+                hasFailed = 1;
+                break;
+            }
+            setPipeSize(pipeFd[0]);
+            outputFd = pipeFd[1];
+        } else if (captureFd[1] != -1) {
+            outputFd = captureFd[1];
+        }
+
+        // A filter thread, if the stage is one. A stage which would read the terminal stays a
+        // process, so that it can be stopped and gets the terminal's signals
+        struct filter *filter = canRunFilters ? prepareFilter(plan->stages[i]) : NULL;
+        if ((filter != NULL) && (((inputFd == -1) && (filter->fileName == NULL)) ||
+                                 (startFilter(filter, inputFd, outputFd, (i == numOfStages - 1) ? redirectionType : REDIRECT_NONE, fileName) != 0))) {
+            releaseFilter(filter);
+            filter = NULL;
+        }
+        pid_t child_pid = 0;
+        double launchStart = traceClock();
+        if (filter != NULL) {
+            filters[numOfFilters++] = filter;
+            isLastStageFilter = (i == numOfStages - 1);
+        } else {
+            child_pid = launchStage(plan->stages[i], plan->programs[i], inputFd, outputFd, (i == numOfStages - 1) ? redirectionType : REDIRECT_NONE,
+                                    fileName, pgid, !isBackground, &childSignalMask, &placement);
+        }
+
+        // Closing our copies of the pipe ends the stage has got
+        if (inputFd != -1) {close(inputFd);}
+        if (pipeFd[1] != -1) {close(pipeFd[1]);}
+        inputFd = pipeFd[0];
+        if (filter != NULL) {
+            continue;
+        }
+
+        if (child_pid < 0) {
+            numOfLaunchFailures++;
+            hasFailed = 1;
+            break;
+        }
+        // The parent also sets the process group, so it is set whichever process runs first
+        if (pgid == 0) {pgid = child_pid;}
+        setpgid(child_pid, pgid);
+        launchTimes[numOfProcesses] = launchStart;
+        pids[numOfProcesses++] = child_pid;
+    }
+    if (inputFd != -1) {close(inputFd);}
+    if (captureFd[1] != -1) {close(captureFd[1]);}
+
+    // A string of <<< larger than the pipe is fed by a helper process, the first process of the
+    // job, so the shell is never blocked by a reader which is slow or stopped
+    if ((feedFd != -1) && (numOfProcesses + numOfFilters > 0)) {
+        double feederStart = traceClock();
+        pid_t feeder = fork();
+        if (feeder == 0) {
+            setpgid(0, pgid);
+            resetChildSignals(&childSignalMask);
+            signal(SIGPIPE, SIG_IGN); // A reader which stops early is not an error of ours
+            if (captureFd[0] != -1) {close(captureFd[0]);}
+            feedHereString(feedFd, plan->inputSource);
+            _exit(0);
+        }
+        if (feeder > 0) {
+            numOfForks++;
+            if (pgid == 0) {pgid = feeder;} // Every stage is a filter thread
+            setpgid(feeder, pgid);
+            memmove(pids + 1, pids, numOfProcesses * sizeof(pid_t));
+            memmove(launchTimes + 1, launchTimes, numOfProcesses * sizeof(double));
+            pids[0] = feeder;
+            launchTimes[0] = feederStart;
+            numOfProcesses++;
+        } else {
+            perror("fork Failed");
+            numOfLaunchFailures++;
+            error = 1;
+        }
+    }
+    if (feedFd != -1) {
+        close(feedFd);
+        feedFd = -1;
+    }
+
+    // Nothing could be launched
+    if (numOfProcesses + numOfFilters == 0) {
+        if (captureFd[0] != -1) {close(captureFd[0]);}
+        error = 1;
+        return 1;
+    }
+    if (hasFailed) {
+        error = 1;
+    }
+
+    // The launched processes form the job, even if some stage has failed (they still need to be
+    // reaped). A pipeline made only of filter threads has no job
+    int jobNumber = (numOfProcesses > 0) ? addJob(pgid, pids, numOfProcesses, commandLine, isBackground) : 0;
+    for (int k = 0; (k < numOfProcesses) && (jobNumber > 0) && isTracing; k++) {
+        jobTable[jobNumber - 1].processes[k].launchTime = launchTimes[k];
+    }
+
+    double waitStart = nowMicroseconds();
+    recordLatency(PHASE_SPAWN, waitStart - spawnStart);
+    recordSpan("spawn", commandLine, spawnStart, waitStart);
+
+    // A background job is only announced
+    if (isBackground) {
+        printf("[%d] %d\n", jobNumber, pids[numOfProcesses - 1]);
+        return error;
+    }
+
+    // Foreground >>>, reads the pipe while the pipeline is running, reverses it and appends it to the file
+    if (captureFd[0] != -1) {
+        if (reverseAppend(captureFd[0], fileName) != 0) {
+            error = 1;
+        }
+        close(captureFd[0]); // Closes the reading end of the pipe
+    }
+
+    /* This is the parent process. It waits for the job and returns its status */
+    int status = (jobNumber > 0) ? waitForJob(jobNumber) : 0;
+    // Then for the filter threads, unless the job has been stopped. The status of the last stage
+    // is the one of its filter, but a job interrupted by Ctrl-C stays interrupted
+    if (numOfFilters > 0) {
+        int isStopped = (jobNumber > 0) && (jobTable[jobNumber - 1].state == JOB_STOPPED);
+        int filterStatus = finishFilters(filters, numOfFilters, isStopped);
+        if ((isLastStageFilter || (filterStatus == 128 + SIGINT)) && !isStopped && (status != 128 + SIGINT)) {
+            status = filterStatus;
+        }
+    }
+    double waitEnd = nowMicroseconds();
+    recordLatency(PHASE_WAIT, waitEnd - waitStart);
+    recordSpan("wait", commandLine, waitStart, waitEnd);
+
+    // Check if the child process exited abnormally
+    if (status != 0) {
+        numOfFailedJobs++;
+        if (!isCondition) {
+            fprintf(stderr, "Child process could not be executed successfully\n"); // Setting error message
+        }
+        error = 1; // Setting error flag
+        return status;
+    }
+    return error;
+}
+// Applies the MYSHELL_PIPE_SIZE environment variable (in bytes) to a pipe between two stages.
+// A larger pipe lets a high-throughput stage run further ahead of its reader
+void setPipeSize(int pipeFd) {
+    char *pipeSize = getenv("MYSHELL_PIPE_SIZE");
+    if ((pipeSize != NULL) && (atoi(pipeSize) > 0)) {
+        if (fcntl(pipeFd, F_SETPIPE_SZ, atoi(pipeSize)) == -1) {
+            perror("Error setting the pipe size");
+        }
+    }
+}
+// Writes the string of a here-string (<<<) and a newline into a pipe. Called by the helper process
+// which feeds a string larger than the pipe. The string is first copied into a mapping of its own,
+// whose pages vmsplice then hands to the pipe instead of copying them into it: the pages stay
+// referenced by the pipe until the reader has consumed them, so they must never be shared with
+// the shell (whose arena is reused for the next lines). write is used only where vmsplice is not
+// supported. Returns 0 on success, -1 on error
+int feedHereString(int pipeFd, const char *text) {
+    size_t length = strlen(text) + 1;
+    char *copy = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (copy == MAP_FAILED) {
+        return -1;
+    }
+    memcpy(copy, text, length - 1);
+    copy[length - 1] = '\n';
+    struct iovec vector = {copy, length};
+    int canSplice = 1;
+    while (vector.iov_len > 0) {
+        ssize_t bytesFed = canSplice ? vmsplice(pipeFd, &vector, 1, 0) : write(pipeFd, vector.iov_base, vector.iov_len);
+        if (bytesFed == -1) {
+            if (errno == EINTR) {continue;}
+            if (canSplice && ((errno == EINVAL) || (errno == ENOSYS))) {
+                canSplice = 0;
+                continue;
+            }
+            return -1; // EPIPE, the reader has gone
+        }
+        // Skipping what has been fed
+        vector.iov_base = (char *) vector.iov_base + bytesFed;
+        vector.iov_len -= bytesFed;
+    }
+    munmap(copy, length); // The pipe keeps its own references to the pages it has not delivered yet
+    return 0;
+}
+// Gives a forked child the default dispositions of the signals the shell ignores, and the signal
+// mask the shell has started with (childSignalMask, without the signals read from the signalfd)
+void resetChildSignals(sigset_t* childMask) {
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTIN, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+    sigprocmask(SIG_SETMASK, childMask, NULL);
+}
+// Launches one stage of a pipeline inside the process group pgid (0 means a new group, led by
+// this stage). Its stdin is inputFd and its stdout is outputFd when they are not -1, and the
+// file redirection (> >>) is applied after them. External commands are launched with posix_spawn,
+// builtins (which run our own code in the child), stages with a placement (which posix_spawn cannot
+// apply) and every stage under MYSHELL_SPAWN=fork with fork. program is the resolved path of
+// arg_list[0] (or the name of a builtin), placement may be NULL. Returns the pid, -1 on error
+pid_t launchStage(char** arg_list, char* program, int inputFd, int outputFd, int redirectionType, char* fileName, pid_t pgid, int isForeground, sigset_t* childMask, struct placement *placement) {
+    if (!useForkBackend && (findBuiltin(program) == NULL)) {
+        // Asking the zygote, if there is one and it still has our environment
+        if ((zygoteFd != -1) && !isZygoteStale) {
+            double zygoteStart = traceClock();
+            pid_t child_pid = zygoteSpawnCommand(arg_list, program, inputFd, outputFd, redirectionType, fileName, pgid, isForeground, placement);
+            recordSpan("zygote launch", program, zygoteStart, traceClock());
+            if (child_pid != -2) {
+                return child_pid;
+            }
+        }
+        // Launching with posix_spawn, everything the child does before exec is given as attributes and file actions
+        // (the span covers the exec, as posix_spawn returns once the child has executed the program)
+        if ((placement == NULL) || !isPlaced(placement)) {
+            double spawnStart = traceClock();
+            pid_t child_pid = posixSpawnCommand(arg_list, program, inputFd, outputFd, redirectionType, fileName, pgid, isForeground, childMask);
+            recordSpan("posix_spawn", program, spawnStart, traceClock());
+            return child_pid;
+        }
+    }
+
+    // Forking the parent, creating a child
+    double forkStart = traceClock();
+    pid_t child_pid = fork();
+    // In case of fork error
+    if (child_pid < 0) {
+        perror("fork Failed");
+        return -1;
+    }
+    if (child_pid > 0) {
+        recordSpan("fork", program, forkStart, traceClock());
+        numOfForks++;
+        if (findBuiltin(program) == NULL) {numOfExecs++;}
+    }
+    if (child_pid == 0) {
+        // This is the child process. It joins the job's process group, takes the terminal if
+        // it is a foreground job, and gets the default signal dispositions back
+        setpgid(0, pgid);
+        if (shellIsInteractive && isForeground) {
+            tcsetpgrp(STDIN_FILENO, getpgrp());
+        }
+        resetChildSignals(childMask);
+        if ((placement != NULL) && (applyPlacement(placement) != 0)) {
+            exit(EXIT_FAILURE);
+        }
+
+        // Connecting the pipes (the originals are close-on-exec)
+        if ((inputFd != -1) && (dup2(inputFd, STDIN_FILENO) == -1)) {
+            perror("Error redirecting standard input");
+            exit(EXIT_FAILURE);
+        }
+        if ((outputFd != -1) && (dup2(outputFd, STDOUT_FILENO) == -1)) {
+            perror("Error redirecting standard output");
+            exit(EXIT_FAILURE);
+        }
+        execInChild(program, arg_list, redirectionType, fileName);
+    }
+    return child_pid;
+}
+// The part of a child process after the fork: applies the file redirection (if any) and
+// executes the program (or runs the builtin). Never returns
+void execInChild(char* program, char** arg_list, int redirectionType, char* fileName) {
+    // File redirection part (write mode or append mode)
+    if ((redirectionType == REDIRECT_WRITE) || (redirectionType == REDIRECT_APPEND)) {
+        int flags = O_WRONLY | O_CREAT | (redirectionType == REDIRECT_WRITE ? O_TRUNC : O_APPEND);
+        int file_descriptor = open(fileName, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (file_descriptor == -1) {
+            perror("Error opening the file");
+            exit(EXIT_FAILURE);
+        }
+        if (dup2(file_descriptor, STDOUT_FILENO) == -1) {
+            perror("Error redirecting standard output");
+            exit(EXIT_FAILURE);
+        }
+        close(file_descriptor);
+    }
+    // Execution part
+    // Builtin case, it runs in this child and its status is the exit status
+    struct builtin *builtin = findBuiltin(program);
+    if (builtin != NULL) {
+        // Without an exec the close-on-exec descriptors stay open, the other ends of the pipes
+        // among them (a reader holding its own pipe open would never see it closed)
+        closefrom(STDERR_FILENO + 1);
+        int numOfArguments = 0;
+        while (arg_list[numOfArguments] != NULL) {numOfArguments++;}
+        int result = builtin->function(arg_list, numOfArguments);
+        fflush(stdout);
+        exit(result);
+    }
+    // Command inside the path case
+    execResolved(program, arg_list);
+    /* execResolved returns only if an error occurs.  */
+    // Writing an error message and exit
+    fprintf(stderr, "An error occurred in execve\n");
+    exit(EXIT_FAILURE);
+}
+// Launches a command (whose program is at fullPath) with posix_spawn. The child is put into the process group pgid (a new one
+// if pgid is 0, and given the terminal if it is a foreground job), gets the default dispositions
+// of the signals the shell ignores or catches, gets the signal mask of childMask, gets its stdin
+// and stdout connected to inputFd and outputFd (if they are not -1) and then its stdout
+// redirected to the file (> >>). Returns the pid, -1 on error
+pid_t posixSpawnCommand(char** arg_list, char* fullPath, int inputFd, int outputFd, int redirectionType, char* fileName, pid_t pgid, int isForeground, sigset_t* childMask) {
+    char *program = arg_list[0];
+
+    // Attributes: process group, signal dispositions and mask
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setpgroup(&attributes, pgid);
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGINT);
+    sigaddset(&defaultSignals, SIGQUIT);
+    sigaddset(&defaultSignals, SIGTSTP);
+    sigaddset(&defaultSignals, SIGTTIN);
+    sigaddset(&defaultSignals, SIGTTOU);
+    sigaddset(&defaultSignals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    posix_spawnattr_setsigmask(&attributes, childMask);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    // File actions: the pipes and the redirections
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+#if __GLIBC_PREREQ(2, 35)
+    // The child takes the terminal itself, so it owns it before exec (the parent does it too, later)
+    if (shellIsInteractive && isForeground) {
+        posix_spawn_file_actions_addtcsetpgrp_np(&fileActions, STDIN_FILENO);
+    }
+#endif
+    // The originals are close-on-exec, only the duplicates survive
+    if (inputFd != -1) {
+        posix_spawn_file_actions_adddup2(&fileActions, inputFd, STDIN_FILENO);
+    }
+    if (outputFd != -1) {
+        posix_spawn_file_actions_adddup2(&fileActions, outputFd, STDOUT_FILENO);
+    }
+    if ((redirectionType == REDIRECT_WRITE) || (redirectionType == REDIRECT_APPEND)) {
+        int flags = O_WRONLY | O_CREAT | (redirectionType == REDIRECT_WRITE ? O_TRUNC : O_APPEND);
+        posix_spawn_file_actions_addopen(&fileActions, STDOUT_FILENO, fileName, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    }
+
+    pid_t child_pid;
+    int result = posix_spawn(&child_pid, fullPath, &fileActions, &attributes, arg_list, environ);
+    posix_spawn_file_actions_destroy(&fileActions);
+    posix_spawnattr_destroy(&attributes);
+    if (result != 0) {
+        // posix_spawn reports the errors of the child (open, exec) as its result
+        if ((redirectionType == REDIRECT_WRITE) || (redirectionType == REDIRECT_APPEND)) {
+            fprintf(stderr, "An error occurred in posix_spawn (%s or %s): %s\n", program, fileName, strerror(result));
+        } else {
+            fprintf(stderr, "An error occurred in posix_spawn (%s): %s\n", program, strerror(result));
+        }
+        return -1;
+    }
+    numOfPosixSpawns++;
+    numOfExecs++;
+    return child_pid;
+}
+// Starts the zygote (if MYSHELL_ZYGOTE=1 is set), see the Zygote section
+void startZygote() {
+    char *zygote = getenv("MYSHELL_ZYGOTE");
+    if ((zygote == NULL) || (strcmp(zygote, "1") != 0)) {
+        return;
+    }
+    int socketFds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socketFds) == -1) {
+        perror("Error creating the zygote's socket");
+        return;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork Failed");
+        close(socketFds[0]);
+        close(socketFds[1]);
+        return;
+    }
+    if (pid == 0) {
+        close(socketFds[0]);
+        runZygote(socketFds[1]);
+    }
+    numOfForks++;
+    close(socketFds[1]);
+    zygoteFd = socketFds[0];
+}
+// The zygote's loop: serves the requests until the shell closes its end of the socket
+void runZygote(int socketFd) {
+    // Its own process group, so a Ctrl-C sent to the shell's group does not kill it. Its children
+    // take the terminal from a background group, so SIGTTOU must be ignored until they reset it
+    setpgid(0, 0);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+    if (signalFd != -1) {close(signalFd);}
+    if (childEpollFd != -1) {close(childEpollFd);}
+    if (inputEpollFd != -1) {close(inputEpollFd);}
+
+    char *buffer = malloc(ZYGOTE_MESSAGE_MAX + 1);
+    while (1) {
+        struct iovec vector = {buffer, ZYGOTE_MESSAGE_MAX};
+        char control[CMSG_SPACE(2 * sizeof(int))];
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t length = recvmsg(socketFd, &message, MSG_CMSG_CLOEXEC);
+        if ((length == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (length <= 0) {
+            _exit(0); // The shell has gone
+        }
+
+        // The descriptors of its stdin and stdout, if any
+        int fds[2] = {-1, -1};
+        int numOfFds = 0;
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        if ((header != NULL) && (header->cmsg_level == SOL_SOCKET) && (header->cmsg_type == SCM_RIGHTS)) {
+            numOfFds = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(header), numOfFds * sizeof(int));
+        }
+        struct zygoteRequest *request = (struct zygoteRequest *) buffer;
+        struct zygoteReply reply = {-1, EINVAL};
+        if ((length >= (ssize_t) sizeof(struct zygoteRequest)) && (numOfFds == request->hasInputFd + request->hasOutputFd)) {
+            buffer[length] = '\0';
+            zygoteLaunch(request, buffer + sizeof(struct zygoteRequest), request->hasInputFd ? fds[0] : -1,
+                         request->hasOutputFd ? fds[request->hasInputFd] : -1, socketFd, &reply);
+        }
+        for (int i = 0; i < numOfFds; i++) {
+            close(fds[i]);
+        }
+        while ((send(socketFd, &reply, sizeof(reply), 0) == -1) && (errno == EINTR)) {}
+    }
+}
+// Creates the child of a request, inside the zygote. The child shares the zygote's memory and
+// the zygote sleeps until it has executed its program (CLONE_VM | CLONE_VFORK, like posix_spawn
+// does), so no page tables are copied and a failure is simply written into the shared launch
+void zygoteLaunch(struct zygoteRequest *request, char *strings, int inputFd, int outputFd, int socketFd, struct zygoteReply *reply) {
+    static char *stack = NULL; // The stack of the child, used until it executes its program
+    if (stack == NULL) {
+        stack = malloc(ZYGOTE_STACK_SIZE);
+    }
+
+    // Splitting the strings
+    struct zygoteLaunch launch = {request, strings, NULL, NULL, inputFd, outputFd, socketFd, 0};
+    launch.fileName = launch.program + strlen(launch.program) + 1;
+    launch.arguments = malloc((request->numOfArguments + 1) * sizeof(char *));
+    char *argument = launch.fileName + strlen(launch.fileName) + 1;
+    for (int i = 0; i < request->numOfArguments; i++) {
+        launch.arguments[i] = argument;
+        argument += strlen(argument) + 1;
+    }
+    launch.arguments[request->numOfArguments] = NULL;
+
+    // CLONE_PARENT makes the child's parent the shell, not us
+    pid_t pid = clone(zygoteChild, stack + ZYGOTE_STACK_SIZE, CLONE_VM | CLONE_VFORK | CLONE_PARENT | SIGCHLD, &launch);
+    free(launch.arguments);
+    reply->pid = pid;
+    reply->errorNumber = pid < 0 ? errno : launch.errorNumber;
+}
+// The child of a request, from the clone to exec. On failure the reason is left in launch->errorNumber
+int zygoteChild(void *argument) {
+    struct zygoteLaunch *launch = argument;
+    struct zygoteRequest *request = launch->request;
+    close(launch->socketFd);
+    setpgid(0, request->pgid);
+    if (shellIsInteractive && request->isForeground) {
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+    }
+    resetChildSignals(&childSignalMask);
+    if (((launch->inputFd != -1) && (dup2(launch->inputFd, STDIN_FILENO) == -1)) ||
+        ((launch->outputFd != -1) && (dup2(launch->outputFd, STDOUT_FILENO) == -1))) {
+        launch->errorNumber = errno;
+        _exit(127);
+    }
+    if ((request->redirectionType == REDIRECT_WRITE) || (request->redirectionType == REDIRECT_APPEND)) {
+        int flags = O_WRONLY | O_CREAT | (request->redirectionType == REDIRECT_WRITE ? O_TRUNC : O_APPEND);
+        int fileFd = open(launch->fileName, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if ((fileFd == -1) || (dup2(fileFd, STDOUT_FILENO) == -1)) {
+            launch->errorNumber = errno;
+            _exit(127);
+        }
+        close(fileFd);
+    }
+    if (applyPlacement(&request->placement) != 0) {
+        _exit(EXIT_FAILURE);
+    }
+    execve(launch->program, launch->arguments, environ);
+    launch->errorNumber = errno;
+    _exit(127);
+}
+// Launches a command (whose program is at fullPath) through the zygote, which does for the child
+// what posixSpawnCommand does (and applies the placement). Returns the pid, -1 on error, -2 if
+// the zygote cannot take it (then the caller launches it itself)
+pid_t zygoteSpawnCommand(char** arg_list, char* fullPath, int inputFd, int outputFd, int redirectionType, char* fileName, pid_t pgid, int isForeground, struct placement *placement) {
+    static char buffer[ZYGOTE_MESSAGE_MAX];
+
+    // The request: the header, then the strings
+    struct zygoteRequest request;
+    memset(&request, 0, sizeof(request));
+    request.pgid = pgid;
+    request.isForeground = isForeground;
+    request.redirectionType = (redirectionType == REDIRECT_WRITE) || (redirectionType == REDIRECT_APPEND) ? redirectionType : REDIRECT_NONE;
+    request.hasInputFd = inputFd != -1;
+    request.hasOutputFd = outputFd != -1;
+    if (placement != NULL) {request.placement = *placement;}
+    size_t length = sizeof(request);
+    const char *fixedStrings[2] = {fullPath, request.redirectionType != REDIRECT_NONE ? fileName : ""};
+    for (int i = 0; (i < 2) || (arg_list[i - 2] != NULL); i++) {
+        const char *string = i < 2 ? fixedStrings[i] : arg_list[i - 2];
+        size_t stringLength = strlen(string) + 1;
+        if (length + stringLength > ZYGOTE_MESSAGE_MAX) {
+            return -2;
+        }
+        memcpy(buffer + length, string, stringLength);
+        length += stringLength;
+        if (i >= 2) {request.numOfArguments++;}
+    }
+    memcpy(buffer, &request, sizeof(request));
+
+    // Sending it with the descriptors
+    struct iovec vector = {buffer, length};
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    int fds[2], numOfFds = 0;
+    if (inputFd != -1) {fds[numOfFds++] = inputFd;}
+    if (outputFd != -1) {fds[numOfFds++] = outputFd;}
+    if (numOfFds > 0) {
+        message.msg_control = control;
+        message.msg_controllen = CMSG_SPACE(numOfFds * sizeof(int));
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(numOfFds * sizeof(int));
+        memcpy(CMSG_DATA(header), fds, numOfFds * sizeof(int));
+    }
+    struct zygoteReply reply;
+    ssize_t result;
+    while (((result = sendmsg(zygoteFd, &message, MSG_NOSIGNAL)) == -1) && (errno == EINTR)) {}
+    if (result != -1) {
+        while (((result = recv(zygoteFd, &reply, sizeof(reply), 0)) == -1) && (errno == EINTR)) {}
+    }
+    if (result != (ssize_t) sizeof(reply)) {
+        // The zygote has gone, we launch everything ourselves from now on
+        fprintf(stderr, "Warning: the zygote has stopped, launching commands without it\n");
+        close(zygoteFd);
+        zygoteFd = -1;
+        return -2;
+    }
+
+    if (reply.errorNumber != 0) {
+        // A child which could not execute its program has already exited, it is reaped here
+        if (reply.pid > 0) {
+            waitpid(reply.pid, NULL, 0);
+        }
+        if (request.redirectionType != REDIRECT_NONE) {
+            fprintf(stderr, "An error occurred in the zygote (%s or %s): %s\n", arg_list[0], fileName, strerror(reply.errorNumber));
+        } else {
+            fprintf(stderr, "An error occurred in the zygote (%s): %s\n", arg_list[0], strerror(reply.errorNumber));
+        }
+        return -1;
+    }
+    numOfZygoteLaunches++;
+    numOfExecs++;
+    return reply.pid;
+}
+// Classic djb2 string hash, used for choosing the bucket of a key
+unsigned long hashString(const char *str) {
+    unsigned long hash = 5381;
+    int c;
+    while ((c = (unsigned char) *str++)) {
+        hash = ((hash << 5) + hash) + c; // hash * 33 + c
+    }
+    return hash;
+}
+// Removes every entry of the PATH hash table (this is what "hash -r" does)
+void clearPathHash() {
+    for (int i = 0; i < PATH_HASH_SIZE; i++) {
+        struct pathHashEntry *entry = pathHashTable[i];
+        while (entry != NULL) {
+            struct pathHashEntry *next = entry->next;
+            free(entry->name);
+            free(entry->fullPath);
+            free(entry);
+            entry = next;
+        }
+        pathHashTable[i] = NULL;
+    }
+    pathGeneration++; // Cached plans may point to the forgotten paths
+}
+// Makes sure the PATH hash table still describes the current PATH. If PATH itself has
+// changed, the directory list is rebuilt and the table is emptied. Otherwise, at most once
+// per second, the mtimes of the PATH directories are compared with the stored ones, and
+// the table is emptied if any of them has changed (a binary was added, removed or renamed)
+void validatePathHash() {
+    char *path = getenv("PATH");
+    if (path == NULL) {path = "";}
+
+    // PATH has changed (or the table was never built), rebuild the directory list
+    if ((hashedPathValue == NULL) || (strcmp(hashedPathValue, path) != 0)) {
+        clearPathHash();
+        for (int i = 0; i < numOfPathDirectories; i++) {
+            free(pathDirectories[i].directory);
+            for (int j = 0; j < pathDirectories[i].numOfNames; j++) {
+                free(pathDirectories[i].names[j]);
+            }
+            free(pathDirectories[i].names);
+        }
+        free(pathDirectories);
+        freeTrie(commandTrie); // Its names came from the old directories
+        commandTrie = NULL;
+        free(hashedPathValue);
+        hashedPathValue = strdup(path);
+        pathDirectories = NULL;
+        numOfPathDirectories = 0;
+
+        // Splitting the PATH into its directories
+        char *pathCopy = strdup(path);
+        char *pathToken = strtok(pathCopy, ":");
+        while (pathToken != NULL) {
+            pathDirectories = realloc(pathDirectories, (numOfPathDirectories + 1) * sizeof(struct pathDirectory));
+            pathDirectories[numOfPathDirectories].directory = strdup(pathToken);
+            pathDirectories[numOfPathDirectories].names = NULL;
+            pathDirectories[numOfPathDirectories].numOfNames = 0;
+            pathDirectories[numOfPathDirectories].scannedTime.tv_sec = 0;
+            pathDirectories[numOfPathDirectories].scannedTime.tv_nsec = -1;
+            struct stat directoryInfo;
+            if (stat(pathToken, &directoryInfo) == 0) {
+                pathDirectories[numOfPathDirectories].modificationTime = directoryInfo.st_mtim;
+            } else {
+                // Directory does not exist (yet), a zero mtime will be noticed once it is created
+                pathDirectories[numOfPathDirectories].modificationTime.tv_sec = 0;
+                pathDirectories[numOfPathDirectories].modificationTime.tv_nsec = 0;
+            }
+            numOfPathDirectories++;
+            pathToken = strtok(NULL, ":");
+        }
+        free(pathCopy);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        lastPathCheck = now.tv_sec;
+        return;
+    }
+
+    // Same PATH, checking the directory mtimes (at most once per second, to keep it cheap)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    if (now.tv_sec == lastPathCheck) {
+        return;
+    }
+    lastPathCheck = now.tv_sec;
+
+    int hasChanged = 0; // Becomes 1 if any of the directories has been modified
+    for (int i = 0; i < numOfPathDirectories; i++) {
+        struct stat directoryInfo;
+        struct timespec newTime = {0, 0};
+        if (stat(pathDirectories[i].directory, &directoryInfo) == 0) {
+            newTime = directoryInfo.st_mtim;
+        }
+        if ((newTime.tv_sec != pathDirectories[i].modificationTime.tv_sec) ||
+            (newTime.tv_nsec != pathDirectories[i].modificationTime.tv_nsec)) {
+            pathDirectories[i].modificationTime = newTime;
+            hasChanged = 1;
+        }
+    }
+    if (hasChanged) {
+        clearPathHash();
+    }
+}
+// Returns the absolute path of a command, NULL if it cannot be found. The result is taken from
+// the PATH hash table if possible, otherwise the PATH directories are searched and the result
+// is stored in the table. The returned string belongs to the table, it must not be freed
+char *lookupCommand(const char *name) {
+    // Names with a slash are not searched inside PATH, just like execvp
+    if (strchr(name, '/') != NULL) {
+        if (access(name, X_OK) == 0) {
+            return (char *) name;
+        }
+        return NULL;
+    }
+
+    validatePathHash();
+
+    // Looking up the table first
+    unsigned long bucket = hashString(name) & (PATH_HASH_SIZE - 1);
+    for (struct pathHashEntry *entry = pathHashTable[bucket]; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->name, name) == 0) {
+            entry->hits++;
+            return entry->fullPath;
+        }
+    }
+
+    // Not in the table, searching the PATH directories one by one
+    size_t nameLength = strlen(name);
+    for (int i = 0; i < numOfPathDirectories; i++) {
+        size_t directoryLength = strlen(pathDirectories[i].directory);
+        char executablePath[directoryLength + nameLength + 2];
+        memcpy(executablePath, pathDirectories[i].directory, directoryLength);
+        executablePath[directoryLength] = '/';
+        memcpy(executablePath + directoryLength + 1, name, nameLength + 1);
+
+        // Command found in the path, storing it in the table
+        if (access(executablePath, X_OK) == 0) {
+            struct pathHashEntry *entry = malloc(sizeof(struct pathHashEntry));
+            entry->name = strdup(name);
+            entry->fullPath = strdup(executablePath);
+            entry->hits = 1;
+            entry->next = pathHashTable[bucket];
+            pathHashTable[bucket] = entry;
+            return entry->fullPath;
+        }
+    }
+    return NULL;
+}
+// Executes the given program with execve, using the path resolved by lookupCommand. As the
+// parent has already resolved the command before forking, this is only a table hit in the child.
+// Returns only if an error occurs
+void execResolved(char *program, char **arg_list) {
+    char *fullPath = lookupCommand(program);
+    if (fullPath == NULL) {
+        errno = ENOENT;
+        return;
+    }
+    execve(fullPath, arg_list, environ);
+}
+// Checks whether a command in inside the path or not (excluding bello command)
+int isInPath(const char *token) {
+    // If path is null, return error, set error flag and corresponding error message
+    if (getenv("PATH") == NULL) {fprintf(stderr, "PATH environment variable not found\n");error=1;return 0;}
+
+    // Searching the command through the PATH hash table, if found return 1
+    double lookupStart = traceClock();
+    char *fullPath = lookupCommand(token);
+    recordSpan("isInPath", token, lookupStart, traceClock());
+    if (fullPath != NULL) {
+        return 1;
+    }
+    // In case of bello, no need to give error, as it is an exceptional case
+    // If it is not bello and not found in the path, follow the similar error procedures as before
+    // (Indeed, bello is not in our path, but we don't want this function to print error
+    // each time we run a bello command. That's the reason why we are doing this exception)
+    if (strcmp(token,"bello") != 0) {
+        fprintf(stderr, "Error: '%s' not found in the PATH\n", token);
+        error = 1;
+    }
+    return 0;
+}
+// The hash builtin. Without arguments it lists the remembered commands, "hash -r" forgets
+// all of them, and "hash name..." resolves and remembers the given names
+int hashBuiltin(char **tokens, int numOfTokens) {
+    // hash -r, emptying the table
+    if ((numOfTokens > 1) && (strcmp(tokens[1], "-r") == 0)) {
+        clearPathHash();
+        return 0;
+    }
+    // hash name..., resolving each of the names
+    if (numOfTokens > 1) {
+        for (int i = 1; i < numOfTokens; i++) {
+            if (lookupCommand(tokens[i]) == NULL) {
+                fprintf(stderr, "hash: %s: not found\n", tokens[i]);
+                error = 1;
+            }
+        }
+        return error;
+    }
+    // hash, printing the table
+    validatePathHash();
+    int isEmpty = 1;
+    for (int i = 0; i < PATH_HASH_SIZE; i++) {
+        for (struct pathHashEntry *entry = pathHashTable[i]; entry != NULL; entry = entry->next) {
+            if (isEmpty) {
+                printf("hits\tcommand\n");
+                isEmpty = 0;
+            }
+            printf("%4d\t%s\n", entry->hits, entry->fullPath);
+        }
+    }
+    if (isEmpty) {
+        printf("hash: hash table empty\n");
+    }
+    return 0;
+}
+// Frees a subtree of the command trie
+void freeTrie(struct trieNode *node) {
+    while (node != NULL) {
+        struct trieNode *sibling = node->sibling;
+        freeTrie(node->child);
+        free(node);
+        node = sibling;
+    }
+}
+// Adds (change is 1) or removes (change is -1) one directory's copy of a name. The name counts
+// of the nodes on its path change only when the first copy is added or the last one removed
+void updateTrie(const char *name, int change) {
+    struct trieNode *node = commandTrie;
+    for (const char *c = name; *c != '\0'; c++) {
+        // Finding the child, or inserting it at its sorted place
+        struct trieNode **link = &node->child;
+        while ((*link != NULL) && ((unsigned char) (*link)->character < (unsigned char) *c)) {
+            link = &(*link)->sibling;
+        }
+        if ((*link == NULL) || ((*link)->character != *c)) {
+            struct trieNode *child = calloc(1, sizeof(struct trieNode));
+            child->character = *c;
+            child->sibling = *link;
+            *link = child;
+        }
+        node = *link;
+    }
+    int hadName = node->numOfDirectories > 0;
+    node->numOfDirectories += change;
+    int hasName = node->numOfDirectories > 0;
+    if (hadName == hasName) {
+        return;
+    }
+
+    // Walking the path again, counting the name in (or out of) every subtree containing it
+    int difference = hasName ? 1 : -1;
+    node = commandTrie;
+    node->numOfNames += difference;
+    for (const char *c = name; *c != '\0'; c++) {
+        node = node->child;
+        while (node->character != *c) {
+            node = node->sibling;
+        }
+        node->numOfNames += difference;
+    }
+}
+// Reads the executables of a PATH directory into the trie, replacing the ones read before.
+// The type inside the directory entry tells the regular files (and links) apart, so only they
+// are checked for the execute permission
+void scanPathDirectory(struct pathDirectory *directory, struct timespec modificationTime) {
+    for (int i = 0; i < directory->numOfNames; i++) {
+        updateTrie(directory->names[i], -1);
+        free(directory->names[i]);
+    }
+    directory->numOfNames = 0;
+    directory->scannedTime = modificationTime;
+
+    DIR *stream = opendir(directory->directory);
+    if (stream == NULL) {
+        return;
+    }
+    int capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(stream)) != NULL) {
+        if ((entry->d_type != DT_REG) && (entry->d_type != DT_LNK) && (entry->d_type != DT_UNKNOWN)) {
+            continue;
+        }
+        if (faccessat(dirfd(stream), entry->d_name, X_OK, 0) != 0) {
+            continue;
+        }
+        if (directory->numOfNames == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            directory->names = realloc(directory->names, capacity * sizeof(char *));
+        }
+        directory->names[directory->numOfNames++] = strdup(entry->d_name);
+        updateTrie(entry->d_name, 1);
+    }
+    closedir(stream);
+}
+// Brings the command trie up to date with the PATH directories. It is built on the first call,
+// afterwards only the directories whose mtime has changed are read again
+void refreshCommandTrie() {
+    validatePathHash();
+    if (commandTrie == NULL) {
+        commandTrie = calloc(1, sizeof(struct trieNode));
+    }
+    for (int i = 0; i < numOfPathDirectories; i++) {
+        struct stat directoryInfo;
+        struct timespec modificationTime = {0, 0};
+        if (stat(pathDirectories[i].directory, &directoryInfo) == 0) {
+            modificationTime = directoryInfo.st_mtim;
+        }
+        if ((modificationTime.tv_sec != pathDirectories[i].scannedTime.tv_sec) ||
+            (modificationTime.tv_nsec != pathDirectories[i].scannedTime.tv_nsec)) {
+            scanPathDirectory(&pathDirectories[i], modificationTime);
+        }
+    }
+}
+// Adds every name inside a subtree of the trie to the candidates. name holds the first length
+// bytes of them (the path to node), it must be large enough for the longest name
+void collectTrie(struct trieNode *node, char *name, size_t length, struct completion *completion) {
+    if (node->numOfDirectories > 0) {
+        addCandidate(completion, name, length, "");
+    }
+    for (struct trieNode *child = node->child; child != NULL; child = child->sibling) {
+        if (child->numOfNames > 0) {
+            name[length] = child->character;
+            collectTrie(child, name, length + 1, completion);
+        }
+    }
+}
+// Returns the cached plan of a command line, NULL if there is none. The alias table and the PATH
+// hash table are brought up to date first, and a plan made before either of them has changed is
+// removed instead of being returned. A returned plan becomes the most recently used one
+struct executionPlan *findPlan(const char *line) {
+    unsigned long bucket = hashString(line) & (PLAN_HASH_SIZE - 1);
+    struct cachedPlan *cached = planHashTable[bucket];
+    while ((cached != NULL) && (strcmp(cached->line, line) != 0)) {
+        cached = cached->next;
+    }
+    if (cached == NULL) {
+        return NULL;
+    }
+
+    // Noticing the changes made by other shells and to the PATH directories
+    syncAliases();
+    validatePathHash();
+    if ((cached->aliasGeneration != aliasGeneration) || (cached->pathGeneration != pathGeneration)) {
+        removePlan(cached);
+        return NULL;
+    }
+
+    // Moving it to the head of the LRU list
+    if (cached != newestPlan) {
+        cached->newer->older = cached->older;
+        if (cached->older != NULL) {cached->older->newer = cached->newer;}
+        else {oldestPlan = cached->newer;}
+        cached->newer = NULL;
+        cached->older = newestPlan;
+        newestPlan->newer = cached;
+        newestPlan = cached;
+    }
+    return &cached->plan;
+}
+// Stores a copy of the plan of a command line inside the cache (as the most recently used one),
+// evicting the least recently used plan if the cache is full
+void cachePlan(const char *line, struct executionPlan *plan) {
+    if (numOfCachedPlans >= PLAN_CACHE_SIZE) {
+        removePlan(oldestPlan);
+    }
+    struct cachedPlan *cached = malloc(sizeof(struct cachedPlan));
+    if (cached == NULL) {
+        return; // Only an optimization, the line can be planned again next time
+    }
+    cached->arena.head = NULL;
+    struct arena *arena = &cached->arena;
+
+    // Copying the line and the plan into the arena of the cached plan
+    size_t lineLength = strlen(line);
+    cached->line = memcpy(arenaAlloc(arena, lineLength + 1), line, lineLength + 1);
+    cached->plan = *plan;
+    cached->plan.stages = arenaAlloc(arena, plan->numOfStages * sizeof(char **));
+    cached->plan.programs = arenaAlloc(arena, plan->numOfStages * sizeof(char *));
+    for (int i = 0; i < plan->numOfStages; i++) {
+        int numOfArguments = 0;
+        while (plan->stages[i][numOfArguments] != NULL) {numOfArguments++;}
+        char **arguments = arenaAlloc(arena, (numOfArguments + 1) * sizeof(char *));
+        for (int j = 0; j < numOfArguments; j++) {
+            size_t length = strlen(plan->stages[i][j]);
+            arguments[j] = memcpy(arenaAlloc(arena, length + 1), plan->stages[i][j], length + 1);
+        }
+        arguments[numOfArguments] = NULL;
+        cached->plan.stages[i] = arguments;
+        size_t programLength = strlen(plan->programs[i]);
+        cached->plan.programs[i] = memcpy(arenaAlloc(arena, programLength + 1), plan->programs[i], programLength + 1);
+    }
+    if (plan->fileName != NULL) {
+        size_t fileNameLength = strlen(plan->fileName);
+        cached->plan.fileName = memcpy(arenaAlloc(arena, fileNameLength + 1), plan->fileName, fileNameLength + 1);
+    }
+    if (plan->inputSource != NULL) {
+        size_t inputLength = strlen(plan->inputSource);
+        cached->plan.inputSource = memcpy(arenaAlloc(arena, inputLength + 1), plan->inputSource, inputLength + 1);
+    }
+    cached->aliasGeneration = aliasGeneration;
+    cached->pathGeneration = pathGeneration;
+
+    // Inserting it into its bucket and at the head of the LRU list
+    unsigned long bucket = hashString(line) & (PLAN_HASH_SIZE - 1);
+    cached->next = planHashTable[bucket];
+    planHashTable[bucket] = cached;
+    cached->newer = NULL;
+    cached->older = newestPlan;
+    if (newestPlan != NULL) {newestPlan->newer = cached;}
+    else {oldestPlan = cached;}
+    newestPlan = cached;
+    numOfCachedPlans++;
+}
+// Removes a plan from the cache and frees it
+void removePlan(struct cachedPlan *cached) {
+    struct cachedPlan **link = &planHashTable[hashString(cached->line) & (PLAN_HASH_SIZE - 1)];
+    while (*link != cached) {
+        link = &(*link)->next;
+    }
+    *link = cached->next;
+    if (cached->newer != NULL) {cached->newer->older = cached->older;}
+    else {newestPlan = cached->older;}
+    if (cached->older != NULL) {cached->older->newer = cached->newer;}
+    else {oldestPlan = cached->newer;}
+    numOfCachedPlans--;
+    arenaFree(&cached->arena);
+    free(cached);
+}
+// Adds an alias to the table, or replaces its value if it already exists
+void setAlias(const char *key, const char *value) {
+    aliasGeneration++; // Cached plans may have been expanded with the old value
+    // An existing alias only gets its new value
+    if (aliasTableSize > 0) {
+        unsigned long bucket = hashString(key) & (aliasTableSize - 1);
+        for (struct aliasEntry *entry = aliasTable[bucket]; entry != NULL; entry = entry->next) {
+            if (strcmp(entry->key, key) == 0) {
+                free(entry->value);
+                entry->value = strdup(value);
+                return;
+            }
+        }
+    }
+
+    // Doubling the number of buckets when there are more aliases than buckets, so the chains stay short
+    if (numOfAliases >= aliasTableSize) {
+        size_t newSize = aliasTableSize == 0 ? ALIAS_TABLE_INITIAL_SIZE : aliasTableSize * 2;
+        struct aliasEntry **newTable = calloc(newSize, sizeof(struct aliasEntry *));
+        for (size_t i = 0; i < aliasTableSize; i++) {
+            struct aliasEntry *entry = aliasTable[i];
+            while (entry != NULL) {
+                struct aliasEntry *next = entry->next;
+                unsigned long newBucket = hashString(entry->key) & (newSize - 1);
+                entry->next = newTable[newBucket];
+                newTable[newBucket] = entry;
+                entry = next;
+            }
+        }
+        free(aliasTable);
+        aliasTable = newTable;
+        aliasTableSize = newSize;
+    }
+
+    unsigned long bucket = hashString(key) & (aliasTableSize - 1);
+    struct aliasEntry *entry = malloc(sizeof(struct aliasEntry));
+    entry->key = strdup(key);
+    entry->value = strdup(value);
+    entry->next = aliasTable[bucket];
+    aliasTable[bucket] = entry;
+    numOfAliases++;
+}
+// Removes every alias from the table
+void clearAliases() {
+    for (size_t i = 0; i < aliasTableSize; i++) {
+        struct aliasEntry *entry = aliasTable[i];
+        while (entry != NULL) {
+            struct aliasEntry *next = entry->next;
+            free(entry->key);
+            free(entry->value);
+            free(entry);
+            entry = next;
+        }
+        aliasTable[i] = NULL;
+    }
+    numOfAliases = 0;
+    numOfJournalLines = 0;
+    aliasGeneration++;
+}
+// Reads the "key=value" lines of the journal, starting from the current position of the
+// stream, into the table. Lines have no length limit, and an incomplete last line (which
+// another shell is still writing) is left for the next call
+void readAliasJournal(FILE *journal) {
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, journal)) > 0) {
+        if (line[length - 1] != '\n') {
+            break; // Incomplete line, will be read once it is finished
+        }
+        aliasFileOffset += length;
+        line[length - 1] = '\0';
+
+        // Key is the part before the first =, value is everything after it
+        char *equality = strchr(line, '=');
+        if (equality == NULL) {
+            continue;
+        }
+        *equality = '\0';
+        removeQuotes(line);
+        setAlias(line, equality + 1);
+        numOfJournalLines++;
+    }
+    free(line);
+}
+// Throws the table away and reads the whole journal again
+void loadAliases() {
+    clearAliases();
+    aliasFileOffset = 0;
+    aliasFileInode = 0;
+    aliasesLoaded = 1;
+
+    // This also creates the journal, if it does not exist yet
+    int fd = open(ALIAS_FILE, O_RDONLY | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd == -1) {
+        perror("Error opening the alias file");
+        return;
+    }
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) == 0) {
+        aliasFileInode = fileInfo.st_ino;
+    }
+    FILE *journal = fdopen(fd, "r");
+    readAliasJournal(journal);
+    fclose(journal);
+}
+// Brings the table up to date with the journal. The first call loads the journal and starts
+// watching its directory. Later calls only look at the journal when inotify has reported a
+// change to it. Without inotify (or in non-interactive mode), the journal is checked with stat
+// on every call
+void syncAliases() {
+    if (!aliasesLoaded) {
+        // Only an interactive shell watches the journal, as tearing down an inotify instance at
+        // exit costs milliseconds, which would dominate short scripts and -c invocations
+        aliasInotifyFd = shellIsInteractive ? inotify_init1(IN_NONBLOCK | IN_CLOEXEC) : -1;
+        if (aliasInotifyFd != -1) {
+            if (inotify_add_watch(aliasInotifyFd, ".", IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM) == -1) {
+                close(aliasInotifyFd);
+                aliasInotifyFd = -1;
+            }
+        }
+        double loadStart = traceClock();
+        loadAliases();
+        recordSpan("alias journal load", ALIAS_FILE, loadStart, traceClock());
+        return;
+    }
+
+    if (aliasInotifyFd != -1) {
+        // Draining the pending events, only the ones about the journal are interesting
+        int hasChanged = 0;
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+        while ((length = read(aliasInotifyFd, events, sizeof(events))) > 0) {
+            for (char *ptr = events; ptr < events + length; ) {
+                struct inotify_event *event = (struct inotify_event *) ptr;
+                if ((event->len > 0) && (strcmp(event->name, ALIAS_FILE) == 0)) {
+                    hasChanged = 1;
+                }
+                if (event->mask & IN_Q_OVERFLOW) {
+                    hasChanged = 1;
+                }
+                ptr += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (!hasChanged) {
+            return;
+        }
+    }
+    double readStart = traceClock();
+    readAliasChanges();
+    recordSpan("alias journal read", ALIAS_FILE, readStart, traceClock());
+}
+// Compares the journal with what we have read from it. If it has been replaced (compacted),
+// removed or truncated it is loaded again, otherwise only the newly appended lines are read
+void readAliasChanges() {
+    struct stat fileInfo;
+    if ((stat(ALIAS_FILE, &fileInfo) == -1) || (fileInfo.st_ino != aliasFileInode) || (fileInfo.st_size < aliasFileOffset)) {
+        // Replaced, removed or truncated, reading it from scratch
+        loadAliases();
+    }
+    else if (fileInfo.st_size > aliasFileOffset) {
+        // Only appended, reading the new lines
+        FILE *journal = fopen(ALIAS_FILE, "r");
+        if (journal == NULL) {
+            return;
+        }
+        fseeko(journal, aliasFileOffset, SEEK_SET);
+        readAliasJournal(journal);
+        fclose(journal);
+    }
+}
+// Returns the value of an alias, NULL if it is not an alias
+char *findAlias(const char *key) {
+    syncAliases();
+    if (aliasTableSize == 0) {
+        return NULL;
+    }
+    unsigned long bucket = hashString(key) & (aliasTableSize - 1);
+    for (struct aliasEntry *entry = aliasTable[bucket]; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->key, key) == 0) {
+            return entry->value;
+        }
+    }
+    return NULL;
+}
+// Opens the journal for appending and locks it. As the journal may be replaced by another
+// shell while we are waiting for the lock, the lock is only accepted if the descriptor still
+// refers to the file at ALIAS_FILE. Returns the descriptor, -1 on error
+int openAliasFileLocked() {
+    while (1) {
+        int fd = open(ALIAS_FILE, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (fd == -1) {
+            return -1;
+        }
+        if (flock(fd, LOCK_EX) == -1) {
+            close(fd);
+            return -1;
+        }
+        struct stat lockedInfo, currentInfo;
+        if ((fstat(fd, &lockedInfo) == 0) && (stat(ALIAS_FILE, &currentInfo) == 0) &&
+            (lockedInfo.st_ino == currentInfo.st_ino) && (lockedInfo.st_dev == currentInfo.st_dev)) {
+            return fd;
+        }
+        close(fd); // It has been replaced, trying again with the new one
+    }
+}
+// Rewrites the journal so that it contains only one line per alias. Must be called while
+// holding the journal lock (see openAliasFileLocked), after the table is up to date
+int compactAliases() {
+    FILE *temp_file = fopen(ALIAS_TEMP_FILE, "w");
+    // Error check
+    if (temp_file == NULL) {
+        perror("Error opening the file");
+        return 1;
+    }
+    for (size_t i = 0; i < aliasTableSize; i++) {
+        for (struct aliasEntry *entry = aliasTable[i]; entry != NULL; entry = entry->next) {
+            fprintf(temp_file, "%s=%s\n", entry->key, entry->value);
+        }
+    }
+    fclose(temp_file);
+
+    // Replace the original file with the temporary file
+    if (rename(ALIAS_TEMP_FILE, ALIAS_FILE) != 0) {
+        perror("Error renaming file");
+        return 1;
+    }
+    return 0;
+}
+// Defines (or redefines) an alias by appending one line to the journal. The journal is compacted
+// when more than half of its lines are overridden ones
+int appendAlias(const char *key, const char *value) {
+    syncAliases();
+    int fd = openAliasFileLocked();
+    if (fd == -1) {
+        perror("Error opening the alias file");
+        return 1;
+    }
+
+    // One write call per line, so concurrent shells never interleave their lines
+    size_t keyLength = strlen(key), valueLength = strlen(value);
+    char *line = malloc(keyLength + valueLength + 2);
+    memcpy(line, key, keyLength);
+    line[keyLength] = '=';
+    memcpy(line + keyLength + 1, value, valueLength);
+    line[keyLength + valueLength + 1] = '\n';
+    ssize_t written = write(fd, line, keyLength + valueLength + 2);
+    free(line);
+    if (written == -1) {
+        perror("Error writing the alias file");
+        close(fd);
+        return 1;
+    }
+
+    // Reading our line back together with whatever the other shells have appended
+    readAliasChanges();
+
+    int result = 0;
+    if (numOfJournalLines > 2 * numOfAliases + 32) {
+        result = compactAliases();
+        loadAliases();
+    }
+    close(fd); // Also releases the lock
+    return result;
+}
+// The alias builtin. "alias key = value" (or "alias key=value") defines an alias, "alias" alone lists all of them
+int aliasBuiltin(char **tokens, int numOfTokens) {
+    // Listing the aliases
+    if (numOfTokens == 1) {
+        syncAliases();
+        for (size_t i = 0; i < aliasTableSize; i++) {
+            for (struct aliasEntry *entry = aliasTable[i]; entry != NULL; entry = entry->next) {
+                printf("alias %s=\"%s\"\n", entry->key, entry->value);
+            }
+        }
+        return 0;
+    }
+    // Extracting key and value. The tokenizer has already removed the quotes, and the
+    // assignment may be written as name = value, name=value, name= value or name =value
+    char* variable = tokens[1];
+    char* value = NULL;
+    char* equality = strchr(variable, '=');
+    if (equality != NULL) {
+        *equality = '\0';
+        value = equality + 1;
+        if ((*value == '\0') && (numOfTokens > 2)) {value = tokens[2];}
+    } else if ((numOfTokens > 2) && (tokens[2][0] == '=')) {
+        value = tokens[2] + 1;
+        if ((*value == '\0') && (numOfTokens > 3)) {value = tokens[3];}
+    }
+
+    // Checking the form of the assignment
+    if ((value == NULL) || (variable[0] == '\0')) {
+        fprintf(stderr, "alias: usage: alias name = \"command\"\n");
+        error = 1;
+        return 1;
+    }
+
+    if (appendAlias(variable, value) != 0) {
+        error = 1;
+        return 1;
+    }
+    return 0;
+}
+// Reverses the bytes of src into dst (dst[i] = src[length - 1 - i]). The two must not overlap
+#if defined(__x86_64__)
+__attribute__((target("ssse3")))
+static void reverseBytesSSSE3(char *dst, const char *src, size_t length) {
+    // pshufb reverses 16 bytes at a time
+    const __m128i mask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) (src + length - i - 16));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_shuffle_epi8(block, mask));
+    }
+    for (; i < length; i++) {
+        dst[i] = src[length - 1 - i];
+    }
+}
+#endif
+void reverseBytes(char *dst, const char *src, size_t length) {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("ssse3")) {
+        reverseBytesSSSE3(dst, src, length);
+        return;
+    }
+#endif
+    // Portable version, reverses 8 bytes at a time with a byte swap
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        unsigned long long word;
+        memcpy(&word, src + length - i - 8, 8);
+        word = __builtin_bswap64(word);
+        memcpy(dst + i, &word, 8);
+    }
+    for (; i < length; i++) {
+        dst[i] = src[length - 1 - i];
+    }
+}
+// Creates an anonymous temp file for the spilled >>> output, -1 on error
+int openSpillFile() {
+    char *directory = getenv("TMPDIR");
+    if (directory == NULL) {directory = "/tmp";}
+
+    // O_TMPFILE gives a file without a name, which disappears when it is closed
+    int fd = open(directory, O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd != -1) {
+        return fd;
+    }
+    // The file system does not support O_TMPFILE, using a named file and removing its name
+    char templatePath[strlen(directory) + 32];
+    snprintf(templatePath, sizeof(templatePath), "%s/myshell-reverse-XXXXXX", directory);
+    fd = mkostemp(templatePath, O_CLOEXEC);
+    if (fd != -1) {
+        unlink(templatePath);
+    }
+    return fd;
+}
+// Our >>> engine. Drains readFd until end of file (so it must be called while the writer is
+// still running, otherwise a child with a lot of output would block on a full pipe), then
+// appends the output in reverse order to fileName, followed by a newline (a trailing newline of
+// the output is not reversed, it stays at the end). Small output is kept in memory. Larger output
+// is spliced into a temp file, which is mapped and reversed block by block from its end, so the
+// memory use stays bounded no matter how large the output is. Returns 0 on success, 1 on error
+int reverseAppend(int readFd, const char *fileName) {
+    char *memoryBuffer = malloc(REVERSE_MEMORY_LIMIT); // Holds the output until it gets too large
+    size_t bufferedLength = 0; // Bytes inside memoryBuffer
+    int spillFd = -1; // Temp file, once the output does not fit into memoryBuffer
+    off_t spilledLength = 0; // Bytes inside the temp file
+    if (memoryBuffer == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    // Reading the output into memory as long as it fits
+    while (1) {
+        if (bufferedLength == REVERSE_MEMORY_LIMIT) {
+            break;
+        }
+        ssize_t bytesRead = read(readFd, memoryBuffer + bufferedLength, REVERSE_MEMORY_LIMIT - bufferedLength);
+        if (bytesRead == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead == -1) {
+            perror("Error reading from pipe");
+            free(memoryBuffer);
+            return 1;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        bufferedLength += bytesRead;
+    }
+
+    // Memory is full, moving the rest of the output into the temp file
+    if (bufferedLength == REVERSE_MEMORY_LIMIT) {
+        spillFd = openSpillFile();
+        if (spillFd == -1) {
+            perror("Error creating the temp file");
+            free(memoryBuffer);
+            return 1;
+        }
+        if (write(spillFd, memoryBuffer, bufferedLength) != (ssize_t) bufferedLength) {
+            perror("Error writing the temp file");
+            free(memoryBuffer);
+            close(spillFd);
+            return 1;
+        }
+        spilledLength = bufferedLength;
+        bufferedLength = 0;
+
+        // splice moves the pipe pages into the file without copying them through user space,
+        // read/write is used if the file system does not support it
+        int canSplice = 1;
+        while (1) {
+            ssize_t bytesMoved;
+            if (canSplice) {
+                bytesMoved = splice(readFd, NULL, spillFd, NULL, REVERSE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+                if (bytesMoved == -1 && errno == EINVAL) {
+                    canSplice = 0;
+                    continue;
+                }
+            } else {
+                bytesMoved = read(readFd, memoryBuffer, REVERSE_MEMORY_LIMIT);
+                if (bytesMoved > 0 && write(spillFd, memoryBuffer, bytesMoved) != bytesMoved) {
+                    bytesMoved = -1;
+                }
+            }
+            if (bytesMoved == -1 && errno == EINTR) {
+                continue;
+            }
+            if (bytesMoved == -1) {
+                perror("Error writing the temp file");
+                free(memoryBuffer);
+                close(spillFd);
+                return 1;
+            }
+            if (bytesMoved == 0) {
+                break;
+            }
+            spilledLength += bytesMoved;
+        }
+    }
+
+    // The whole output, either in memory or mapped from the temp file
+    const char *output = memoryBuffer;
+    size_t outputLength = bufferedLength;
+    if (spillFd != -1) {
+        output = mmap(NULL, spilledLength, PROT_READ, MAP_PRIVATE, spillFd, 0);
+        if (output == MAP_FAILED) {
+            perror("Error mapping the temp file");
+            free(memoryBuffer);
+            close(spillFd);
+            return 1;
+        }
+        outputLength = spilledLength;
+    }
+
+    // Nothing to append
+    if (outputLength == 0) {
+        free(memoryBuffer);
+        return 0;
+    }
+
+    // Appends the reversed output to the destination file
+    // File descriptor part
+    int file_descriptor = open(fileName, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                               S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (file_descriptor == -1) {
+        perror("Error opening the file");
+        if (spillFd != -1) {munmap((void *) output, outputLength); close(spillFd);}
+        free(memoryBuffer);
+        return 1;
+    }
+
+    // The trailing newline stays at the end, the rest is reversed
+    size_t remaining = outputLength;
+    if (output[remaining - 1] == '\n') {
+        remaining--;
+    }
+    char *reversedBlock = malloc(REVERSE_CHUNK + 1);
+    int result = 0;
+    if (reversedBlock == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        result = 1;
+    }
+    // Walking from the end of the output to its beginning, one block at a time
+    while (result == 0) {
+        size_t blockLength = remaining < REVERSE_CHUNK ? remaining : REVERSE_CHUNK;
+        reverseBytes(reversedBlock, output + remaining - blockLength, blockLength);
+        remaining -= blockLength;
+        if (remaining == 0) {
+            reversedBlock[blockLength++] = '\n'; // The last block carries the newline
+        }
+        for (size_t written = 0; written < blockLength; ) {
+            ssize_t bytesWritten = write(file_descriptor, reversedBlock + written, blockLength - written);
+            if (bytesWritten == -1 && errno == EINTR) {
+                continue;
+            }
+            if (bytesWritten == -1) {
+                perror("Error writing the file");
+                result = 1;
+                break;
+            }
+            written += bytesWritten;
+        }
+        // Dropping the pages we are done with, so the mapping does not grow our memory use
+        if (spillFd != -1) {
+            size_t pageSize = sysconf(_SC_PAGESIZE);
+            size_t doneFrom = (remaining + pageSize - 1) & ~(pageSize - 1);
+            if (doneFrom < outputLength) {
+                madvise((char *) output + doneFrom, outputLength - doneFrom, MADV_DONTNEED);
+            }
+        }
+        if (remaining == 0) {
+            break;
+        }
+    }
+
+    // Closing everything
+    free(reversedBlock);
+    close(file_descriptor);
+    if (spillFd != -1) {
+        munmap((void *) output, outputLength);
+        close(spillFd);
+    }
+    free(memoryBuffer);
+    return result;
+}
+// Prepares the shell for job control and sets up the event loop. In interactive mode (reading
+// commands from a terminal), the shell waits until it is in the foreground, puts itself into its
+// own process group, takes the terminal and ignores the job control signals (they are meant for
+// the foreground job, not for us). SIGINT is blocked and read from the signalfd instead of being
+// ignored, as an ignored signal would never reach it
+void initShell(int isInteractive) {
+    // Choosing the launch backend
+    char *backend = getenv("MYSHELL_SPAWN");
+    useForkBackend = (backend != NULL) && (strcmp(backend, "fork") == 0);
+
+    // Spreading the background jobs over our CPUs, if asked for
+    char *filters = getenv("MYSHELL_FILTERS");
+    useStreamFilters = (filters == NULL) || (strcmp(filters, "0") != 0);
+    char *spread = getenv("MYSHELL_SPREAD_JOBS");
+    spreadBackgroundJobs = (spread != NULL) && (strcmp(spread, "1") == 0) &&
+                           (sched_getaffinity(0, sizeof(shellCpus), &shellCpus) == 0);
+    // Tracing from the start, so that -c commands and scripts can be traced as well
+    char *trace = getenv("MYSHELL_TRACE");
+    if ((trace != NULL) && (strcmp(trace, "1") == 0)) {
+        startTracing();
+    }
+
+    shellIsInteractive = isInteractive;
+    shellPgid = getpgrp();
+    if (shellIsInteractive) {
+        // Waiting until we are in the foreground
+        while (tcgetpgrp(STDIN_FILENO) != (shellPgid = getpgrp())) {
+            kill(-shellPgid, SIGTTIN);
+        }
+    }
+
+    // Blocking the signals we read from the signalfd, the children get the original mask back
+    sigemptyset(&shellSignals);
+    sigaddset(&shellSignals, SIGCHLD);
+    if (shellIsInteractive) {
+        sigaddset(&shellSignals, SIGINT);
+        sigaddset(&shellSignals, SIGWINCH);
+    }
+    sigprocmask(SIG_BLOCK, &shellSignals, &childSignalMask);
+    signalFd = signalfd(-1, &shellSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    childEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if ((signalFd == -1) || (childEpollFd == -1)) {
+        perror("Error setting up the event loop");
+        exit(1);
+    }
+    struct epoll_event event = {EPOLLIN, {.fd = signalFd}};
+    epoll_ctl(childEpollFd, EPOLL_CTL_ADD, signalFd, &event);
+    startZygote();
+
+    if (!shellIsInteractive) {
+        return;
+    }
+    // The line editor waits for a key and for the children at the same time
+    inputEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (inputEpollFd != -1) {
+        struct epoll_event inputEvent = {EPOLLIN, {.fd = STDIN_FILENO}};
+        struct epoll_event childEvent = {EPOLLIN, {.fd = childEpollFd}};
+        if ((epoll_ctl(inputEpollFd, EPOLL_CTL_ADD, STDIN_FILENO, &inputEvent) == -1) ||
+            (epoll_ctl(inputEpollFd, EPOLL_CTL_ADD, childEpollFd, &childEvent) == -1)) {
+            close(inputEpollFd);
+            inputEpollFd = -1;
+        }
+    }
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+
+    // Putting ourselves into our own process group and taking the terminal
+    shellPgid = getpid();
+    if ((getpgrp() != shellPgid) && (setpgid(shellPgid, shellPgid) == -1)) {
+        perror("Couldn't put the shell in its own process group");
+    }
+    tcsetpgrp(STDIN_FILENO, shellPgid);
+}
+// Opens a pidfd of a new child and adds it to childEpollFd. Returns the pidfd, -1 if the kernel
+// has no pidfds (the process is then reaped by its pid, once a SIGCHLD arrives)
+int watchProcess(pid_t pid) {
+    int pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd == -1) {
+        return -1;
+    }
+    struct epoll_event event = {EPOLLIN, {.fd = pidfd}};
+    epoll_ctl(childEpollFd, EPOLL_CTL_ADD, pidfd, &event);
+    return pidfd;
+}
+// Collects the state changes of a process (without waiting) and records them inside the job
+// table. The pidfd of a terminated process is closed, which also removes it from childEpollFd
+void reapProcess(struct jobProcess *process) {
+    while (process->state != JOB_DONE) {
+        siginfo_t info;
+        struct rusage usage; // Resource usage of the process, filled in once it has terminated
+        memset(&info, 0, sizeof(info));
+        int options = WEXITED | WSTOPPED | WCONTINUED | WNOHANG;
+        long result = process->pidfd != -1 ? syscall(SYS_waitid, P_PIDFD, process->pidfd, &info, options, &usage)
+                                           : syscall(SYS_waitid, P_PID, process->pid, &info, options, &usage);
+        if ((result == -1) || (info.si_pid == 0)) {
+            return;
+        }
+        // The siginfo is turned into a wait status, like the one of wait4
+        int status = 0;
+        if (info.si_code == CLD_EXITED) {
+            status = W_EXITCODE(info.si_status, 0);
+        } else if ((info.si_code == CLD_KILLED) || (info.si_code == CLD_DUMPED)) {
+            status = W_EXITCODE(0, info.si_status) | (info.si_code == CLD_DUMPED ? WCOREFLAG : 0);
+        } else if ((info.si_code == CLD_STOPPED) || (info.si_code == CLD_TRAPPED)) {
+            status = W_STOPCODE(info.si_status);
+        } else if (info.si_code == CLD_CONTINUED) {
+            status = 0xffff;
+        }
+        markProcessStatus(process->pid, status, &usage);
+    }
+    if (process->pidfd != -1) {
+        close(process->pidfd);
+        process->pidfd = -1;
+    }
+}
+// Handles everything the event loop has received so far, without waiting: the pending signals are
+// read from the signalfd, and the children whose pidfd is readable are reaped. A SIGCHLD (a child
+// has stopped or continued, or it has no pidfd) makes us look at every process of the table
+void processChildEvents() {
+    int isChildSignaled = 0;
+    struct signalfd_siginfo signals[16];
+    ssize_t bytesRead;
+    while ((bytesRead = read(signalFd, signals, sizeof(signals))) > 0) {
+        for (size_t i = 0; i < bytesRead / sizeof(struct signalfd_siginfo); i++) {
+            if (signals[i].ssi_signo == SIGCHLD) {isChildSignaled = 1;}
+            else if (signals[i].ssi_signo == SIGINT) {isInterruptPending = 1;}
+            else if (signals[i].ssi_signo == SIGWINCH) {isWindowResized = 1;}
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    int numOfEvents = epoll_wait(childEpollFd, events, MAX_EVENTS, 0);
+    for (int e = 0; e < numOfEvents; e++) {
+        if (events[e].data.fd == signalFd) {
+            continue;
+        }
+        // A filter thread has finished, finishFilters looks at which one
+        if (events[e].data.fd == filterEventFd) {
+            uint64_t numOfFinished;
+            if (read(filterEventFd, &numOfFinished, sizeof(numOfFinished)) == -1) {
+                numOfFinished = 0;
+            }
+            continue;
+        }
+        for (int i = 0; i < MAX_JOBS; i++) {
+            for (int j = 0; (jobTable[i].state != JOB_FREE) && (j < jobTable[i].numOfProcesses); j++) {
+                if (jobTable[i].processes[j].pidfd == events[e].data.fd) {
+                    reapProcess(&jobTable[i].processes[j]);
+                }
+            }
+        }
+    }
+    if (isChildSignaled) {
+        for (int i = 0; i < MAX_JOBS; i++) {
+            for (int j = 0; (jobTable[i].state != JOB_FREE) && (j < jobTable[i].numOfProcesses); j++) {
+                reapProcess(&jobTable[i].processes[j]);
+            }
+        }
+    }
+}
+// Sleeps until the event loop receives something (a signal or a terminated child) and handles it
+void waitForChildEvents() {
+    struct epoll_event event;
+    if ((epoll_wait(childEpollFd, &event, 1, -1) == -1) && (errno != EINTR)) {
+        perror("epoll_wait Failed");
+    }
+    processChildEvents();
+}
+// Records the new state of a process inside the job table and updates the state of its job.
+// The resource usage of a terminated process is added to its job's. Called by reapProcess
+void markProcessStatus(pid_t pid, int status, struct rusage *usage) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobTable[i].state == JOB_FREE) {
+            continue;
+        }
+        for (int j = 0; j < jobTable[i].numOfProcesses; j++) {
+            struct jobProcess *process = &jobTable[i].processes[j];
+            if (process->pid != pid) {
+                continue;
+            }
+            if (WIFSTOPPED(status)) {
+                process->state = JOB_STOPPED;
+            } else if (WIFCONTINUED(status)) {
+                process->state = JOB_RUNNING;
+            } else {
+                process->state = JOB_DONE;
+                process->status = status;
+                // The span of the process ends now, as its pidfd has just reported its end
+                if (isTracing && (process->launchTime != 0)) {
+                    writeTraceRecord("process", jobTable[i].commandLine, process->launchTime, nowMicroseconds() - process->launchTime,
+                                     pid, pid, status);
+                }
+                struct rusage *jobUsage = &jobTable[i].usage;
+                timeradd(&jobUsage->ru_utime, &usage->ru_utime, &jobUsage->ru_utime);
+                timeradd(&jobUsage->ru_stime, &usage->ru_stime, &jobUsage->ru_stime);
+                if (usage->ru_maxrss > jobUsage->ru_maxrss) {jobUsage->ru_maxrss = usage->ru_maxrss;}
+                jobUsage->ru_nvcsw += usage->ru_nvcsw;
+                jobUsage->ru_nivcsw += usage->ru_nivcsw;
+            }
+
+            // The job is running if any of its processes is, done if all of them are
+            int isRunning = 0, isDone = 1;
+            for (int k = 0; k < jobTable[i].numOfProcesses; k++) {
+                if (jobTable[i].processes[k].state == JOB_RUNNING) {isRunning = 1;}
+                if (jobTable[i].processes[k].state != JOB_DONE) {isDone = 0;}
+            }
+            int newState = isDone ? JOB_DONE : (isRunning ? JOB_RUNNING : JOB_STOPPED);
+            if (newState != jobTable[i].state) {
+                jobTable[i].state = newState;
+                jobTable[i].isNotified = 0;
+            }
+            return;
+        }
+    }
+}
+// Puts a new job into the table and watches its processes. Returns its job number
+int addJob(pid_t pgid, pid_t *pids, int numOfProcesses, char *commandLine, int isBackground) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobTable[i].state != JOB_FREE) {
+            continue;
+        }
+        jobTable[i].pgid = pgid;
+        jobTable[i].processes = malloc(numOfProcesses * sizeof(struct jobProcess));
+        for (int j = 0; j < numOfProcesses; j++) {
+            jobTable[i].processes[j].pid = pids[j];
+            jobTable[i].processes[j].state = JOB_RUNNING;
+            jobTable[i].processes[j].status = 0;
+            jobTable[i].processes[j].pidfd = watchProcess(pids[j]);
+            jobTable[i].processes[j].launchTime = 0;
+        }
+        jobTable[i].numOfProcesses = numOfProcesses;
+        jobTable[i].isBackground = isBackground;
+        jobTable[i].isNotified = 0;
+        memset(&jobTable[i].usage, 0, sizeof(struct rusage));
+        jobTable[i].commandLine = strdup(commandLine);
+        // The trailing & is not part of the stored command line, describeJob adds it when needed
+        size_t length = strlen(jobTable[i].commandLine);
+        while ((length > 0) && ((jobTable[i].commandLine[length - 1] == ' ') || (jobTable[i].commandLine[length - 1] == '&'))) {
+            jobTable[i].commandLine[--length] = '\0';
+        }
+        jobTable[i].state = JOB_RUNNING;
+        if (isBackground) {
+            previousJob = currentJob;
+            currentJob = i + 1;
+        }
+        return i + 1;
+    }
+    // The table is full. spawn checks for a free slot before launching anything, so this does not happen
+    fprintf(stderr, "Warning: job table is full\n");
+    return 0;
+}
+// Returns 1 if the job table has a free slot for a new job
+int hasFreeJob() {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobTable[i].state == JOB_FREE) {
+            return 1;
+        }
+    }
+    return 0;
+}
+// Removes a job from the table
+void freeJob(int jobNumber) {
+    if (jobNumber <= 0) {
+        return;
+    }
+    struct job *job = &jobTable[jobNumber - 1];
+    for (int j = 0; j < job->numOfProcesses; j++) {
+        if (job->processes[j].pidfd != -1) {close(job->processes[j].pidfd);}
+    }
+    job->state = JOB_FREE;
+    free(job->processes);
+    free(job->commandLine);
+    job->processes = NULL;
+    job->numOfProcesses = 0;
+    job->commandLine = NULL;
+    if (currentJob == jobNumber) {
+        currentJob = previousJob;
+        previousJob = 0;
+    }
+    if (previousJob == jobNumber) {
+        previousJob = 0;
+    }
+    // Picking the most recent remaining jobs as current and previous, if they are missing
+    for (int i = MAX_JOBS - 1; (i >= 0) && ((currentJob == 0) || (previousJob == 0)); i--) {
+        if ((jobTable[i].state == JOB_FREE) || (i + 1 == currentJob)) {
+            continue;
+        }
+        if (currentJob == 0) {currentJob = i + 1;}
+        else if (previousJob == 0) {previousJob = i + 1;}
+    }
+}
+// Gives the terminal to a job and waits until it terminates or stops. A terminated job is removed from the table, a stopped one is reported and
+// becomes the current job. Returns the exit status of the job (of its last process), 128 plus
+// the signal number if it was killed, 0 if it has stopped
+int waitForJob(int jobNumber) {
+    if (jobNumber <= 0) {
+        return 1;
+    }
+    struct job *job = &jobTable[jobNumber - 1];
+    if (shellIsInteractive) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    }
+
+    // Sleeping inside the event loop until the job is no longer running
+    processChildEvents();
+    while (job->state == JOB_RUNNING) {
+        waitForChildEvents();
+    }
+
+    // Taking the terminal back
+    if (shellIsInteractive) {
+        tcsetpgrp(STDIN_FILENO, shellPgid);
+    }
+
+    // It has stopped (Ctrl-Z), it stays inside the table
+    if (job->state == JOB_STOPPED) {
+        job->isBackground = 1;
+        if (currentJob != jobNumber) {
+            previousJob = currentJob;
+            currentJob = jobNumber;
+        }
+        printf("\n");
+        describeJob(jobNumber, "Stopped");
+        job->isNotified = 1;
+        return 0;
+    }
+
+    // It has terminated
+    int status = job->processes[job->numOfProcesses - 1].status;
+    int result = 0;
+    if (WIFEXITED(status)) {
+        result = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        result = 128 + WTERMSIG(status);
+        if (WTERMSIG(status) == SIGINT) {
+            printf("\n");
+        } else if (WTERMSIG(status) != SIGPIPE) {
+            printf("%s\n", strsignal(WTERMSIG(status)));
+        }
+    }
+    lastJobUsage = job->usage;
+    hasLastJobUsage = 1;
+    freeJob(jobNumber);
+    return result;
+}
+// Prints one line about a job, like "[1]+  Running                 sleep 10 &"
+void describeJob(int jobNumber, const char *state) {
+    struct job *job = &jobTable[jobNumber - 1];
+    char mark = ' ';
+    if (jobNumber == currentJob) {mark = '+';}
+    else if (jobNumber == previousJob) {mark = '-';}
+    printf("[%d]%c  %-24s%s%s\n", jobNumber, mark, state, job->commandLine,
+           ((job->state == JOB_RUNNING) && job->isBackground) ? " &" : "");
+}
+// Reports the background jobs which have terminated or stopped since the last prompt, and
+// removes the terminated ones from the table (without reporting them in non-interactive mode)
+void reportJobs() {
+    processChildEvents();
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if ((jobTable[i].state == JOB_FREE) || jobTable[i].isNotified) {
+            continue;
+        }
+        // Scripts do not report anything, the finished jobs are only removed
+        if (!shellIsInteractive) {
+            if (jobTable[i].state == JOB_DONE) {freeJob(i + 1);}
+            continue;
+        }
+        if (jobTable[i].state == JOB_STOPPED) {
+            describeJob(i + 1, "Stopped");
+            jobTable[i].isNotified = 1;
+        }
+        else if (jobTable[i].state == JOB_DONE) {
+            int status = jobTable[i].processes[jobTable[i].numOfProcesses - 1].status;
+            char state[32] = "Done";
+            if (WIFEXITED(status) && (WEXITSTATUS(status) != 0)) {
+                snprintf(state, sizeof(state), "Exit %d", WEXITSTATUS(status));
+            } else if (WIFSIGNALED(status)) {
+                snprintf(state, sizeof(state), "%s", strsignal(WTERMSIG(status)));
+            }
+            describeJob(i + 1, state);
+            freeJob(i + 1);
+        }
+    }
+}
+// Returns 1 if reportJobs has something to print
+int hasJobsToReport() {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if ((jobTable[i].state != JOB_FREE) && (jobTable[i].state != JOB_RUNNING) && !jobTable[i].isNotified) {
+            return 1;
+        }
+    }
+    return 0;
+}
+// Number of processes of the job table which have not terminated yet
+int countLiveProcesses() {
+    processChildEvents();
+    int count = 0;
+    for (int i = 0; i < MAX_JOBS; i++) {
+        for (int j = 0; (jobTable[i].state != JOB_FREE) && (j < jobTable[i].numOfProcesses); j++) {
+            if (jobTable[i].processes[j].state != JOB_DONE) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+// Converts a job specification (%n, %+, %%, %-, or nothing for the current job) into a job
+// number. Returns 0 and prints an error if there is no such job
+int parseJobSpec(const char *spec) {
+    int jobNumber = 0;
+    if ((spec == NULL) || (strcmp(spec, "%+") == 0) || (strcmp(spec, "%%") == 0) || (strcmp(spec, "%") == 0)) {
+        jobNumber = currentJob;
+    } else if (strcmp(spec, "%-") == 0) {
+        jobNumber = previousJob;
+    } else if (spec[0] == '%') {
+        jobNumber = atoi(spec + 1);
+    } else {
+        jobNumber = atoi(spec);
+    }
+    if ((jobNumber <= 0) || (jobNumber > MAX_JOBS) || (jobTable[jobNumber - 1].state == JOB_FREE)) {
+        fprintf(stderr, "%s: no such job\n", spec == NULL ? "current" : spec);
+        error = 1;
+        return 0;
+    }
+    return jobNumber;
+}
+// Converts a signal name (TERM, SIGTERM) or number into a signal number, -1 if unknown
+int parseSignal(const char *name) {
+    if ((name[0] >= '0') && (name[0] <= '9')) {
+        long number;
+        return ((parseNumber(name, &number) == 0) && (number < NSIG)) ? (int) number : -1;
+    }
+    if (strncmp(name, "SIG", 3) == 0) {
+        name += 3;
+    }
+    for (int i = 0; signalNames[i].name != NULL; i++) {
+        if (strcasecmp(name, signalNames[i].name) == 0) {
+            return signalNames[i].number;
+        }
+    }
+    return -1;
+}
+// kill -l: without arguments lists the signal names, otherwise prints the name of every given
+// number (an exit status above 128 is the one of a process killed by signal status - 128), and
+// the number of every given name
+int listSignals(char **tokens, int numOfTokens) {
+    if (numOfTokens == 2) {
+        for (int i = 0; signalNames[i].name != NULL; i++) {
+            printf("%s%s", i == 0 ? "" : " ", signalNames[i].name);
+        }
+        printf("\n");
+        return 0;
+    }
+    int result = 0;
+    for (int a = 2; a < numOfTokens; a++) {
+        long number;
+        int signalNumber = -1;
+        if (parseNumber(tokens[a], &number) == 0) {
+            if (number > 128) {number -= 128;}
+            for (int i = 0; signalNames[i].name != NULL; i++) {
+                if (signalNames[i].number == number) {
+                    printf("%s\n", signalNames[i].name);
+                    signalNumber = (int) number;
+                }
+            }
+        } else if ((signalNumber = parseSignal(tokens[a])) > 0) {
+            printf("%d\n", signalNumber);
+        }
+        if (signalNumber <= 0) {
+            fprintf(stderr, "kill: %s: invalid signal specification\n", tokens[a]);
+            error = 1;
+            result = 1;
+        }
+    }
+    return result;
+}
+// The jobs builtin, lists the jobs inside the table
+int jobsBuiltin(char **tokens, int numOfTokens) {
+    processChildEvents();
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobTable[i].state == JOB_RUNNING) {
+            describeJob(i + 1, "Running");
+        } else if (jobTable[i].state == JOB_STOPPED) {
+            describeJob(i + 1, "Stopped");
+            jobTable[i].isNotified = 1;
+        }
+    }
+    // The finished ones are reported (and removed) as usual
+    reportJobs();
+    return 0;
+}
+// The fg builtin, continues a job in the foreground and waits for it
+int fgBuiltin(char **tokens, int numOfTokens) {
+    int jobNumber = parseJobSpec(numOfTokens > 1 ? tokens[1] : NULL);
+    if (jobNumber == 0) {
+        return 1;
+    }
+    struct job *job = &jobTable[jobNumber - 1];
+    printf("%s\n", job->commandLine);
+    fflush(stdout);
+
+    // Giving it the terminal before it continues
+    job->isBackground = 0;
+    if (shellIsInteractive) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    }
+    if (job->state == JOB_STOPPED) {
+        for (int j = 0; j < job->numOfProcesses; j++) {
+            if (job->processes[j].state == JOB_STOPPED) {job->processes[j].state = JOB_RUNNING;}
+        }
+        job->state = JOB_RUNNING;
+        kill(-job->pgid, SIGCONT);
+    }
+    // Waiting for it (if it has already terminated, this just collects its status)
+    int status = waitForJob(jobNumber);
+    if (status != 0) {
+        error = 1;
+    }
+    return status;
+}
+// The bg builtin, continues a stopped job in the background
+int bgBuiltin(char **tokens, int numOfTokens) {
+    int jobNumber = parseJobSpec(numOfTokens > 1 ? tokens[1] : NULL);
+    if (jobNumber != 0) {
+        struct job *job = &jobTable[jobNumber - 1];
+        job->isBackground = 1;
+        if (job->state == JOB_STOPPED) {
+            for (int j = 0; j < job->numOfProcesses; j++) {
+                if (job->processes[j].state == JOB_STOPPED) {job->processes[j].state = JOB_RUNNING;}
+            }
+            job->state = JOB_RUNNING;
+            job->isNotified = 0;
+            kill(-job->pgid, SIGCONT);
+        }
+        printf("[%d]%c %s &\n", jobNumber, jobNumber == currentJob ? '+' : ' ', job->commandLine);
+    }
+    return jobNumber == 0;
+}
+// The wait builtin. Without arguments it waits for all the running jobs, otherwise for the
+// given jobs (%n) or processes (pid). Returns the status of the last one waited for
+int waitBuiltin(char **tokens, int numOfTokens) {
+    processChildEvents();
+    int result = 0;
+    if (numOfTokens == 1) {
+        // Waiting until none of the jobs is running (stopped ones would never finish)
+        while (1) {
+            int isAnyRunning = 0;
+            for (int i = 0; i < MAX_JOBS; i++) {
+                if (jobTable[i].state == JOB_RUNNING) {isAnyRunning = 1;}
+            }
+            if (!isAnyRunning) {break;}
+            waitForChildEvents();
+        }
+        // The finished ones are removed silently
+        for (int i = 0; i < MAX_JOBS; i++) {
+            if (jobTable[i].state == JOB_DONE) {freeJob(i + 1);}
+        }
+    }
+    for (int a = 1; a < numOfTokens; a++) {
+        int jobNumber = 0;
+        if (tokens[a][0] == '%') {
+            jobNumber = parseJobSpec(tokens[a]);
+        } else {
+            // A process id, finding its job
+            pid_t pid = atoi(tokens[a]);
+            for (int i = 0; (i < MAX_JOBS) && (jobNumber == 0); i++) {
+                for (int j = 0; (jobTable[i].state != JOB_FREE) && (j < jobTable[i].numOfProcesses); j++) {
+                    if (jobTable[i].processes[j].pid == pid) {jobNumber = i + 1;}
+                }
+            }
+            if (jobNumber == 0) {
+                fprintf(stderr, "wait: pid %s is not a child of this shell\n", tokens[a]);
+                error = 1;
+            }
+        }
+        if (jobNumber == 0) {
+            result = 127;
+            continue;
+        }
+        while (jobTable[jobNumber - 1].state == JOB_RUNNING) {
+            waitForChildEvents();
+        }
+        if (jobTable[jobNumber - 1].state == JOB_DONE) {
+            struct job *job = &jobTable[jobNumber - 1];
+            int status = job->processes[job->numOfProcesses - 1].status;
+            result = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            freeJob(jobNumber);
+        }
+    }
+    return result;
+}
+// The kill builtin, sends a signal (SIGTERM by default) to jobs (%n) or processes (pid, a negative
+// one is a process group, after --). The signal can be given as -9, -KILL, -SIGKILL or -s KILL.
+// kill -l [signal...] lists the signals
+int killBuiltin(char **tokens, int numOfTokens) {
+    if ((numOfTokens > 1) && (strcmp(tokens[1], "-l") == 0)) {
+        return listSignals(tokens, numOfTokens);
+    }
+    int signalNumber = SIGTERM;
+    int a = 1;
+    if ((a < numOfTokens) && (strcmp(tokens[a], "--") == 0)) {
+        a++;
+    } else if ((a < numOfTokens) && (strcmp(tokens[a], "-s") == 0) && (a + 1 < numOfTokens)) {
+        signalNumber = parseSignal(tokens[a + 1]);
+        a += 2;
+    } else if ((a < numOfTokens) && (tokens[a][0] == '-') && (tokens[a][1] != '\0')) {
+        signalNumber = parseSignal(tokens[a] + 1);
+        a++;
+    }
+    if (signalNumber < 0) {
+        fprintf(stderr, "kill: invalid signal specification\n");
+        error = 1;
+        return 1;
+    }
+    if ((a < numOfTokens) && (a > 1) && (strcmp(tokens[a], "--") == 0)) {
+        a++; // kill -9 -- -1234
+    }
+    if (a >= numOfTokens) {
+        fprintf(stderr, "kill: usage: kill [-s sigspec | -signum | -sigspec] pid | jobspec ...\n");
+        error = 1;
+        return 1;
+    }
+    for (; a < numOfTokens; a++) {
+        pid_t target;
+        if (tokens[a][0] == '%') {
+            int jobNumber = parseJobSpec(tokens[a]);
+            if (jobNumber == 0) {
+                continue;
+            }
+            target = -jobTable[jobNumber - 1].pgid; // The whole process group
+        } else {
+            // Only a number, as kill(0) or a negative pid would signal whole process groups
+            long pid;
+            if ((parseNumber(tokens[a], &pid) != 0) || (pid != (pid_t) pid)) {
+                fprintf(stderr, "kill: %s: arguments must be process or job IDs\n", tokens[a]);
+                error = 1;
+                continue;
+            }
+            target = (pid_t) pid;
+        }
+        if (kill(target, signalNumber) == -1) {
+            fprintf(stderr, "kill: (%s) - %s\n", tokens[a], strerror(errno));
+            error = 1;
+        }
+    }
+    return error;
+}
+// Returns the entry of a builtin inside the dispatch table, NULL if name is not a builtin
+struct builtin *findBuiltin(const char *name) {
+    for (int i = 0; builtinTable[i].name != NULL; i++) {
+        if (strcmp(builtinTable[i].name, name) == 0) {
+            return &builtinTable[i];
+        }
+    }
+    return NULL;
+}
+// Runs a builtin inside the shell process, with the stdin of the shell swapped for the input of
+// < or <<< meanwhile (if any). Returns the status of the builtin
+int runBuiltin(struct builtin *builtin, char **arguments, int numOfArguments, int redirectionType, char *fileName, int inputType, char *inputSource) {
+    int savedStdin = -1;
+    if (inputType != INPUT_NONE) {
+        savedStdin = redirectStdin(inputType, inputSource);
+        if (savedStdin == -1) {
+            error = 1;
+            return 1;
+        }
+    }
+    int result = runBuiltinWithOutput(builtin, arguments, numOfArguments, redirectionType, fileName);
+    if (savedStdin != -1) {
+        dup2(savedStdin, STDIN_FILENO);
+        close(savedStdin);
+    }
+    return result;
+}
+// Replaces the stdin of the shell with the file of <, or with the string of <<< (written into a
+// temp file, so a builtin can read it at its own pace). Returns a copy of the old stdin, which
+// must be restored afterwards, -1 on error
+int redirectStdin(int inputType, char *inputSource) {
+    int inputFd;
+    if (inputType == INPUT_FILE) {
+        inputFd = open(inputSource, O_RDONLY | O_CLOEXEC);
+    } else {
+        inputFd = openSpillFile();
+        size_t length = strlen(inputSource);
+        struct iovec vectors[2] = {{inputSource, length}, {"\n", 1}};
+        if ((inputFd != -1) && ((writev(inputFd, vectors, 2) != (ssize_t) length + 1) || (lseek(inputFd, 0, SEEK_SET) == -1))) {
+            close(inputFd);
+            inputFd = -1;
+        }
+    }
+    if (inputFd == -1) {
+        fprintf(stderr, "Error opening %s: %s\n", inputType == INPUT_FILE ? inputSource : "the here-string", strerror(errno));
+        return -1;
+    }
+    int savedStdin = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+    if ((savedStdin == -1) || (dup2(inputFd, STDIN_FILENO) == -1)) {
+        perror("Error redirecting standard input");
+        if (savedStdin != -1) {close(savedStdin);}
+        close(inputFd);
+        return -1;
+    }
+    close(inputFd);
+    return savedStdin;
+}
+// Runs a builtin inside the shell process. For a redirection the stdout of the shell is saved,
+// replaced with the file while the builtin runs, and restored afterwards. Output for >>> is
+// collected in a temp file first, then reversed into the file. Returns the status of the builtin
+int runBuiltinWithOutput(struct builtin *builtin, char **arguments, int numOfArguments, int redirectionType, char *fileName) {
+    if (redirectionType == REDIRECT_NONE) {
+        return builtin->function(arguments, numOfArguments);
+    }
+
+    int fileFd;
+    if (redirectionType == REDIRECT_REVERSE) {
+        fileFd = openSpillFile();
+    } else {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (redirectionType == REDIRECT_WRITE ? O_TRUNC : O_APPEND);
+        fileFd = open(fileName, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    }
+    if (fileFd == -1) {
+        perror("Error opening the file");
+        error = 1;
+        return 1;
+    }
+
+    // Swapping the stdout, pending output of the shell must still go to the old one
+    fflush(stdout);
+    int savedStdout = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+    if ((savedStdout == -1) || (dup2(fileFd, STDOUT_FILENO) == -1)) {
+        perror("Error redirecting standard output");
+        if (savedStdout != -1) {close(savedStdout);}
+        close(fileFd);
+        error = 1;
+        return 1;
+    }
+    int result = builtin->function(arguments, numOfArguments);
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+
+    // >>> case, reading the collected output back from the start
+    if (redirectionType == REDIRECT_REVERSE) {
+        lseek(fileFd, 0, SEEK_SET);
+        if (reverseAppend(fileFd, fileName) != 0) {
+            error = 1;
+            result = 1;
+        }
+    }
+    close(fileFd);
+    return result;
+}
+// The time prefix. Runs the command after it and prints (to stderr) the real time it took, the
+// user and sys time and max RSS of its processes, and their context switches. time -p prints only
+// the real, user and sys times, in seconds, in the POSIX format. A command which
+// has no job of its own (a builtin) is measured with the usage of the shell itself and of the
+// children it has waited for
+int timeCommand(char **tokens, char *isOperator, int index, char *input, struct arena *arena) {
+    struct rusage shellBefore, shellAfter, childrenBefore, childrenAfter;
+    getrusage(RUSAGE_SELF, &shellBefore);
+    getrusage(RUSAGE_CHILDREN, &childrenBefore);
+    hasLastJobUsage = 0;
+    double start = nowMicroseconds();
+
+    int used = 1; // Tokens taken by the prefix and its option
+    int isPortable = (index > 1) && !isOperator[1] && (strcmp(tokens[1], "-p") == 0);
+    if (isPortable) {
+        used = 2;
+    }
+    isBeingTimed++;
+    int result = executeCommand(tokens + used, isOperator + used, index - used, input, arena);
+    isBeingTimed--;
+
+    double real = nowMicroseconds() - start;
+    getrusage(RUSAGE_SELF, &shellAfter);
+    getrusage(RUSAGE_CHILDREN, &childrenAfter);
+    struct rusage usage;
+    if (hasLastJobUsage) {
+        usage = lastJobUsage;
+    } else {
+        // The shell itself, plus the children the builtin has waited for (parallel workers)
+        struct timeval childrenTime;
+        memset(&usage, 0, sizeof(usage));
+        timersub(&shellAfter.ru_utime, &shellBefore.ru_utime, &usage.ru_utime);
+        timersub(&childrenAfter.ru_utime, &childrenBefore.ru_utime, &childrenTime);
+        timeradd(&usage.ru_utime, &childrenTime, &usage.ru_utime);
+        timersub(&shellAfter.ru_stime, &shellBefore.ru_stime, &usage.ru_stime);
+        timersub(&childrenAfter.ru_stime, &childrenBefore.ru_stime, &childrenTime);
+        timeradd(&usage.ru_stime, &childrenTime, &usage.ru_stime);
+        usage.ru_maxrss = shellAfter.ru_maxrss > childrenAfter.ru_maxrss ? shellAfter.ru_maxrss : childrenAfter.ru_maxrss;
+        usage.ru_nvcsw = shellAfter.ru_nvcsw - shellBefore.ru_nvcsw + childrenAfter.ru_nvcsw - childrenBefore.ru_nvcsw;
+        usage.ru_nivcsw = shellAfter.ru_nivcsw - shellBefore.ru_nivcsw + childrenAfter.ru_nivcsw - childrenBefore.ru_nivcsw;
+    }
+
+    // Printed like bash does, followed by the memory and the context switches
+    double user = usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec;
+    double sys = usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+    fflush(stdout);
+    if (isPortable) {
+        fprintf(stderr, "real %.2f\nuser %.2f\nsys %.2f\n", real / 1e6, user / 1e6, sys / 1e6);
+        return result;
+    }
+    fprintf(stderr, "\nreal\t%ldm%.3fs\n", (long) (real / 60e6), real / 1e6 - 60 * (long) (real / 60e6));
+    fprintf(stderr, "user\t%ldm%.3fs\n", (long) (user / 60e6), user / 1e6 - 60 * (long) (user / 60e6));
+    fprintf(stderr, "sys\t%ldm%.3fs\n", (long) (sys / 60e6), sys / 1e6 - 60 * (long) (sys / 60e6));
+    fprintf(stderr, "maxrss\t%ld KB\n", usage.ru_maxrss);
+    fprintf(stderr, "ctxsw\t%ld voluntary, %ld involuntary\n", usage.ru_nvcsw, usage.ru_nivcsw);
+    return result;
+}
+// The pin, nice and ionice prefixes. Each one adds to the placement of the job of the rest of the
+// line, which is then executed (so they can be combined, like nice -n 5 pin 2 command):
+//   pin <cpu list> command                 : runs it on the given CPUs only (like 0-3,8)
+//   nice [-n N | -N] command               : adds N (10 by default) to its nice value
+//   ionice [-c <class>] [-n <level>] command: its I/O class (1 realtime, 2 best-effort by
+//                                            default, 3 idle) and level (0-7, 4 by default)
+// A nice or ionice line in any other form (no command, other options, a value out of range) is
+// not handled here and -1 is returned: it is then run as a normal command, by the nice or ionice
+// program
+int placementCommand(char **tokens, char *isOperator, int index, char *input, struct arena *arena) {
+    struct placement savedPlacement = linePlacement;
+    int used = 1; // Tokens taken by the prefix and its options
+    int isValid = 1;
+    if (strcmp(tokens[0], "pin") == 0) {
+        isValid = (index > 1) && !isOperator[1] && (parseCpuList(tokens[1], &linePlacement.cpus) == 0);
+        linePlacement.hasCpus = 1;
+        used = 2;
+    } else if (strcmp(tokens[0], "nice") == 0) {
+        long adjustment = 10;
+        if ((index > 1) && (strcmp(tokens[1], "-n") == 0)) {
+            isValid = (index > 2) && (parseNumber(tokens[2], &adjustment) == 0);
+            used = 3;
+        } else if ((index > 1) && (tokens[1][0] == '-')) {
+            isValid = parseNumber(tokens[1] + 1, &adjustment) == 0; // -5 adds 5, --5 subtracts it
+            used = 2;
+        }
+        // Niceness goes from -20 to 19, nice(1) clamps a larger adjustment
+        if ((adjustment < -40) || (adjustment > 40)) {isValid = 0;}
+        linePlacement.niceness += (int) adjustment;
+    } else {
+        long ioClass = 0, level = 4;
+        while ((used + 1 < index) && !isOperator[used] &&
+               ((strcmp(tokens[used], "-c") == 0) || (strcmp(tokens[used], "-n") == 0))) {
+            if (parseNumber(tokens[used + 1], tokens[used][1] == 'c' ? &ioClass : &level) != 0) {
+                isValid = 0;
+            }
+            used += 2;
+        }
+        // A level alone is a best-effort one, like ionice(1) does
+        if ((ioClass == 0) && (used > 1)) {ioClass = 2;}
+        isValid = isValid && (ioClass >= 1) && (ioClass <= 3) && (level >= 0) && (level <= 7) &&
+                  ((used >= index) || (tokens[used][0] != '-'));
+        linePlacement.ioPriority = (int) ((ioClass << IOPRIO_CLASS_SHIFT) | (ioClass == 3 ? 0 : level));
+    }
+    for (int a = 1; a < used; a++) {
+        if (isOperator[a]) {isValid = 0;}
+    }
+    if (!isValid || (used >= index) || isOperator[used]) {
+        linePlacement = savedPlacement;
+        if (strcmp(tokens[0], "pin") != 0) {
+            return -1;
+        }
+        fprintf(stderr, "Usage: pin <cpu list> command (like pin 0-3,8 command)\n");
+        error = 1;
+        return 1;
+    }
+
+    int result = executeCommand(tokens + used, isOperator + used, index - used, input, arena);
+    linePlacement = savedPlacement;
+    return result;
+}
+// Parses a whole decimal number (an optional sign, then digits only) into value. Returns 0 on
+// success, -1 if it is not a number or does not fit into a long
+int parseNumber(const char *text, long *value) {
+    char *end;
+    errno = 0;
+    long number = strtol(text, &end, 10);
+    if ((end == text) || (*end != '\0') || (errno != 0)) {
+        return -1;
+    }
+    *value = number;
+    return 0;
+}
+// Parses a CPU list like 0-3,8 into cpus. Returns 0 on success, -1 if it is malformed
+int parseCpuList(const char *list, cpu_set_t *cpus) {
+    CPU_ZERO(cpus);
+    const char *c = list;
+    while (1) {
+        char *end;
+        long first = strtol(c, &end, 10);
+        if ((end == c) || (first < 0)) {
+            return -1;
+        }
+        long last = first;
+        if (*end == '-') {
+            c = end + 1;
+            last = strtol(c, &end, 10);
+            if ((end == c) || (last < first)) {
+                return -1;
+            }
+        }
+        if (last >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+        if (*end == '\0') {
+            return 0;
+        }
+        if (*end != ',') {
+            return -1;
+        }
+        c = end + 1;
+    }
+}
+// Returns 1 if a placement changes anything
+int isPlaced(struct placement *placement) {
+    return placement->hasCpus || (placement->niceness != 0) || (placement->ioPriority != 0);
+}
+// Applies a placement to the calling process (a child, before exec). A nice value which cannot be
+// set is only a warning (like nice(1), the command still runs). Returns 0 on success, -1 on error
+int applyPlacement(struct placement *placement) {
+    if (placement->hasCpus && (sched_setaffinity(0, sizeof(cpu_set_t), &placement->cpus) == -1)) {
+        perror("pin: sched_setaffinity failed");
+        return -1;
+    }
+    if (placement->niceness != 0) {
+        errno = 0;
+        int niceness = getpriority(PRIO_PROCESS, 0);
+        if (((niceness == -1) && (errno != 0)) || (setpriority(PRIO_PROCESS, 0, niceness + placement->niceness) == -1)) {
+            perror("nice: setpriority failed");
+        }
+    }
+    if ((placement->ioPriority != 0) && (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, placement->ioPriority) == -1)) {
+        perror("ionice: ioprio_set failed");
+        return -1;
+    }
+    return 0;
+}
+// Current time in microseconds (monotonic)
+double nowMicroseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+// Adds a latency sample of a phase (one of the PHASE_ values) to its histogram
+void recordLatency(int phase, double microseconds) {
+    struct latencyHistogram *histogram = &latencyHistograms[phase];
+    int bucket = 0;
+    while ((bucket < NUM_OF_LATENCY_BUCKETS - 1) && (microseconds >= (double) (2UL << bucket))) {
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+    histogram->numOfSamples++;
+    histogram->totalMicroseconds += microseconds;
+    if (microseconds > histogram->maxMicroseconds) {
+        histogram->maxMicroseconds = microseconds;
+    }
+}
+// The stats builtin. Prints the latency histograms of the phases of the commands run in this
+// session and the launch counters, "stats -r" resets them. Percentiles are the upper bounds of
+// the buckets they fall into
+int statsBuiltin(char **tokens, int numOfTokens) {
+    if ((numOfTokens > 1) && (strcmp(tokens[1], "-r") == 0)) {
+        memset(latencyHistograms, 0, sizeof(latencyHistograms));
+        numOfForks = numOfPosixSpawns = numOfZygoteLaunches = numOfFilterStages = numOfExecs = numOfLaunchFailures = numOfFailedJobs = 0;
+        return 0;
+    }
+
+    // The summary, one line per phase
+    printf("%-8s %10s %10s %10s %10s %10s  (microseconds)\n", "phase", "count", "mean", "p50", "p99", "max");
+    for (int phase = 0; phase < NUM_OF_PHASES; phase++) {
+        struct latencyHistogram *histogram = &latencyHistograms[phase];
+        unsigned long percentiles[2] = {0, 0}; // Upper bounds of the buckets of p50 and p99
+        unsigned long seen = 0;
+        for (int bucket = 0; (bucket < NUM_OF_LATENCY_BUCKETS) && (histogram->numOfSamples > 0); bucket++) {
+            seen += histogram->buckets[bucket];
+            if ((percentiles[0] == 0) && (seen * 100 >= histogram->numOfSamples * 50)) {percentiles[0] = 2UL << bucket;}
+            if ((percentiles[1] == 0) && (seen * 100 >= histogram->numOfSamples * 99)) {percentiles[1] = 2UL << bucket;}
+        }
+        double mean = histogram->numOfSamples > 0 ? histogram->totalMicroseconds / histogram->numOfSamples : 0;
+        char p50[24] = "-", p99[24] = "-"; // A phase without samples has no percentiles
+        if (histogram->numOfSamples > 0) {
+            snprintf(p50, sizeof(p50), "<%lu", percentiles[0]);
+            snprintf(p99, sizeof(p99), "<%lu", percentiles[1]);
+        }
+        printf("%-8s %10lu %10.1f %10s %10s %10.1f\n", phaseNames[phase], histogram->numOfSamples, mean,
+               p50, p99, histogram->maxMicroseconds);
+    }
+
+    // The histograms, only the buckets which have samples
+    for (int phase = 0; phase < NUM_OF_PHASES; phase++) {
+        struct latencyHistogram *histogram = &latencyHistograms[phase];
+        if (histogram->numOfSamples == 0) {
+            continue;
+        }
+        unsigned long largest = 0;
+        for (int bucket = 0; bucket < NUM_OF_LATENCY_BUCKETS; bucket++) {
+            if (histogram->buckets[bucket] > largest) {largest = histogram->buckets[bucket];}
+        }
+        printf("\n%s:\n", phaseNames[phase]);
+        for (int bucket = 0; bucket < NUM_OF_LATENCY_BUCKETS; bucket++) {
+            if (histogram->buckets[bucket] == 0) {
+                continue;
+            }
+            int barLength = (int) (histogram->buckets[bucket] * 40 / largest);
+            printf("%10lu - %-10lu us |%-40.*s| %lu\n", bucket == 0 ? 0 : 1UL << bucket, 2UL << bucket,
+                   barLength > 0 ? barLength : 1, "########################################", histogram->buckets[bucket]);
+        }
+    }
+
+    // The counters
+    printf("\nforks %lu, posix_spawns %lu, zygote launches %lu, filter threads %lu, execs %lu, launch failures %lu, failed jobs %lu\n",
+           numOfForks, numOfPosixSpawns, numOfZygoteLaunches, numOfFilterStages, numOfExecs, numOfLaunchFailures, numOfFailedJobs);
+    return 0;
+}
+// Turns tracing on, allocating the ring the first time. Returns 0 on success, 1 on error
+int startTracing() {
+    if (traceBuffer == NULL) {
+        // Only the pages of the slots which get written are ever touched
+        traceBuffer = calloc(TRACE_BUFFER_SIZE, sizeof(struct traceRecord));
+        if (traceBuffer == NULL) {
+            perror("trace: cannot allocate the trace buffer");
+            return 1;
+        }
+    }
+    isTracing = 1;
+    return 0;
+}
+// Returns the current time (microseconds) if we are tracing, 0 otherwise (a span starting at 0 is
+// not recorded). This is how a span is started without reading the clock when tracing is off
+double traceClock() {
+    return isTracing ? nowMicroseconds() : 0;
+}
+// Records a span of the calling thread, which has run from start until end (microseconds).
+// Does nothing if we are not tracing, or if the span has started before tracing was turned on
+void recordSpan(const char *name, const char *detail, double start, double end) {
+    if (!isTracing || (start == 0)) {
+        return;
+    }
+    writeTraceRecord(name, detail, start, end - start, getpid(), (pid_t) syscall(SYS_gettid), -1);
+}
+// Puts a span into the next slot of the ring. Safe to call from any thread of the shell
+void writeTraceRecord(const char *name, const char *detail, double start, double duration, pid_t pid, pid_t tid, int status) {
+    uint64_t index = __atomic_fetch_add(&traceHead, 1, __ATOMIC_RELAXED);
+    struct traceRecord *record = &traceBuffer[index & (TRACE_BUFFER_SIZE - 1)];
+    // Unpublishing the slot while it is being filled
+    __atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    record->name = name;
+    size_t length = 0;
+    if (detail != NULL) {
+        length = strnlen(detail, TRACE_DETAIL_SIZE);
+        if (length == TRACE_DETAIL_SIZE) {
+            // Cut, but not inside a UTF-8 character, so the dump stays valid JSON
+            length = TRACE_DETAIL_SIZE - 1;
+            while ((length > 0) && (((unsigned char) detail[length] & 0xC0) == 0x80)) {
+                length--;
+            }
+        }
+        memcpy(record->detail, detail, length);
+    }
+    record->detail[length] = '\0';
+    record->start = start;
+    record->duration = duration;
+    record->pid = pid;
+    record->tid = tid;
+    record->status = status;
+
+    __atomic_store_n(&record->sequence, index + 1, __ATOMIC_RELEASE);
+}
+// Writes a string as a JSON string (quoted and escaped)
+void writeJsonString(FILE *file, const char *text) {
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *) text; *c != '\0'; c++) {
+        if ((*c == '"') || (*c == '\\')) {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+// Writes the spans inside the ring into a file in the Chrome trace format: one complete ("X")
+// event per span, with the command of a span inside its args. Every child is a process of its
+// own in the trace, named after its command line. Returns 0 on success, 1 on error
+int dumpTrace(const char *fileName) {
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        fprintf(stderr, "trace: %s: %s\n", fileName, strerror(errno));
+        error = 1;
+        return 1;
+    }
+    pid_t shellPid = getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"myshell\"}}", shellPid, shellPid);
+
+    // The slots from the oldest span still inside the ring to the newest one
+    uint64_t head = __atomic_load_n(&traceHead, __ATOMIC_ACQUIRE);
+    uint64_t first = head > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : 0;
+    unsigned long numOfSpans = 0;
+    for (uint64_t index = first; (index < head) && (traceBuffer != NULL); index++) {
+        struct traceRecord *slot = &traceBuffer[index & (TRACE_BUFFER_SIZE - 1)];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != index + 1) {
+            continue; // Still being written, or already overwritten by a newer span
+        }
+        struct traceRecord record = *slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != index + 1) {
+            continue; // Overwritten while we were copying it
+        }
+
+        if (record.status != -1) {
+            fprintf(file, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", record.pid, record.tid);
+            writeJsonString(file, record.detail);
+            fprintf(file, "}}");
+        }
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"detail\":",
+                record.name, record.start, record.duration, record.pid, record.tid);
+        writeJsonString(file, record.detail);
+        if ((record.status != -1) && WIFSIGNALED(record.status)) {
+            fprintf(file, ",\"signal\":%d", WTERMSIG(record.status));
+        } else if (record.status != -1) {
+            fprintf(file, ",\"exit\":%d", WEXITSTATUS(record.status));
+        }
+        fprintf(file, "}}");
+        numOfSpans++;
+    }
+    fprintf(file, "\n]}\n");
+    if (fclose(file) != 0) {
+        fprintf(stderr, "trace: %s: %s\n", fileName, strerror(errno));
+        error = 1;
+        return 1;
+    }
+    printf("%lu spans written to %s\n", numOfSpans, fileName);
+    return 0;
+}
+// The trace builtin. "trace on" and "trace off" start and stop recording spans, "trace clear"
+// forgets the recorded ones, "trace dump file.json" writes them in the Chrome trace format.
+// Without arguments it tells whether we are tracing and how many spans have been recorded
+int traceBuiltin(char **tokens, int numOfTokens) {
+    if (numOfTokens == 1) {
+        uint64_t head = __atomic_load_n(&traceHead, __ATOMIC_RELAXED);
+        printf("tracing %s, %lu spans recorded (the ring keeps the last %d)\n", isTracing ? "on" : "off",
+               (unsigned long) head, TRACE_BUFFER_SIZE);
+        return 0;
+    }
+    if ((numOfTokens == 2) && (strcmp(tokens[1], "on") == 0)) {
+        return startTracing();
+    }
+    if ((numOfTokens == 2) && (strcmp(tokens[1], "off") == 0)) {
+        isTracing = 0;
+        return 0;
+    }
+    if ((numOfTokens == 2) && (strcmp(tokens[1], "clear") == 0)) {
+        // No other thread is recording meanwhile, the filter threads only run during spawn
+        __atomic_store_n(&traceHead, 0, __ATOMIC_RELAXED);
+        return 0;
+    }
+    if ((numOfTokens == 3) && (strcmp(tokens[1], "dump") == 0)) {
+        return dumpTrace(tokens[2]);
+    }
+    fprintf(stderr, "trace: usage: trace [on | off | clear | dump file.json]\n");
+    error = 1;
+    return 1;
+}
+// Launches one worker of parallel, with its stdin, stdout and stderr connected to the given
+// descriptors. It stays inside our process group (so it gets Ctrl-C like us) and gets the default
+// signal dispositions and childMask as its signal mask. Returns the pid, -1 on error
+pid_t launchWorker(char **arg_list, char *fullPath, int inputFd, int outputFd, int errorFd, sigset_t *childMask) {
+    if (useForkBackend) {
+        pid_t child_pid = fork();
+        if (child_pid < 0) {
+            perror("fork Failed");
+            return -1;
+        }
+        if (child_pid == 0) {
+            resetChildSignals(childMask);
+            if ((dup2(inputFd, STDIN_FILENO) == -1) || (dup2(outputFd, STDOUT_FILENO) == -1) || (dup2(errorFd, STDERR_FILENO) == -1)) {
+                perror("Error redirecting the worker");
+                exit(EXIT_FAILURE);
+            }
+            execve(fullPath, arg_list, environ);
+            fprintf(stderr, "An error occurred in execve\n");
+            exit(EXIT_FAILURE);
+        }
+        numOfForks++;
+        numOfExecs++;
+        return child_pid;
+    }
+
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGINT);
+    sigaddset(&defaultSignals, SIGQUIT);
+    sigaddset(&defaultSignals, SIGTSTP);
+    sigaddset(&defaultSignals, SIGTTIN);
+    sigaddset(&defaultSignals, SIGTTOU);
+    sigaddset(&defaultSignals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    posix_spawnattr_setsigmask(&attributes, childMask);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+    posix_spawn_file_actions_adddup2(&fileActions, inputFd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&fileActions, outputFd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&fileActions, errorFd, STDERR_FILENO);
+
+    pid_t child_pid;
+    int result = posix_spawn(&child_pid, fullPath, &fileActions, &attributes, arg_list, environ);
+    posix_spawn_file_actions_destroy(&fileActions);
+    posix_spawnattr_destroy(&attributes);
+    if (result != 0) {
+        fprintf(stderr, "An error occurred in posix_spawn (%s): %s\n", arg_list[0], strerror(result));
+        return -1;
+    }
+    numOfPosixSpawns++;
+    numOfExecs++;
+    return child_pid;
+}
+// Copies everything inside the file sourceFd (from its start) to destinationFd, with sendfile
+// so the data does not pass through user space. sendfile refuses some destinations (O_APPEND
+// files for example), pread/write is used for them. Returns 0 on success, -1 on error
+int copyToFd(int sourceFd, int destinationFd) {
+    struct stat fileInfo;
+    if (fstat(sourceFd, &fileInfo) == -1) {
+        return -1;
+    }
+    off_t offset = 0;
+    int canSendfile = 1;
+    char buffer[65536];
+    while (offset < fileInfo.st_size) {
+        ssize_t bytesSent;
+        if (canSendfile) {
+            bytesSent = sendfile(destinationFd, sourceFd, &offset, fileInfo.st_size - offset);
+            if ((bytesSent == -1) && (errno == EINVAL)) {
+                canSendfile = 0;
+                continue;
+            }
+        } else {
+            bytesSent = pread(sourceFd, buffer, sizeof(buffer), offset);
+            if (bytesSent > 0) {
+                bytesSent = write(destinationFd, buffer, bytesSent);
+            }
+            if (bytesSent > 0) {
+                offset += bytesSent;
+            }
+        }
+        if ((bytesSent == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (bytesSent <= 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+// The parallel builtin: "parallel [-j N] [-n M] command [arguments] ::: item..." runs the command
+// once per batch of items, keeping at most N (the number of CPUs by default) of them running at
+// a time. Without ::: the items are the lines of stdin, like xargs. A batch has at most M items
+// (by default the items are spread evenly over the N workers) and never more than what fits
+// into ARG_MAX. The stdout and stderr of every worker are collected into temp files and printed
+// as a whole once it has finished, so the outputs of the workers are not interleaved. Returns
+// the number of failed workers (at most 101, like GNU parallel), 0 if all of them succeeded
+int parallelBuiltin(char **tokens, int numOfTokens) {
+    // Options
+    long numOfWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    long maxBatchSize = 0; // 0 means spreading the items evenly
+    int first = 1; // Index of the command
+    int hasBadOption = 0; // 1 if the value of an option is not a positive number
+    while ((first < numOfTokens) && ((strncmp(tokens[first], "-j", 2) == 0) || (strncmp(tokens[first], "-n", 2) == 0))) {
+        // The value is either attached (-j4) or the next argument (-j 4)
+        char option = tokens[first][1];
+        char *text = tokens[first] + 2;
+        if (*text == '\0') {
+            if (first + 1 >= numOfTokens) {
+                hasBadOption = 1;
+                break;
+            }
+            text = tokens[++first];
+        }
+        char *end;
+        errno = 0;
+        long value = strtol(text, &end, 10);
+        if ((end == text) || (*end != '\0') || (errno != 0) || (value <= 0)) {
+            hasBadOption = 1;
+            break;
+        }
+        if (option == 'j') {numOfWorkers = value;}
+        else {maxBatchSize = value;}
+        first++;
+    }
+    if (numOfWorkers <= 0) {numOfWorkers = sysconf(_SC_NPROCESSORS_ONLN);}
+    int separator = first; // Index of :::, numOfTokens if it is not given
+    while ((separator < numOfTokens) && (strcmp(tokens[separator], ":::") != 0)) {separator++;}
+    if (hasBadOption || (first >= numOfTokens) || (separator == first)) {
+        fprintf(stderr, "Usage: parallel [-j jobs] [-n items per job] command [arguments] [::: items...]\n");
+        error = 1;
+        return 1;
+    }
+    char *fullPath = lookupCommand(tokens[first]);
+    if (fullPath == NULL) {
+        fprintf(stderr, "Error: '%s' not found in the PATH\n", tokens[first]);
+        error = 1;
+        return 127;
+    }
+
+    // The items, from the command line or from the lines of stdin
+    char **items;
+    long numOfItems = 0;
+    char *input = NULL;
+    if (separator < numOfTokens) {
+        items = tokens + separator + 1;
+        numOfItems = numOfTokens - separator - 1;
+    } else {
+        size_t length;
+        input = readWholeFile(STDIN_FILENO, &length);
+        if (input == NULL) {
+            perror("Error reading the items");
+            error = 1;
+            return 1;
+        }
+        input[length] = '\0';
+        items = malloc((length / 2 + 2) * sizeof(char *));
+        for (char *line = strtok(input, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+            items[numOfItems++] = line;
+        }
+    }
+    if (numOfItems == 0) {
+        free(input);
+        if (input != NULL) {free(items);}
+        return 0;
+    }
+    if (numOfWorkers > numOfItems) {numOfWorkers = numOfItems;}
+    if (maxBatchSize <= 0) {maxBatchSize = (numOfItems + numOfWorkers - 1) / numOfWorkers;}
+
+    // The room a batch has: ARG_MAX minus the environment, the fixed arguments and a safety margin
+    long roomForItems = sysconf(_SC_ARG_MAX) - 4096;
+    for (char **variable = environ; *variable != NULL; variable++) {
+        roomForItems -= strlen(*variable) + 1 + sizeof(char *);
+    }
+    int numOfFixed = separator - first; // The command and its own arguments
+    for (int i = first; i < separator; i++) {
+        roomForItems -= strlen(tokens[i]) + 1 + sizeof(char *);
+    }
+    char **arguments = malloc((numOfFixed + maxBatchSize + 1) * sizeof(char *));
+    memcpy(arguments, tokens + first, numOfFixed * sizeof(char *));
+
+    // The workers are reaped here, not by the event loop (they are not inside the job table)
+    fflush(stdout);
+    fflush(stderr);
+
+    struct parallelWorker {
+        pid_t pid; // Its pid, 0 if the slot is free
+        int outputFd; // Temp file collecting its stdout
+        int errorFd; // Temp file collecting its stderr
+    } *workers = calloc(numOfWorkers, sizeof(struct parallelWorker));
+    int nullFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    long nextItem = 0; // The first item which has not been given to a worker
+    long numOfRunning = 0;
+    int numOfFailed = 0;
+    int isInterrupted = 0; // Becomes 1 once a worker is killed by Ctrl-C, no new workers are started then
+
+    while (((nextItem < numOfItems) && !isInterrupted) || (numOfRunning > 0)) {
+        // Filling the free slots with the next batches
+        for (long slot = 0; (slot < numOfWorkers) && (nextItem < numOfItems) && !isInterrupted; slot++) {
+            if (workers[slot].pid != 0) {
+                continue;
+            }
+            int numOfArguments = numOfFixed;
+            long room = roomForItems;
+            while ((nextItem < numOfItems) && (numOfArguments - numOfFixed < maxBatchSize)) {
+                long size = strlen(items[nextItem]) + 1 + sizeof(char *);
+                if ((size > room) && (numOfArguments > numOfFixed)) {
+                    break; // The batch is full, an item which is too large alone is still tried
+                }
+                room -= size;
+                arguments[numOfArguments++] = items[nextItem++];
+            }
+            arguments[numOfArguments] = NULL;
+
+            workers[slot].outputFd = openSpillFile();
+            workers[slot].errorFd = openSpillFile();
+            pid_t pid = -1;
+            if ((workers[slot].outputFd != -1) && (workers[slot].errorFd != -1)) {
+                pid = launchWorker(arguments, fullPath, nullFd, workers[slot].outputFd, workers[slot].errorFd, &childSignalMask);
+            } else {
+                perror("Error creating a temp file");
+            }
+            if (pid < 0) {
+                numOfLaunchFailures++;
+                numOfFailed++;
+                if (workers[slot].outputFd != -1) {close(workers[slot].outputFd);}
+                if (workers[slot].errorFd != -1) {close(workers[slot].errorFd);}
+                continue;
+            }
+            workers[slot].pid = pid;
+            numOfRunning++;
+        }
+        if (numOfRunning == 0) {
+            continue;
+        }
+
+        // Waiting for any worker, they are the only children inside our process group
+        int status;
+        pid_t pid = waitpid(0, &status, 0);
+        if (pid == -1) {
+            if (errno == EINTR) {continue;}
+            perror("waitpid Failed");
+            break;
+        }
+        for (long slot = 0; slot < numOfWorkers; slot++) {
+            if (workers[slot].pid != pid) {
+                continue;
+            }
+            // Printing its output as a whole
+            copyToFd(workers[slot].outputFd, STDOUT_FILENO);
+            copyToFd(workers[slot].errorFd, STDERR_FILENO);
+            close(workers[slot].outputFd);
+            close(workers[slot].errorFd);
+            workers[slot].pid = 0;
+            numOfRunning--;
+            if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+                numOfFailed++;
+            }
+            if (WIFSIGNALED(status) && (WTERMSIG(status) == SIGINT)) {
+                isInterrupted = 1;
+            }
+        }
+    }
+
+    if (nullFd != -1) {close(nullFd);}
+    free(workers);
+    free(arguments);
+    if (input != NULL) {
+        free(input);
+        free(items);
+    }
+    if (numOfFailed > 0) {
+        error = 1;
+    }
+    return numOfFailed > 101 ? 101 : numOfFailed;
+}
+// The exit builtin. exit n exits with n, exit alone with the status of the last command
+int exitBuiltin(char **tokens, int numOfTokens) {
+    fflush(stdout);
+    lastStatus = numOfTokens > 1 ? atoi(tokens[1]) : lastStatus; // A server worker reports it to its client
+    exit(lastStatus);
+}
+// The bello builtin, which prints information about the user and the shell. The lines are
+// assembled in memory and written with a single writev, nothing is written if any of them fails
+int belloBuiltin(char **tokens, int numOfTokens) {
+    /** The required information inside bello are below **/
+    char *lines[8];
+
+    /** Username **/
+    lines[0] = getenv("USER");
+
+    /** Hostname **/
+    char hostName[255];
+    if (gethostname(hostName, sizeof(hostName)) != 0) {
+        perror("Error getting hostname");
+        error = 1;
+        return 1;
+    }
+    lines[1] = hostName;
+
+    /** Last executed command (from the history) **/
+    char *command = lastCommand();
+    lines[2] = command;
+
+    /** TTY **/
+    lines[3] = ttyname(0);
+    if (lines[3] == NULL) {
+        perror("Error getting terminal name");
+        free(command);
+        error = 1;
+        return EXIT_FAILURE;
+    }
+
+    /** Current shell name **/
+    lines[4] = getenv("SHELL");
+
+    /** Home location **/
+    lines[5] = getenv("HOME");
+
+    /** Current time and date (ctime ends it with a newline itself) **/
+    time_t current_time = time(NULL);
+    char time_string[64];
+    ctime_r(&current_time, time_string);
+    time_string[strcspn(time_string, "\n")] = '\0';
+    lines[6] = time_string;
+
+    /** Current number of processes being executed (our live jobs plus the shell itself) **/
+    char processCount[16];
+    snprintf(processCount, sizeof(processCount), "%d", countLiveProcesses()+1);
+    lines[7] = processCount;
+
+    /** The required information inside bello are above **/
+
+    // Every line followed by a newline, written to stdout at once
+    struct iovec vectors[16];
+    for (int i = 0; i < 8; i++) {
+        if (lines[i] == NULL) {lines[i] = "(null)";} // What printf used to print for a missing variable
+        vectors[2 * i].iov_base = lines[i];
+        vectors[2 * i].iov_len = strlen(lines[i]);
+        vectors[2 * i + 1].iov_base = "\n";
+        vectors[2 * i + 1].iov_len = 1;
+    }
+    fflush(stdout);
+    int result = 0;
+    if (writev(STDOUT_FILENO, vectors, 16) == -1) {
+        perror("Error writing bello");
+        error = 1;
+        result = 1;
+    }
+    free(command);
+    return result;
+}
+// Writes all of data into fd, retrying short writes. Returns 0 on success, -1 on error
+int writeAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t bytesWritten = write(fd, data, length);
+        if ((bytesWritten == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (bytesWritten <= 0) {
+            return -1;
+        }
+        data += bytesWritten;
+        length -= bytesWritten;
+    }
+    return 0;
+}
+// Moves exactly length bytes out of a pipe into destinationFd, with splice while it is accepted
+// (canSplice is cleared when it is not) and with read and write afterwards. Returns 0 on success,
+// -1 on error
+int drainPipe(int pipeFd, int destinationFd, size_t length, int *canSplice) {
+    char buffer[65536];
+    while (length > 0) {
+        ssize_t bytesMoved;
+        if (*canSplice) {
+            bytesMoved = splice(pipeFd, NULL, destinationFd, NULL, length, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if ((bytesMoved == -1) && (errno == EINVAL)) {
+                *canSplice = 0;
+                continue;
+            }
+        } else {
+            bytesMoved = read(pipeFd, buffer, length < sizeof(buffer) ? length : sizeof(buffer));
+            if ((bytesMoved > 0) && (writeAll(destinationFd, buffer, bytesMoved) == -1)) {
+                bytesMoved = -1;
+            }
+        }
+        if ((bytesMoved == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (bytesMoved <= 0) {
+            return -1;
+        }
+        length -= bytesMoved;
+    }
+    return 0;
+}
+// The tee builtin: "tee [-aip] [--] file..." copies its stdin to its stdout and to every file.
+// -a (--append) appends to the files, -i (--ignore-interrupts) ignores SIGINT and -p
+// (--output-error) ignores SIGPIPE, so an output pipe which is closed is dropped quietly and the
+// copying goes on to the rest. A file which cannot be opened is reported and skipped. Returns 0
+// on success, 1 if an option is unknown (no file is opened then) or a file could not be opened or
+// written
+int teeBuiltin(char **tokens, int numOfTokens) {
+    int isAppend = 0;
+    int isIgnoringInterrupts = 0;
+    int isIgnoringPipes = 0;
+    int firstFile = 1;
+    for (; (firstFile < numOfTokens) && (tokens[firstFile][0] == '-') && (tokens[firstFile][1] != '\0'); firstFile++) {
+        char *option = tokens[firstFile];
+        if (strcmp(option, "--") == 0) {
+            firstFile++;
+            break;
+        }
+        if (option[1] == '-') {
+            if (strcmp(option, "--append") == 0) {
+                isAppend = 1;
+            } else if (strcmp(option, "--ignore-interrupts") == 0) {
+                isIgnoringInterrupts = 1;
+            } else if (strcmp(option, "--output-error") == 0) {
+                isIgnoringPipes = 1;
+            } else {
+                fprintf(stderr, "tee: unrecognized option '%s'\n", option);
+                return 1;
+            }
+            continue;
+        }
+        // Short options may be combined, as in -ai
+        for (int i = 1; option[i] != '\0'; i++) {
+            if (option[i] == 'a') {
+                isAppend = 1;
+            } else if (option[i] == 'i') {
+                isIgnoringInterrupts = 1;
+            } else if (option[i] == 'p') {
+                isIgnoringPipes = 1;
+            } else {
+                fprintf(stderr, "tee: invalid option -- '%c'\n", option[i]);
+                return 1;
+            }
+        }
+    }
+    // The previous handlers are put back at the end, tee may run inside the shell itself
+    struct sigaction ignore = {0};
+    struct sigaction previousInterrupt;
+    struct sigaction previousPipe;
+    ignore.sa_handler = SIG_IGN;
+    if (isIgnoringInterrupts) {
+        sigaction(SIGINT, &ignore, &previousInterrupt);
+    }
+    if (isIgnoringPipes) {
+        sigaction(SIGPIPE, &ignore, &previousPipe);
+    }
+    int result = 0;
+    struct teeOutput outputs[numOfTokens + 1];
+    int numOfOutputs = 0;
+    for (int i = firstFile; i < numOfTokens; i++) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (isAppend ? O_APPEND : O_TRUNC);
+        int fd = open(tokens[i], flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (fd == -1) {
+            fprintf(stderr, "tee: %s: %s\n", tokens[i], strerror(errno));
+            result = 1;
+            continue;
+        }
+        outputs[numOfOutputs++] = (struct teeOutput) {fd, 1, tokens[i]};
+    }
+    fflush(stdout);
+    outputs[numOfOutputs++] = (struct teeOutput) {STDOUT_FILENO, 1, "standard output"};
+
+    // The output which gets the input itself must accept splice: a file, or a pipe
+    int last = -1;
+    struct stat fileInfo;
+    for (int i = 0; (i < numOfOutputs) && (last == -1); i++) {
+        if ((fstat(outputs[i].fd, &fileInfo) == 0) && (S_ISREG(fileInfo.st_mode) || S_ISFIFO(fileInfo.st_mode))) {
+            last = i;
+        }
+    }
+    int scratchFd[2] = {-1, -1};
+    int isInKernel = (fstat(STDIN_FILENO, &fileInfo) == 0) && S_ISFIFO(fileInfo.st_mode) && (last != -1) &&
+                     (pipe2(scratchFd, O_CLOEXEC) == 0);
+    if (isInKernel) {
+        fcntl(scratchFd[0], F_SETPIPE_SZ, TEE_CHUNK); // Ignored if refused, the chunks are only smaller then
+        struct teeOutput lastOutput = outputs[last];
+        outputs[last] = outputs[numOfOutputs - 1];
+        outputs[numOfOutputs - 1] = lastOutput;
+    }
+
+    while (isInKernel) {
+        // Duplicating whatever the input holds into the scratch pipe, 0 means the end of the input
+        ssize_t chunk = tee(STDIN_FILENO, scratchFd[1], TEE_CHUNK, 0);
+        if ((chunk == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (chunk == -1) {
+            perror("tee: tee");
+            result = 1;
+            break;
+        }
+        if (chunk == 0) {
+            break;
+        }
+        // Every output but the last gets a copy through the scratch pipe, the same bytes are
+        // duplicated again for each of them (the input has not been consumed yet)
+        int hasFailed = 0; // 1 if the input could not be duplicated again, the copying stops then
+        for (int i = 0; (i < numOfOutputs - 1) && !hasFailed; i++) {
+            if (i > 0) {
+                ssize_t duplicated;
+                do {
+                    duplicated = tee(STDIN_FILENO, scratchFd[1], chunk, 0);
+                } while ((duplicated == -1) && (errno == EINTR));
+                if (duplicated != chunk) {
+                    fprintf(stderr, "tee: could not duplicate the input\n");
+                    result = 1;
+                    hasFailed = 1;
+                    break;
+                }
+            }
+            if ((outputs[i].fd != -1) && (drainPipe(scratchFd[0], outputs[i].fd, chunk, &outputs[i].canSplice) == -1)) {
+                // A failed output is dropped, but the scratch pipe must still be emptied
+                if (!isIgnoringPipes || (errno != EPIPE)) {
+                    fprintf(stderr, "tee: %s: %s\n", outputs[i].name, strerror(errno));
+                }
+                if (outputs[i].fd != STDOUT_FILENO) {close(outputs[i].fd);}
+                outputs[i].fd = -1;
+                result = 1;
+            }
+            if (outputs[i].fd == -1) {
+                int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+                int canSplice = 1;
+                drainPipe(scratchFd[0], devNull, chunk, &canSplice);
+                close(devNull);
+            }
+        }
+        if (hasFailed) {
+            break;
+        }
+        // The last output consumes the input
+        struct teeOutput *lastOutput = &outputs[numOfOutputs - 1];
+        if (drainPipe(STDIN_FILENO, lastOutput->fd, chunk, &lastOutput->canSplice) == -1) {
+            if (!isIgnoringPipes || (errno != EPIPE)) {
+                fprintf(stderr, "tee: %s: %s\n", lastOutput->name, strerror(errno));
+            }
+            result = 1;
+            break;
+        }
+    }
+
+    // Without a pipe on either side, copying through user space
+    if (!isInKernel) {
+        char *buffer = malloc(TEE_CHUNK);
+        ssize_t bytesRead;
+        while ((bytesRead = read(STDIN_FILENO, buffer, TEE_CHUNK)) != 0) {
+            if (bytesRead == -1) {
+                if (errno == EINTR) {continue;}
+                perror("tee: read");
+                result = 1;
+                break;
+            }
+            for (int i = 0; i < numOfOutputs; i++) {
+                if ((outputs[i].fd != -1) && (writeAll(outputs[i].fd, buffer, bytesRead) == -1)) {
+                    if (!isIgnoringPipes || (errno != EPIPE)) {
+                        fprintf(stderr, "tee: %s: %s\n", outputs[i].name, strerror(errno));
+                    }
+                    if (outputs[i].fd != STDOUT_FILENO) {close(outputs[i].fd);}
+                    outputs[i].fd = -1;
+                    result = 1;
+                }
+            }
+        }
+        free(buffer);
+    }
+
+    if (scratchFd[0] != -1) {
+        close(scratchFd[0]);
+        close(scratchFd[1]);
+    }
+    for (int i = 0; i < numOfOutputs; i++) {
+        if ((outputs[i].fd != -1) && (outputs[i].fd != STDOUT_FILENO)) {
+            close(outputs[i].fd);
+        }
+    }
+    if (isIgnoringInterrupts) {
+        sigaction(SIGINT, &previousInterrupt, NULL);
+    }
+    if (isIgnoringPipes) {
+        sigaction(SIGPIPE, &previousPipe, NULL);
+    }
+    return result;
+}
+// Counts the newlines inside data
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static size_t countNewlinesAVX2(const char *data, size_t length) {
+    // Every block of 32 bytes subtracts its comparison (-1 where a newline is) from byte counters,
+    // which are summed up with psadbw before they can overflow, after 255 blocks
+    const __m256i newline = _mm256_set1_epi8('\n');
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+    while (i + 32 <= length) {
+        __m256i counters = _mm256_setzero_si256();
+        for (int n = 0; (n < 255) && (i + 32 <= length); n++, i += 32) {
+            __m256i block = _mm256_loadu_si256((const __m256i *) (data + i));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(block, newline));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(counters, _mm256_setzero_si256()));
+    }
+    size_t count = _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+                   _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+    for (; i < length; i++) {
+        count += (data[i] == '\n');
+    }
+    return count;
+}
+static size_t countNewlinesSSE2(const char *data, size_t length) {
+    // The same with 16 bytes at a time, SSE2 is part of every x86-64 CPU
+    const __m128i newline = _mm_set1_epi8('\n');
+    __m128i total = _mm_setzero_si128();
+    size_t i = 0;
+    while (i + 16 <= length) {
+        __m128i counters = _mm_setzero_si128();
+        for (int n = 0; (n < 255) && (i + 16 <= length); n++, i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(block, newline));
+        }
+        total = _mm_add_epi64(total, _mm_sad_epu8(counters, _mm_setzero_si128()));
+    }
+    size_t count = _mm_cvtsi128_si64(total) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+    for (; i < length; i++) {
+        count += (data[i] == '\n');
+    }
+    return count;
+}
+#endif
+size_t countNewlines(const char *data, size_t length) {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) {
+        return countNewlinesAVX2(data, length);
+    }
+    return countNewlinesSSE2(data, length);
+#else
+    // Portable version, memchr from one newline to the next
+    size_t count = 0;
+    const char *end = data + length;
+    for (const char *newline = data; (newline = memchr(newline, '\n', end - newline)) != NULL; newline++) {
+        count++;
+    }
+    return count;
+#endif
+}
+// Returns how many bytes of data make up its first *numOfLines lines (all of data if it has fewer
+// of them), and decreases *numOfLines by the lines found. Whole pieces of 4 KB are counted with
+// countNewlines, only the piece holding the last newline we need is walked with memchr
+size_t skipLines(const char *data, size_t length, long *numOfLines) {
+    size_t offset = 0;
+    while ((*numOfLines > 0) && (offset < length)) {
+        size_t pieceLength = (length - offset < 4096) ? length - offset : 4096;
+        size_t count = countNewlines(data + offset, pieceLength);
+        if (count < (size_t) *numOfLines) {
+            *numOfLines -= count;
+            offset += pieceLength;
+            continue;
+        }
+        while (*numOfLines > 0) {
+            offset = (const char *) memchr(data + offset, '\n', length - offset) - data + 1;
+            (*numOfLines)--;
+        }
+    }
+    return offset;
+}
+// Finds the first occurrence of pattern inside data, NULL if there is none
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static const char *findStringAVX2(const char *data, size_t length, const char *pattern, size_t patternLength) {
+    // The candidates are the positions where both the first and the last byte of the pattern
+    // match, 32 positions are tested at a time and only the candidates are compared in full
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[patternLength - 1]);
+    size_t i = 0;
+    for (; i + patternLength + 31 <= length; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i *) (data + i + patternLength - 1));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first),
+                                                                                 _mm256_cmpeq_epi8(blockLast, last)));
+        while (mask != 0) {
+            size_t candidate = i + __builtin_ctz(mask);
+            if (memcmp(data + candidate + 1, pattern + 1, patternLength - 2) == 0) {
+                return data + candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return (i < length) ? memmem(data + i, length - i, pattern, patternLength) : NULL;
+}
+#endif
+const char *findString(const char *data, size_t length, const char *pattern, size_t patternLength) {
+    if (patternLength == 0) {
+        return data;
+    }
+    if (patternLength == 1) {
+        return memchr(data, pattern[0], length);
+    }
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) {
+        return findStringAVX2(data, length, pattern, patternLength);
+    }
+#endif
+    return memmem(data, length, pattern, patternLength);
+}
+// Reads the arguments of a stage named head, tail, wc, grep, cut or rev and returns the filter
+// doing the same, with its file operand (if any) already open. Returns NULL if the stage is none
+// of them, uses an option we do not implement or has a file we cannot open, so that it is
+// launched as a program (which also reports the error)
+struct filter *prepareFilter(char **arguments) {
+    int type = 0;
+    while ((filterNames[type] != NULL) && (strcmp(arguments[0], filterNames[type]) != 0)) {type++;}
+    if (filterNames[type] == NULL) {
+        return NULL;
+    }
+    struct filter *filter = calloc(1, sizeof(struct filter));
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->type = type;
+    filter->count = 10;
+    filter->delimiter = '\t';
+    filter->inputFd = -1;
+    filter->outputFd = -1;
+    filter->references = 1;
+
+    char *operands[2]; // grep's pattern and one file at most
+    int numOfOperands = 0;
+    int numOfCounts = 0; // wc counts only one thing
+    int hasList = 0; // cut needs a list
+    int isFixedString = 0; // grep -F
+    int isValid = 1;
+    for (int a = 1; (arguments[a] != NULL) && isValid; a++) {
+        char *argument = arguments[a];
+        if ((argument[0] != '-') || (argument[1] == '\0')) {
+            if ((numOfOperands == 2) || (strcmp(argument, "-") == 0)) {
+                isValid = 0;
+            } else {
+                operands[numOfOperands++] = argument;
+            }
+            continue;
+        }
+        // The value of an option is either attached to it (-n5) or the next argument (-n 5)
+        char option = argument[1];
+        char *value = (argument[2] != '\0') ? argument + 2 : arguments[a + 1];
+        int takesValue = ((type == FILTER_HEAD) && ((option == 'n') || (option == 'c'))) ||
+                         ((type == FILTER_TAIL) && (option == 'n')) ||
+                         ((type == FILTER_CUT) && (strchr("fbcd", option) != NULL));
+        if (takesValue && (argument[2] == '\0')) {
+            if (value == NULL) {
+                isValid = 0;
+                break;
+            }
+            a++;
+        }
+        if ((type == FILTER_HEAD) && (option >= '0') && (option <= '9')) {
+            value = argument + 1; // head -5
+            option = 'n';
+        }
+        switch (type) {
+            case FILTER_HEAD:
+            case FILTER_TAIL:
+                if ((option != 'n') && !((type == FILTER_HEAD) && (option == 'c'))) {
+                    isValid = 0;
+                    break;
+                }
+                filter->countsBytes = (option == 'c');
+                if ((type == FILTER_TAIL) && (value[0] == '+')) {
+                    filter->isFromStart = 1;
+                    value++;
+                }
+                if ((value[0] == '\0') || (strspn(value, "0123456789") != strlen(value)) || (strlen(value) > 18)) {
+                    isValid = 0;
+                    break;
+                }
+                filter->count = atol(value);
+                break;
+            case FILTER_WC:
+            case FILTER_GREP:
+                // Flags, which may be combined (-vc)
+                for (char *flag = argument + 1; (*flag != '\0') && isValid; flag++) {
+                    if ((type == FILTER_WC) && ((*flag == 'l') || (*flag == 'c'))) {
+                        filter->countsBytes = (*flag == 'c');
+                        numOfCounts++;
+                    } else if ((type == FILTER_GREP) && (*flag == 'v')) {
+                        filter->isInverted = 1;
+                    } else if ((type == FILTER_GREP) && (*flag == 'c')) {
+                        filter->isCounting = 1;
+                    } else if ((type == FILTER_GREP) && (*flag == 'F')) {
+                        isFixedString = 1;
+                    } else {
+                        isValid = 0;
+                    }
+                }
+                break;
+            case FILTER_CUT:
+                if (option == 'd') {
+                    if (strlen(value) != 1) {
+                        isValid = 0;
+                    }
+                    filter->delimiter = value[0];
+                } else if (hasList || (parseCutList(filter, value) != 0)) {
+                    isValid = 0;
+                } else {
+                    hasList = 1;
+                    filter->countsBytes = (option != 'f');
+                }
+                break;
+            default:
+                isValid = 0;
+        }
+    }
+
+    char *file = NULL;
+    if (type == FILTER_GREP) {
+        // A single fixed string without newlines. Without -F it must not use any character
+        // which is special inside a basic regular expression
+        if ((numOfOperands == 0) || (strchr(operands[0], '\n') != NULL) ||
+            (!isFixedString && (strpbrk(operands[0], ".[]*^$\\") != NULL))) {
+            isValid = 0;
+        } else {
+            filter->pattern = strdup(operands[0]);
+            filter->patternLength = strlen(operands[0]);
+            file = (numOfOperands == 2) ? operands[1] : NULL;
+        }
+    } else {
+        isValid = isValid && (numOfOperands < 2);
+        file = (numOfOperands == 1) ? operands[0] : NULL;
+    }
+    if ((type == FILTER_WC) && (numOfCounts != 1)) {isValid = 0;}
+    if ((type == FILTER_CUT) && !hasList) {isValid = 0;}
+    if ((type == FILTER_CUT) && filter->countsBytes && (filter->delimiter != '\t')) {isValid = 0;} // -d is only for -f
+
+    // rev keeps the bytes of a UTF-8 character in order when the locale uses UTF-8, like rev does
+    if (type == FILTER_REV) {
+        const char *locale = getenv("LC_ALL");
+        if ((locale == NULL) || (locale[0] == '\0')) {locale = getenv("LC_CTYPE");}
+        if ((locale == NULL) || (locale[0] == '\0')) {locale = getenv("LANG");}
+        filter->isUtf8 = (locale != NULL) && ((strcasestr(locale, "utf-8") != NULL) || (strcasestr(locale, "utf8") != NULL));
+    }
+
+    if (isValid && (file != NULL)) {
+        struct stat info;
+        filter->inputFd = open(file, O_RDONLY | O_CLOEXEC);
+        filter->fileName = strdup(file);
+        if ((filter->inputFd == -1) || (fstat(filter->inputFd, &info) == -1) || S_ISDIR(info.st_mode)) {
+            isValid = 0;
+        }
+    }
+    if (!isValid) {
+        releaseFilter(filter);
+        return NULL;
+    }
+    return filter;
+}
+// Reads the LIST of cut -f/-b/-c (N, N-M, N- or -M, separated by commas) into the filter. Returns
+// 0 on success, -1 if it is invalid or closes a range after CUT_MAX_FIELD
+int parseCutList(struct filter *filter, const char *list) {
+    const char *position = list;
+    while (1) {
+        long from = 1, to;
+        char *end;
+        if (*position != '-') {
+            if ((*position < '0') || (*position > '9')) {return -1;}
+            from = strtol(position, &end, 10);
+            position = end;
+        }
+        if (*position == '-') {
+            position++;
+            if ((*position == ',') || (*position == '\0')) {
+                to = -1; // Open range
+            } else {
+                if ((*position < '0') || (*position > '9')) {return -1;}
+                to = strtol(position, &end, 10);
+                position = end;
+            }
+        } else {
+            to = from;
+        }
+        if ((from < 1) || ((to != -1) && ((to < from) || (to > CUT_MAX_FIELD)))) {
+            return -1;
+        }
+        if (to == -1) {
+            if ((filter->openFrom == 0) || (from < filter->openFrom)) {filter->openFrom = from;}
+        } else {
+            for (long n = from; n <= to; n++) {filter->selected[n] = 1;}
+            if (to > filter->lastSelected) {filter->lastSelected = to;}
+        }
+        if (*position == '\0') {
+            return 0;
+        }
+        if (*position != ',') {
+            return -1;
+        }
+        position++;
+    }
+}
+// Starts the thread of a prepared filter. Its stdin is inputFd, unless it reads its file operand,
+// and its stdout is the file of > or >> (redirectionType and fileName), otherwise outputFd, or
+// the shell's stdout if outputFd is -1. The thread gets its own copies of the descriptors.
+// Returns 0 on success, -1 on error (the stage is then launched as a program instead)
+int startFilter(struct filter *filter, int inputFd, int outputFd, int redirectionType, char *fileName) {
+    if (filter->fileName == NULL) {
+        filter->inputFd = fcntl(inputFd, F_DUPFD_CLOEXEC, 0);
+        if (filter->inputFd == -1) {
+            return -1;
+        }
+    }
+    if ((redirectionType == REDIRECT_WRITE) || (redirectionType == REDIRECT_APPEND)) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (redirectionType == REDIRECT_WRITE ? O_TRUNC : O_APPEND);
+        filter->outputFd = open(fileName, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    } else {
+        filter->outputFd = fcntl(outputFd != -1 ? outputFd : STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    }
+    if (filter->outputFd == -1) {
+        return -1;
+    }
+    // The eventfd the threads wake the event loop with
+    if (filterEventFd == -1) {
+        filterEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        struct epoll_event event = {EPOLLIN, {.fd = filterEventFd}};
+        if ((filterEventFd == -1) || (epoll_ctl(childEpollFd, EPOLL_CTL_ADD, filterEventFd, &event) == -1)) {
+            perror("Error creating the eventfd of the filters");
+            if (filterEventFd != -1) {close(filterEventFd);}
+            filterEventFd = -1;
+            return -1;
+        }
+    }
+    filter->references = 2;
+    int result = pthread_create(&filter->thread, NULL, runFilter, filter);
+    if (result != 0) {
+        fprintf(stderr, "Error creating a filter thread: %s\n", strerror(result));
+        filter->references = 1;
+        return -1;
+    }
+    numOfFilterStages++;
+    return 0;
+}
+// Waits until the filter threads of a foreground job have finished, inside the event loop.
+// Ctrl-C cancels them. If the job has been stopped they are left running on their own instead.
+// Returns the status of the last one (130 if they were cancelled), and lets go of them
+int finishFilters(struct filter **filters, int numOfFilters, int isStopped) {
+    int isCancelled = 0;
+    for (int i = 0; (i < numOfFilters) && !isStopped; i++) {
+        while (!__atomic_load_n(&filters[i]->isDone, __ATOMIC_ACQUIRE)) {
+            waitForChildEvents();
+            if (isInterruptPending) {
+                isInterruptPending = 0;
+                isCancelled = 1;
+                for (int j = 0; j < numOfFilters; j++) {
+                    __atomic_store_n(&filters[j]->isCancelled, 1, __ATOMIC_RELAXED);
+                }
+            }
+        }
+    }
+    int status = 0;
+    for (int i = 0; i < numOfFilters; i++) {
+        if (isStopped) {
+            pthread_detach(filters[i]->thread);
+        } else {
+            pthread_join(filters[i]->thread, NULL);
+            status = filters[i]->status;
+        }
+        releaseFilter(filters[i]);
+    }
+    if (isCancelled) {
+        printf("\n");
+        status = 128 + SIGINT;
+    }
+    return status;
+}
+// Drops one reference to a filter, the last one frees it (with the descriptors it still has)
+void releaseFilter(struct filter *filter) {
+    if (__atomic_sub_fetch(&filter->references, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    if (filter->inputFd != -1) {close(filter->inputFd);}
+    if (filter->outputFd != -1) {close(filter->outputFd);}
+    free(filter->pattern);
+    free(filter->fileName);
+    free(filter->output);
+    free(filter);
+}
+// The thread of a filter: runs it, writes out what is left of its output, closes its descriptors
+// (so its reader sees the end of its input) and reports its end through filterEventFd. A reader
+// which has gone gives the status 141, like a process killed by SIGPIPE
+void *runFilter(void *argument) {
+    struct filter *filter = argument;
+    double filterStart = traceClock();
+    sigset_t pipeMask;
+    sigemptyset(&pipeMask);
+    sigaddset(&pipeMask, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeMask, NULL); // A write into a closed pipe fails with EPIPE instead
+
+    int result = -1;
+    filter->outputCapacity = FILTER_OUTPUT_SIZE;
+    filter->output = malloc(filter->outputCapacity);
+    if (filter->output != NULL) {
+        switch (filter->type) {
+            case FILTER_HEAD: result = runHead(filter); break;
+            case FILTER_TAIL: result = runTail(filter); break;
+            case FILTER_WC: result = runWc(filter); break;
+            default: result = runLineFilter(filter);
+        }
+        if (result == 0) {
+            result = flushFilterOutput(filter);
+        }
+    }
+    if (__atomic_load_n(&filter->isCancelled, __ATOMIC_RELAXED)) {
+        filter->status = 128 + SIGINT;
+    } else if ((result == -1) && (errno == EPIPE)) {
+        filter->status = 128 + SIGPIPE;
+    } else if (result == -1) {
+        fprintf(stderr, "%s: %s\n", filterNames[filter->type], strerror(errno));
+        filter->status = 1;
+    }
+    close(filter->inputFd);
+    close(filter->outputFd);
+    filter->inputFd = filter->outputFd = -1;
+
+    __atomic_store_n(&filter->isDone, 1, __ATOMIC_RELEASE);
+    uint64_t one = 1;
+    if (write(filterEventFd, &one, sizeof(one)) == -1) {
+        perror("Error writing the eventfd of the filters");
+    }
+    recordSpan("filter", filterNames[filter->type], filterStart, traceClock());
+    releaseFilter(filter);
+    return NULL;
+}
+// Reads the next piece of a filter's input, like read. A cancelled filter gets -1 (ECANCELED)
+ssize_t readFilterInput(struct filter *filter, char *buffer, size_t length) {
+    while (1) {
+        if (__atomic_load_n(&filter->isCancelled, __ATOMIC_RELAXED)) {
+            errno = ECANCELED;
+            return -1;
+        }
+        ssize_t bytesRead = read(filter->inputFd, buffer, length);
+        if ((bytesRead == -1) && (errno == EINTR)) {
+            continue;
+        }
+        return bytesRead;
+    }
+}
+// Returns where length more bytes of output can be put (the caller adds them to outputLength),
+// writing out the collected output first if they do not fit. NULL on error
+char *reserveFilterOutput(struct filter *filter, size_t length) {
+    if (filter->outputCapacity - filter->outputLength < length) {
+        if (flushFilterOutput(filter) == -1) {
+            return NULL;
+        }
+        if (length > filter->outputCapacity) {
+            char *output = realloc(filter->output, length);
+            if (output == NULL) {
+                errno = ENOMEM;
+                return NULL;
+            }
+            filter->output = output;
+            filter->outputCapacity = length;
+        }
+    }
+    return filter->output + filter->outputLength;
+}
+// Adds data to a filter's output. Large pieces are written out directly instead of being copied.
+// Returns 0 on success, -1 on error
+int emitFilterOutput(struct filter *filter, const char *data, size_t length) {
+    if (length >= FILTER_OUTPUT_SIZE) {
+        if (flushFilterOutput(filter) == -1) {
+            return -1;
+        }
+        return writeAll(filter->outputFd, data, length);
+    }
+    char *space = reserveFilterOutput(filter, length);
+    if (space == NULL) {
+        return -1;
+    }
+    memcpy(space, data, length);
+    filter->outputLength += length;
+    return 0;
+}
+// Writes out the collected output of a filter. Returns 0 on success, -1 on error
+int flushFilterOutput(struct filter *filter) {
+    if (writeAll(filter->outputFd, filter->output, filter->outputLength) == -1) {
+        return -1;
+    }
+    filter->outputLength = 0;
+    return 0;
+}
+// head -n N (or -c N): copies the first N lines (or bytes) and stops reading
+int runHead(struct filter *filter) {
+    char *buffer = malloc(FILTER_BLOCK_SIZE);
+    if (buffer == NULL) {
+        return -1;
+    }
+    long remaining = filter->count;
+    int result = 0;
+    while (remaining > 0) {
+        ssize_t bytesRead = readFilterInput(filter, buffer, FILTER_BLOCK_SIZE);
+        if (bytesRead <= 0) {
+            result = (int) bytesRead;
+            break;
+        }
+        size_t length;
+        if (filter->countsBytes) {
+            length = (bytesRead < remaining) ? (size_t) bytesRead : (size_t) remaining;
+            remaining -= length;
+        } else {
+            length = skipLines(buffer, bytesRead, &remaining);
+        }
+        if (emitFilterOutput(filter, buffer, length) == -1) {
+            result = -1;
+            break;
+        }
+    }
+    free(buffer);
+    return result;
+}
+// tail -n N (or -n +N). The last lines of a regular file are found by reading it backwards, any
+// other input is kept in blocks, dropping the oldest one while the newer ones still hold more than
+// N newlines. tail -n +N skips N - 1 lines and copies the rest
+int runTail(struct filter *filter) {
+    struct stat info;
+    if (!filter->isFromStart && (fstat(filter->inputFd, &info) == 0) && S_ISREG(info.st_mode) &&
+        (lseek(filter->inputFd, 0, SEEK_CUR) != -1)) {
+        return runTailOfFile(filter, info.st_size);
+    }
+    char *buffer = malloc(FILTER_BLOCK_SIZE);
+    if (buffer == NULL) {
+        return -1;
+    }
+    ssize_t bytesRead;
+    if (filter->isFromStart) {
+        long toSkip = (filter->count > 0) ? filter->count - 1 : 0;
+        while ((bytesRead = readFilterInput(filter, buffer, FILTER_BLOCK_SIZE)) > 0) {
+            size_t skipped = (toSkip > 0) ? skipLines(buffer, bytesRead, &toSkip) : 0;
+            if (emitFilterOutput(filter, buffer + skipped, bytesRead - skipped) == -1) {
+                bytesRead = -1;
+                break;
+            }
+        }
+        free(buffer);
+        return (int) bytesRead;
+    }
+    free(buffer);
+
+    struct tailBlock *blocks = NULL;
+    int numOfBlocks = 0, firstBlock = 0, capacity = 0;
+    size_t newlinesAfterFirst = 0; // Newlines inside the blocks after the first one
+    int result = 0;
+    while (1) {
+        // Filling a whole block, a pipe may give us less at a time
+        char *data = malloc(FILTER_BLOCK_SIZE);
+        size_t length = 0;
+        bytesRead = 1;
+        while ((data != NULL) && (length < FILTER_BLOCK_SIZE) &&
+               ((bytesRead = readFilterInput(filter, data + length, FILTER_BLOCK_SIZE - length)) > 0)) {
+            length += bytesRead;
+        }
+        if ((data == NULL) || (bytesRead == -1)) {
+            free(data);
+            result = -1;
+            break;
+        }
+        if (length == 0) {
+            free(data);
+            break;
+        }
+        if (numOfBlocks == capacity) {
+            if (firstBlock > 0) {
+                memmove(blocks, blocks + firstBlock, (numOfBlocks - firstBlock) * sizeof(struct tailBlock));
+                numOfBlocks -= firstBlock;
+                firstBlock = 0;
+            } else {
+                capacity = capacity * 2 + 8;
+                blocks = realloc(blocks, capacity * sizeof(struct tailBlock));
+            }
+        }
+        struct tailBlock *block = &blocks[numOfBlocks++];
+        block->data = data;
+        block->length = length;
+        block->numOfNewlines = countNewlines(data, length);
+        if (numOfBlocks - firstBlock > 1) {
+            newlinesAfterFirst += block->numOfNewlines;
+        }
+        while ((numOfBlocks - firstBlock > 1) && (newlinesAfterFirst > (size_t) filter->count)) {
+            free(blocks[firstBlock].data);
+            firstBlock++;
+            newlinesAfterFirst -= blocks[firstBlock].numOfNewlines;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+    }
+
+    // Looking for the start of the last N lines from the end (a last line without a newline counts)
+    int startBlock = firstBlock;
+    size_t startOffset = 0;
+    long needed = filter->count;
+    if ((result == 0) && (needed == 0)) {
+        startBlock = numOfBlocks;
+    }
+    for (int b = numOfBlocks - 1; (result == 0) && (needed > 0) && (b >= firstBlock); b--) {
+        const char *data = blocks[b].data;
+        size_t end = blocks[b].length;
+        if ((b == numOfBlocks - 1) && (data[end - 1] == '\n')) {
+            end--;
+        }
+        size_t count = countNewlines(data, end);
+        if (count < (size_t) needed) {
+            needed -= count;
+            continue;
+        }
+        while (needed > 0) {
+            end = (const char *) memrchr(data, '\n', end) - data;
+            needed--;
+        }
+        startBlock = b;
+        startOffset = end + 1;
+    }
+    for (int b = startBlock; (result == 0) && (b < numOfBlocks); b++) {
+        result = emitFilterOutput(filter, blocks[b].data + startOffset, blocks[b].length - startOffset);
+        startOffset = 0;
+    }
+    for (int b = firstBlock; b < numOfBlocks; b++) {
+        free(blocks[b].data);
+    }
+    free(blocks);
+    return result;
+}
+// tail -n N of a regular file of size bytes, reading blocks backwards from its end with pread
+// until N newlines are found, then copying from there
+int runTailOfFile(struct filter *filter, off_t size) {
+    off_t begin = lseek(filter->inputFd, 0, SEEK_CUR); // The file may have been read before (<)
+    if ((filter->count == 0) || (size <= begin)) {
+        return 0;
+    }
+    char *buffer = malloc(FILTER_BLOCK_SIZE);
+    if (buffer == NULL) {
+        return -1;
+    }
+    long needed = filter->count;
+    off_t start = begin;
+    off_t position = size;
+    char last;
+    if ((pread(filter->inputFd, &last, 1, size - 1) == 1) && (last == '\n')) {
+        position--;
+    }
+    while (position > begin) {
+        if (__atomic_load_n(&filter->isCancelled, __ATOMIC_RELAXED)) {
+            free(buffer);
+            errno = ECANCELED;
+            return -1;
+        }
+        size_t length = (position - begin < FILTER_BLOCK_SIZE) ? (size_t) (position - begin) : FILTER_BLOCK_SIZE;
+        if (pread(filter->inputFd, buffer, length, position - length) != (ssize_t) length) {
+            free(buffer);
+            return -1;
+        }
+        position -= length;
+        size_t count = countNewlines(buffer, length);
+        if (count < (size_t) needed) {
+            needed -= count;
+            continue;
+        }
+        size_t end = length;
+        while (needed > 0) {
+            end = (const char *) memrchr(buffer, '\n', end) - buffer;
+            needed--;
+        }
+        start = position + end + 1;
+        break;
+    }
+    // Copying from start to the end of the file
+    int result = 0;
+    while ((result == 0) && (start < size)) {
+        ssize_t bytesRead = pread(filter->inputFd, buffer, FILTER_BLOCK_SIZE, start);
+        if (bytesRead <= 0) {
+            result = (int) bytesRead;
+            break;
+        }
+        result = emitFilterOutput(filter, buffer, bytesRead);
+        start += bytesRead;
+    }
+    free(buffer);
+    return result;
+}
+// wc -l (or -c): counts the newlines (or bytes) of the input, the size of a regular file is
+// taken from fstat. Prints the count, followed by the file name for a file operand
+int runWc(struct filter *filter) {
+    long long total = 0;
+    struct stat info;
+    off_t offset;
+    if (filter->countsBytes && (fstat(filter->inputFd, &info) == 0) && S_ISREG(info.st_mode) &&
+        ((offset = lseek(filter->inputFd, 0, SEEK_CUR)) != -1)) {
+        total = (info.st_size > offset) ? info.st_size - offset : 0;
+    } else {
+        char *buffer = malloc(FILTER_BLOCK_SIZE);
+        if (buffer == NULL) {
+            return -1;
+        }
+        ssize_t bytesRead;
+        while ((bytesRead = readFilterInput(filter, buffer, FILTER_BLOCK_SIZE)) > 0) {
+            total += filter->countsBytes ? (size_t) bytesRead : countNewlines(buffer, bytesRead);
+        }
+        free(buffer);
+        if (bytesRead == -1) {
+            return -1;
+        }
+    }
+    size_t lineLength = 32 + (filter->fileName != NULL ? strlen(filter->fileName) : 0);
+    char *line = reserveFilterOutput(filter, lineLength);
+    if (line == NULL) {
+        return -1;
+    }
+    if (filter->fileName != NULL) {
+        filter->outputLength += snprintf(line, lineLength, "%lld %s\n", total, filter->fileName);
+    } else {
+        filter->outputLength += snprintf(line, lineLength, "%lld\n", total);
+    }
+    return 0;
+}
+// grep, cut and rev work on whole lines: the input is read in blocks, each block is handed over
+// up to its last newline and the incomplete line is kept for the next one (the buffer grows for
+// a line longer than it). grep and cut add a newline to a last line which has none, like the
+// programs. grep's status is 1 if it has selected no line
+int runLineFilter(struct filter *filter) {
+    size_t capacity = FILTER_BLOCK_SIZE;
+    char *buffer = malloc(capacity + 1); // Room for the added newline
+    if (buffer == NULL) {
+        return -1;
+    }
+    size_t length = 0; // Bytes inside buffer
+    long numOfSelected = 0;
+    int result = 0;
+    while (result == 0) {
+        if (length == capacity) {
+            char *larger = realloc(buffer, capacity * 2 + 1);
+            if (larger == NULL) {
+                errno = ENOMEM;
+                result = -1;
+                break;
+            }
+            buffer = larger;
+            capacity *= 2;
+        }
+        ssize_t bytesRead = readFilterInput(filter, buffer + length, capacity - length);
+        if (bytesRead == -1) {
+            result = -1;
+            break;
+        }
+        size_t complete; // Bytes up to the last newline
+        if (bytesRead == 0) {
+            if (length == 0) {
+                break;
+            }
+            if ((buffer[length - 1] != '\n') && (filter->type != FILTER_REV)) {
+                buffer[length++] = '\n';
+            }
+            complete = length;
+        } else {
+            // The kept part has no newline, only the new bytes need to be searched
+            const char *lastNewline = memrchr(buffer + length, '\n', bytesRead);
+            length += bytesRead;
+            if (lastNewline == NULL) {
+                continue;
+            }
+            complete = lastNewline - buffer + 1;
+        }
+        switch (filter->type) {
+            case FILTER_GREP: result = grepBlock(filter, buffer, complete, &numOfSelected); break;
+            case FILTER_CUT: result = cutBlock(filter, buffer, complete); break;
+            default: result = revBlock(filter, buffer, complete);
+        }
+        memmove(buffer, buffer + complete, length - complete);
+        length -= complete;
+        if (bytesRead == 0) {
+            break;
+        }
+    }
+    free(buffer);
+    if ((result == 0) && (filter->type == FILTER_GREP)) {
+        if (filter->isCounting) {
+            char *line = reserveFilterOutput(filter, 32);
+            if (line == NULL) {
+                return -1;
+            }
+            filter->outputLength += snprintf(line, 32, "%ld\n", numOfSelected);
+        }
+        filter->status = (numOfSelected > 0) ? 0 : 1;
+    }
+    return result;
+}
+// grep over whole lines: the pattern is searched through the block at once (instead of line by
+// line) and only the lines around the matches are looked at. Adds the selected lines to
+// *numOfSelected. Returns 0 on success, -1 on error
+int grepBlock(struct filter *filter, const char *data, size_t length, long *numOfSelected) {
+    const char *position = data;
+    const char *end = data + length;
+    while (position < end) {
+        const char *match = findString(position, end - position, filter->pattern, filter->patternLength);
+        const char *lineStart = end; // The line of the match, the pattern has no newline so it is inside one line
+        const char *lineEnd = end;
+        if (match != NULL) {
+            const char *newline = memrchr(position, '\n', match - position);
+            lineStart = (newline != NULL) ? newline + 1 : position;
+            lineEnd = (const char *) memchr(match, '\n', end - match) + 1;
+        }
+        if (filter->isInverted) {
+            // The lines before the matching one are selected
+            if (lineStart > position) {
+                *numOfSelected += countNewlines(position, lineStart - position);
+                if (!filter->isCounting && (emitFilterOutput(filter, position, lineStart - position) == -1)) {
+                    return -1;
+                }
+            }
+        } else if (match != NULL) {
+            (*numOfSelected)++;
+            if (!filter->isCounting && (emitFilterOutput(filter, lineStart, lineEnd - lineStart) == -1)) {
+                return -1;
+            }
+        }
+        position = lineEnd;
+    }
+    return 0;
+}
+// cut over whole lines: prints the selected fields (joined by the delimiter, a line without it is
+// printed whole) or the selected bytes of every line. Returns 0 on success, -1 on error
+int cutBlock(struct filter *filter, const char *data, size_t length) {
+    const char *end = data + length;
+    const char *line = data;
+    while (line < end) {
+        const char *lineEnd = memchr(line, '\n', end - line);
+        size_t lineLength = lineEnd - line;
+        if (filter->countsBytes) {
+            // The bytes up to CUT_MAX_FIELD one at a time, the open range at once
+            char *space = reserveFilterOutput(filter, lineLength + 1);
+            if (space == NULL) {
+                return -1;
+            }
+            size_t numOfBytes = 0;
+            size_t limit = (lineLength < CUT_MAX_FIELD) ? lineLength : CUT_MAX_FIELD;
+            size_t openFrom = filter->openFrom ? (size_t) filter->openFrom : lineLength + 1;
+            for (size_t n = 1; (n <= limit) && (n < openFrom); n++) {
+                if (filter->selected[n]) {space[numOfBytes++] = line[n - 1];}
+            }
+            if (openFrom <= lineLength) {
+                memcpy(space + numOfBytes, line + openFrom - 1, lineLength - openFrom + 1);
+                numOfBytes += lineLength - openFrom + 1;
+            }
+            space[numOfBytes++] = '\n';
+            filter->outputLength += numOfBytes;
+        } else if (memchr(line, filter->delimiter, lineLength) == NULL) {
+            if (emitFilterOutput(filter, line, lineLength + 1) == -1) {
+                return -1;
+            }
+        } else {
+            long field = 1;
+            int isFirst = 1;
+            const char *fieldStart = line;
+            while (1) {
+                const char *fieldEnd = memchr(fieldStart, filter->delimiter, lineEnd - fieldStart);
+                if (fieldEnd == NULL) {fieldEnd = lineEnd;}
+                int isSelected = (filter->openFrom && (field >= filter->openFrom)) ||
+                                 ((field <= CUT_MAX_FIELD) && filter->selected[field]);
+                if (isSelected) {
+                    if ((!isFirst && (emitFilterOutput(filter, &filter->delimiter, 1) == -1)) ||
+                        (emitFilterOutput(filter, fieldStart, fieldEnd - fieldStart) == -1)) {
+                        return -1;
+                    }
+                    isFirst = 0;
+                }
+                // The rest of the line can be skipped once no later field is selected
+                if ((fieldEnd == lineEnd) || (!filter->openFrom && (field >= filter->lastSelected))) {
+                    break;
+                }
+                fieldStart = fieldEnd + 1;
+                field++;
+            }
+            if (emitFilterOutput(filter, "\n", 1) == -1) {
+                return -1;
+            }
+        }
+        line = lineEnd + 1;
+    }
+    return 0;
+}
+// rev over whole lines: reverses the bytes of every line with reverseBytes, then puts the bytes of
+// every UTF-8 character back in order (when the locale uses UTF-8). The last line may have no
+// newline. Returns 0 on success, -1 on error
+int revBlock(struct filter *filter, const char *data, size_t length) {
+    const char *end = data + length;
+    const char *line = data;
+    while (line < end) {
+        const char *newline = memchr(line, '\n', end - line);
+        size_t lineLength = (newline != NULL ? newline : end) - line;
+        char *reversed = reserveFilterOutput(filter, lineLength + 1);
+        if (reversed == NULL) {
+            return -1;
+        }
+        reverseBytes(reversed, line, lineLength);
+        // A reversed character is its continuation bytes (10xxxxxx) followed by its leading byte
+        for (size_t i = 0; filter->isUtf8 && (i < lineLength); i++) {
+            if (((unsigned char) reversed[i] & 0xC0) != 0x80) {
+                continue;
+            }
+            size_t j = i;
+            while ((j < lineLength) && (((unsigned char) reversed[j] & 0xC0) == 0x80)) {j++;}
+            if ((j < lineLength) && ((unsigned char) reversed[j] >= 0xC0)) {
+                for (size_t a = i, b = j; a < b; a++, b--) {
+                    char byte = reversed[a];
+                    reversed[a] = reversed[b];
+                    reversed[b] = byte;
+                }
+            }
+            i = j;
+        }
+        filter->outputLength += lineLength;
+        if (newline != NULL) {
+            reversed[lineLength] = '\n';
+            filter->outputLength++;
+        }
+        line = (newline != NULL) ? newline + 1 : end;
+    }
+    return 0;
+}
+// Opens the history file (creating it if needed), if it is not open yet. A failure is reported
+// only once. Returns 0 on success, -1 on error
+int openHistory() {
+    if (historyFd != -1) {
+        return 0;
+    }
+    if (historyOpenFailed) {
+        return -1;
+    }
+    if (historyPath == NULL) {
+        char *path = getenv("MYSHELL_HISTORY");
+        if (path != NULL) {
+            historyPath = strdup(path);
+        } else {
+            char *home = getenv("HOME");
+            if (home == NULL) {home = ".";}
+            historyPath = malloc(strlen(home) + strlen(HISTORY_FILE) + 2);
+            sprintf(historyPath, "%s/%s", home, HISTORY_FILE);
+        }
+    }
+    historyFd = open(historyPath, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    struct stat fileInfo;
+    if ((historyFd == -1) || (fstat(historyFd, &fileInfo) == -1)) {
+        perror("Error opening the history file");
+        if (historyFd != -1) {close(historyFd);}
+        historyFd = -1;
+        historyOpenFailed = 1;
+        return -1;
+    }
+    historyInode = fileInfo.st_ino;
+    return 0;
+}
+// Forgets everything about the history file (the mapping, the entries and the index) and closes it
+void resetHistory() {
+    if (historyMap != NULL) {
+        munmap(historyMap, historyMapLength);
+    }
+    historyMap = NULL;
+    historyMapLength = 0;
+    historyLength = 0;
+    free(historyOffsets);
+    historyOffsets = NULL;
+    historyOffsetsCapacity = 0;
+    numOfHistoryEntries = 0;
+    if (historyIndex != NULL) {
+        for (long i = 0; i < HISTORY_INDEX_SIZE; i++) {
+            free(historyIndex[i].entries);
+        }
+        free(historyIndex);
+    }
+    historyIndex = NULL;
+    numOfIndexedEntries = 0;
+    lastCommandEntry = -1;
+    if (historyFd != -1) {
+        close(historyFd);
+    }
+    historyFd = -1;
+}
+// Brings the entries up to date with the history file. The lines appended since the last call
+// (by any shell) become new entries, an incomplete last line is left for the next call. A file
+// which has been replaced or truncated is read from scratch
+void syncHistory() {
+    if (openHistory() == -1) {
+        return;
+    }
+    struct stat pathInfo, fileInfo;
+    if ((stat(historyPath, &pathInfo) == -1) || (pathInfo.st_ino != historyInode) ||
+        (fstat(historyFd, &fileInfo) == -1) || ((size_t) fileInfo.st_size < historyLength)) {
+        resetHistory();
+        if ((openHistory() == -1) || (fstat(historyFd, &fileInfo) == -1)) {
+            return;
+        }
+    }
+    size_t size = fileInfo.st_size;
+    if (size == historyLength) {
+        return;
+    }
+
+    // Mapping the new part, with some slack so the next appends fit without a remap
+    if (size > historyMapLength) {
+        if (historyMap != NULL) {
+            munmap(historyMap, historyMapLength);
+        }
+        historyMapLength = size + HISTORY_MAP_SLACK;
+        historyMap = mmap(NULL, historyMapLength, PROT_READ, MAP_SHARED, historyFd, 0);
+        if (historyMap == MAP_FAILED) {
+            perror("Error mapping the history file");
+            historyMap = NULL;
+            resetHistory();
+            historyOpenFailed = 1;
+            return;
+        }
+    }
+
+    // Every complete line after the ones we know is a new entry
+    char *position = historyMap + historyLength;
+    char *end = historyMap + size;
+    char *newline;
+    while ((newline = memchr(position, '\n', end - position)) != NULL) {
+        if (numOfHistoryEntries + 2 > historyOffsetsCapacity) {
+            historyOffsetsCapacity = historyOffsetsCapacity == 0 ? 1024 : historyOffsetsCapacity * 2;
+            historyOffsets = realloc(historyOffsets, historyOffsetsCapacity * sizeof(uint64_t));
+        }
+        historyOffsets[numOfHistoryEntries++] = position - historyMap;
+        position = newline + 1;
+    }
+    historyLength = position - historyMap;
+    if (historyOffsets != NULL) {
+        historyOffsets[numOfHistoryEntries] = historyLength;
+    }
+}
+// Adds the entries which are not inside the trigram index yet to it (building it on the first call)
+void indexHistory() {
+    syncHistory();
+    if (historyIndex == NULL) {
+        historyIndex = calloc(HISTORY_INDEX_SIZE, sizeof(struct historyPostingList));
+        numOfIndexedEntries = 0;
+    }
+    for (; numOfIndexedEntries < numOfHistoryEntries; numOfIndexedEntries++) {
+        size_t length;
+        char *text = historyEntry(numOfIndexedEntries, &length);
+        for (size_t i = 0; i + 2 < length; i++) {
+            struct historyPostingList *list = &historyIndex[TRIGRAM_BUCKET(text + i)];
+            // An entry is listed once per bucket, even if it has the trigram many times
+            if ((list->numOfEntries > 0) && (list->entries[list->numOfEntries - 1] == (uint32_t) numOfIndexedEntries)) {
+                continue;
+            }
+            if (list->numOfEntries == list->capacity) {
+                list->capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+                list->entries = realloc(list->entries, list->capacity * sizeof(uint32_t));
+            }
+            list->entries[list->numOfEntries++] = numOfIndexedEntries;
+        }
+    }
+}
+// Returns the text of an entry (not NULL terminated, it points into the mapping) and its length
+char *historyEntry(long number, size_t *length) {
+    *length = historyOffsets[number + 1] - historyOffsets[number] - 1;
+    return historyMap + historyOffsets[number];
+}
+// Returns the number of the entry starting at offset, -1 if there is none
+long findHistoryEntry(off_t offset) {
+    long low = 0, high = numOfHistoryEntries - 1;
+    while (low <= high) {
+        long middle = (low + high) / 2;
+        if (historyOffsets[middle] == (uint64_t) offset) {return middle;}
+        if (historyOffsets[middle] < (uint64_t) offset) {low = middle + 1;}
+        else {high = middle - 1;}
+    }
+    return -1;
+}
+// Returns the newest entry before the entry number "before" which contains query, -1 if there
+// is none. Only the entries of the shortest posting list among the trigrams of query can
+// contain it, so only they are checked. A query shorter than a trigram is searched linearly
+long searchHistory(const char *query, long before) {
+    size_t queryLength = strlen(query);
+    if (before > numOfHistoryEntries) {before = numOfHistoryEntries;}
+    if (queryLength < 3) {
+        for (long entry = before - 1; entry >= 0; entry--) {
+            size_t length;
+            char *text = historyEntry(entry, &length);
+            if (memmem(text, length, query, queryLength) != NULL) {
+                return entry;
+            }
+        }
+        return -1;
+    }
+
+    indexHistory();
+    struct historyPostingList *shortest = NULL;
+    for (size_t i = 0; i + 2 < queryLength; i++) {
+        struct historyPostingList *list = &historyIndex[TRIGRAM_BUCKET(query + i)];
+        if ((shortest == NULL) || (list->numOfEntries < shortest->numOfEntries)) {
+            shortest = list;
+        }
+    }
+    // The first position of the list whose entry is not before "before"
+    long low = 0, high = shortest->numOfEntries;
+    while (low < high) {
+        long middle = (low + high) / 2;
+        if (shortest->entries[middle] < (uint32_t) before) {low = middle + 1;}
+        else {high = middle;}
+    }
+    for (long position = low - 1; position >= 0; position--) {
+        size_t length;
+        char *text = historyEntry(shortest->entries[position], &length);
+        if (memmem(text, length, query, queryLength) != NULL) {
+            return shortest->entries[position];
+        }
+    }
+    return -1;
+}
+// Appends a line to the history file. The file is locked meanwhile, so the lines of concurrent
+// shells are never mixed. Returns the number of its entry, -1 on error
+long addHistory(const char *line) {
+    if (openHistory() == -1) {
+        return -1;
+    }
+    size_t length = strlen(line);
+    struct iovec vectors[2] = {{(char *) line, length}, {"\n", 1}};
+    flock(historyFd, LOCK_EX);
+    struct stat fileInfo;
+    off_t offset = (fstat(historyFd, &fileInfo) == 0) ? fileInfo.st_size : -1;
+    ssize_t bytesWritten = writev(historyFd, vectors, 2);
+    flock(historyFd, LOCK_UN);
+    if (bytesWritten != (ssize_t) length + 1) {
+        perror("Error writing the history file");
+        return -1;
+    }
+    syncHistory();
+    return findHistoryEntry(offset);
+}
+// Returns (as a new string) the "lastly executed command" of bello: the last successful line of
+// this shell, or the newest entry of the history if this shell has not run anything yet
+char *lastCommand() {
+    if (lastCommandLine != NULL) {
+        return strdup(lastCommandLine);
+    }
+    syncHistory();
+    long entry = (lastCommandEntry != -1) ? lastCommandEntry : numOfHistoryEntries - 1;
+    if ((entry < 0) || (entry >= numOfHistoryEntries)) {
+        return strdup("");
+    }
+    size_t length;
+    char *text = historyEntry(entry, &length);
+    return strndup(text, length);
+}
+// The history builtin. "history" lists every entry with its number, "history N" the last N
+// entries, and "history -s text" the entries containing text (found through the trigram index)
+int historyBuiltin(char **tokens, int numOfTokens) {
+    syncHistory();
+    if ((numOfTokens > 2) && (strcmp(tokens[1], "-s") == 0)) {
+        // Collecting the matches from the newest one, then printing them from the oldest one
+        long *matches = NULL;
+        long numOfMatches = 0, capacity = 0;
+        for (long entry = searchHistory(tokens[2], numOfHistoryEntries); entry != -1; entry = searchHistory(tokens[2], entry)) {
+            if (numOfMatches == capacity) {
+                capacity = capacity == 0 ? 64 : capacity * 2;
+                matches = realloc(matches, capacity * sizeof(long));
+            }
+            matches[numOfMatches++] = entry;
+        }
+        for (long i = numOfMatches - 1; i >= 0; i--) {
+            size_t length;
+            char *text = historyEntry(matches[i], &length);
+            printf("%5ld  %.*s\n", matches[i] + 1, (int) length, text);
+        }
+        free(matches);
+        return numOfMatches > 0 ? 0 : 1;
+    }
+    long first = 0;
+    if (numOfTokens > 1) {
+        long count = atol(tokens[1]);
+        if ((count >= 0) && (count < numOfHistoryEntries)) {first = numOfHistoryEntries - count;}
+    }
+    for (long entry = first; entry < numOfHistoryEntries; entry++) {
+        size_t length;
+        char *text = historyEntry(entry, &length);
+        printf("%5ld  %.*s\n", entry + 1, (int) length, text);
+    }
+    return 0;
+}
+// Redraws the prompt and the line (or the Ctrl-R search) on the current terminal line
+void refreshLine(struct lineEditor *editor) {
+    fflush(stdout);
+    dprintf(STDOUT_FILENO, "\r\033[K");
+    if (editor->isSearching) {
+        size_t length = 0;
+        char *text = editor->match != -1 ? historyEntry(editor->match, &length) : "";
+        dprintf(STDOUT_FILENO, "(reverse-i-search)`%s': %.*s", editor->query, (int) length, text);
+        return;
+    }
+    dprintf(STDOUT_FILENO, "%s%.*s", editor->prompt, (int) editor->length, editor->buffer);
+    editor->shownLength = editor->length;
+}
+// Replaces the line being edited with text
+void replaceLine(struct lineEditor *editor, const char *text, size_t length) {
+    if (length + 1 > editor->capacity) {
+        editor->capacity = length + 1;
+        editor->buffer = realloc(editor->buffer, editor->capacity);
+    }
+    memmove(editor->buffer, text, length);
+    editor->length = length;
+}
+// Adds a candidate (the first length bytes of name, followed by suffix) to a completion
+void addCandidate(struct completion *completion, const char *name, size_t length, const char *suffix) {
+    if (completion->numOfCandidates == completion->capacity) {
+        completion->capacity = completion->capacity == 0 ? 64 : completion->capacity * 2;
+        completion->candidates = realloc(completion->candidates, completion->capacity * sizeof(char *));
+    }
+    size_t suffixLength = strlen(suffix);
+    char *candidate = malloc(length + suffixLength + 1);
+    memcpy(candidate, name, length);
+    memcpy(candidate + length, suffix, suffixLength + 1);
+    completion->candidates[completion->numOfCandidates++] = candidate;
+}
+// Finds the commands starting with word: executables of PATH (through the command trie),
+// aliases and builtins
+void completeCommand(const char *word, struct completion *completion) {
+    size_t wordLength = strlen(word);
+    refreshCommandTrie();
+    struct trieNode *node = commandTrie;
+    for (size_t i = 0; (i < wordLength) && (node != NULL); i++) {
+        node = node->child;
+        while ((node != NULL) && (node->character != word[i])) {
+            node = node->sibling;
+        }
+    }
+    if ((node != NULL) && (node->numOfNames > 0)) {
+        char name[4096];
+        memcpy(name, word, wordLength);
+        collectTrie(node, name, wordLength, completion);
+    }
+
+    syncAliases();
+    for (size_t i = 0; i < aliasTableSize; i++) {
+        for (struct aliasEntry *entry = aliasTable[i]; entry != NULL; entry = entry->next) {
+            if (strncmp(entry->key, word, wordLength) == 0) {
+                addCandidate(completion, entry->key, strlen(entry->key), "");
+            }
+        }
+    }
+    for (int i = 0; builtinTable[i].name != NULL; i++) {
+        if (strncmp(builtinTable[i].name, word, wordLength) == 0) {
+            addCandidate(completion, builtinTable[i].name, strlen(builtinTable[i].name), "");
+        }
+    }
+}
+// Finds the files starting with word, which may contain a directory part ("src/ma" lists "src").
+// Hidden files are included only if the word starts them with a dot
+void completePath(const char *word, struct completion *completion) {
+    const char *slash = strrchr(word, '/');
+    size_t directoryLength = slash != NULL ? slash - word + 1 : 0;
+    const char *prefix = word + directoryLength;
+    size_t prefixLength = strlen(prefix);
+    completion->displayOffset = directoryLength;
+
+    char *directory = directoryLength > 0 ? strndup(word, directoryLength) : strdup(".");
+    DIR *stream = opendir(directory);
+    free(directory);
+    if (stream == NULL) {
+        return;
+    }
+    size_t capacity = directoryLength + 256 + 2;
+    char *candidate = malloc(capacity);
+    memcpy(candidate, word, directoryLength);
+    struct dirent *entry;
+    while ((entry = readdir(stream)) != NULL) {
+        if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) {
+            continue;
+        }
+        if ((strncmp(entry->d_name, prefix, prefixLength) != 0) || ((entry->d_name[0] == '.') && (prefix[0] != '.'))) {
+            continue;
+        }
+        // Directories get a slash, so the completion can go on inside them
+        int isDirectory = entry->d_type == DT_DIR;
+        if ((entry->d_type == DT_LNK) || (entry->d_type == DT_UNKNOWN)) {
+            struct stat fileInfo;
+            isDirectory = (fstatat(dirfd(stream), entry->d_name, &fileInfo, 0) == 0) && S_ISDIR(fileInfo.st_mode);
+        }
+        size_t nameLength = strlen(entry->d_name);
+        memcpy(candidate + directoryLength, entry->d_name, nameLength);
+        addCandidate(completion, candidate, directoryLength + nameLength, isDirectory ? "/" : "");
+    }
+    closedir(stream);
+    free(candidate);
+}
+// Comparison function for qsort
+int compareCandidates(const void *first, const void *second) {
+    return strcmp(*(char *const *) first, *(char *const *) second);
+}
+// Completes the word before the cursor (the end of the line). The first word of a command is
+// completed as a command, any other word as a file. A single candidate replaces the word, several
+// extend it to their longest common prefix, and if that adds nothing they are listed
+void completeLine(struct lineEditor *editor) {
+    size_t wordStart = editor->length;
+    while ((wordStart > 0) && (editor->buffer[wordStart - 1] != ' ')) {
+        wordStart--;
+    }
+    size_t previous = wordStart;
+    while ((previous > 0) && (editor->buffer[previous - 1] == ' ')) {
+        previous--;
+    }
+    char *word = strndup(editor->buffer + wordStart, editor->length - wordStart);
+    int isCommand = ((previous == 0) || (editor->buffer[previous - 1] == '|')) && (strchr(word, '/') == NULL);
+
+    struct completion completion = {NULL, 0, 0, 0};
+    if (isCommand) {
+        completeCommand(word, &completion);
+    } else {
+        completePath(word, &completion);
+    }
+
+    // Sorting the candidates and dropping the duplicates (an alias may also be a command)
+    qsort(completion.candidates, completion.numOfCandidates, sizeof(char *), compareCandidates);
+    int numOfUnique = 0;
+    for (int i = 0; i < completion.numOfCandidates; i++) {
+        if ((numOfUnique > 0) && (strcmp(completion.candidates[numOfUnique - 1], completion.candidates[i]) == 0)) {
+            free(completion.candidates[i]);
+            continue;
+        }
+        completion.candidates[numOfUnique++] = completion.candidates[i];
+    }
+    completion.numOfCandidates = numOfUnique;
+
+    if (completion.numOfCandidates == 0) {
+        write(STDOUT_FILENO, "\a", 1);
+    } else {
+        // The longest common prefix of the candidates
+        char *first = completion.candidates[0];
+        size_t commonLength = strlen(first);
+        for (int i = 1; i < completion.numOfCandidates; i++) {
+            size_t j = 0;
+            while ((j < commonLength) && (first[j] == completion.candidates[i][j])) {j++;}
+            commonLength = j;
+        }
+        size_t wordLength = strlen(word);
+        if ((completion.numOfCandidates == 1) || (commonLength > wordLength)) {
+            // Replacing the word, a single candidate which is not a directory also ends it
+            int addsBlank = (completion.numOfCandidates == 1) && (first[commonLength - 1] != '/');
+            size_t newLength = wordStart + commonLength + addsBlank;
+            if (newLength + 1 > editor->capacity) {
+                editor->capacity = newLength + 1;
+                editor->buffer = realloc(editor->buffer, editor->capacity);
+            }
+            memcpy(editor->buffer + wordStart, first, commonLength);
+            if (addsBlank) {editor->buffer[wordStart + commonLength] = ' ';}
+            editor->length = newLength;
+            editor->shownLength = editor->shownLength < wordStart ? editor->shownLength : wordStart;
+            refreshLine(editor);
+        } else if (completion.numOfCandidates > COMPLETION_LIST_LIMIT) {
+            dprintf(STDOUT_FILENO, "\n%d possibilities\n", completion.numOfCandidates);
+            refreshLine(editor);
+        } else {
+            // Listing them in columns as wide as the terminal allows
+            struct winsize window;
+            int width = (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == 0) && (window.ws_col > 0) ? window.ws_col : 80;
+            size_t columnWidth = 0;
+            for (int i = 0; i < completion.numOfCandidates; i++) {
+                size_t length = strlen(completion.candidates[i] + completion.displayOffset);
+                if (length > columnWidth) {columnWidth = length;}
+            }
+            columnWidth += 2;
+            int numOfColumns = width / columnWidth > 0 ? width / columnWidth : 1;
+            int numOfRows = (completion.numOfCandidates + numOfColumns - 1) / numOfColumns;
+            write(STDOUT_FILENO, "\n", 1);
+            for (int row = 0; row < numOfRows; row++) {
+                for (int i = row; i < completion.numOfCandidates; i += numOfRows) {
+                    dprintf(STDOUT_FILENO, "%-*s", (int) columnWidth, completion.candidates[i] + completion.displayOffset);
+                }
+                write(STDOUT_FILENO, "\n", 1);
+            }
+            refreshLine(editor);
+        }
+    }
+
+    for (int i = 0; i < completion.numOfCandidates; i++) {
+        free(completion.candidates[i]);
+    }
+    free(completion.candidates);
+    free(word);
+}
+// Reads one key from the terminal (from editorInput, refilled with a single read when empty).
+// While waiting for it, the event loop is run too: a background job which terminates or stops is
+// reported at once (above the line being edited, which is redrawn), a resized window redraws the
+// line and a SIGINT counts as Ctrl-C. Returns -1 at end of file
+int readEditorKey(struct lineEditor *editor) {
+    while (editorInputStart == editorInputLength) {
+        if (inputEpollFd != -1) {
+            struct epoll_event event;
+            int numOfEvents = epoll_wait(inputEpollFd, &event, 1, -1);
+            if ((numOfEvents == -1) && (errno == EINTR)) {
+                continue;
+            }
+            if ((numOfEvents == 1) && (event.data.fd == childEpollFd)) {
+                processChildEvents();
+                if (isInterruptPending) {
+                    isInterruptPending = 0;
+                    return 3;
+                }
+                if (hasJobsToReport()) {
+                    dprintf(STDOUT_FILENO, "\r\033[K");
+                    reportJobs();
+                    refreshLine(editor);
+                } else if (isWindowResized) {
+                    refreshLine(editor);
+                }
+                isWindowResized = 0;
+                continue;
+            }
+        }
+        ssize_t bytesRead = read(STDIN_FILENO, editorInput, sizeof(editorInput));
+        if ((bytesRead == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            return -1;
+        }
+        editorInputStart = 0;
+        editorInputLength = bytesRead;
+    }
+    return (unsigned char) editorInput[editorInputStart++];
+}
+// Prints the prompt and reads one line from the terminal with the line editor. Typed characters
+// are echoed in batches (a pasted line is echoed with one write). Returns the line as a new
+// string, NULL at end of file (Ctrl-D on an empty line)
+char *readInteractiveLine(const char *prompt) {
+    syncHistory();
+    struct lineEditor editor;
+    memset(&editor, 0, sizeof(editor));
+    editor.prompt = prompt;
+    editor.capacity = 256;
+    editor.buffer = malloc(editor.capacity);
+    editor.historyPosition = numOfHistoryEntries;
+    editor.match = -1;
+
+    // A SIGINT or SIGWINCH which has arrived while a command was running is not meant for this line
+    processChildEvents();
+    isInterruptPending = 0;
+    isWindowResized = 0;
+
+    // Raw mode: no line editing, echo or signal keys by the terminal itself
+    struct termios raw = shellTermios;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_iflag &= ~(IXON | ICRNL | INLCR);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+    printf("%s", prompt);
+    fflush(stdout);
+
+    int isDone = 0, isEndOfFile = 0;
+    while (!isDone) {
+        // Echoing what has been typed, once the keys read so far are handled
+        if ((editorInputStart == editorInputLength) && !editor.isSearching && (editor.shownLength < editor.length)) {
+            write(STDOUT_FILENO, editor.buffer + editor.shownLength, editor.length - editor.shownLength);
+            editor.shownLength = editor.length;
+        }
+        int key = readEditorKey(&editor);
+        if (key == -1) {
+            isEndOfFile = 1;
+            break;
+        }
+
+        /** Ctrl-R mode **/
+        if (editor.isSearching) {
+            if ((key >= 32) && (key != 127)) {
+                // One more character of the query, searching again from the newest entry
+                if (editor.queryLength < sizeof(editor.query) - 1) {
+                    editor.query[editor.queryLength++] = key;
+                    editor.query[editor.queryLength] = '\0';
+                }
+                editor.match = searchHistory(editor.query, numOfHistoryEntries);
+            } else if ((key == 127) || (key == 8)) {
+                if (editor.queryLength > 0) {editor.query[--editor.queryLength] = '\0';}
+                editor.match = editor.queryLength > 0 ? searchHistory(editor.query, numOfHistoryEntries) : -1;
+            } else if (key == 18) {
+                // Ctrl-R again, the next older match
+                long older = editor.match != -1 ? searchHistory(editor.query, editor.match) : -1;
+                if (older != -1) {editor.match = older;}
+            } else if ((key == 7) || (key == 3)) {
+                // Ctrl-G or Ctrl-C, leaving the line as it was
+                editor.isSearching = 0;
+            } else {
+                // Anything else takes the match into the line, Enter also runs it
+                if (editor.match != -1) {
+                    size_t length;
+                    char *text = historyEntry(editor.match, &length);
+                    replaceLine(&editor, text, length);
+                    editor.historyPosition = editor.match;
+                }
+                editor.isSearching = 0;
+                if ((key == '\r') || (key == '\n')) {
+                    refreshLine(&editor);
+                    printf("\n");
+                    isDone = 1;
+                    continue;
+                }
+                if (key == 27) {
+                    // Dropping the rest of an escape sequence
+                    int next = readEditorKey(&editor);
+                    while ((next == '[') || (next == 'O') || ((next >= '0') && (next <= '9')) || (next == ';')) {next = readEditorKey(&editor);}
+                }
+            }
+            refreshLine(&editor);
+            continue;
+        }
+
+        /** Normal mode **/
+        if ((key == '\r') || (key == '\n')) {
+            if (editor.shownLength < editor.length) {
+                write(STDOUT_FILENO, editor.buffer + editor.shownLength, editor.length - editor.shownLength);
+            }
+            printf("\n");
+            isDone = 1;
+        } else if (key == 3) {
+            // Ctrl-C, an empty line (which also drops the lines of a construct being typed)
+            printf("^C\n");
+            editor.length = 0;
+            free(pendingLines);
+            pendingLines = NULL;
+            isDone = 1;
+        } else if (key == 4) {
+            // Ctrl-D, end of file on an empty line
+            if (editor.length == 0) {
+                isEndOfFile = 1;
+                isDone = 1;
+            }
+        } else if ((key == 127) || (key == 8)) {
+            // Backspace, removing a whole UTF-8 character
+            while ((editor.length > 0) && (((unsigned char) editor.buffer[editor.length - 1] & 0xC0) == 0x80)) {editor.length--;}
+            if (editor.length > 0) {editor.length--;}
+            refreshLine(&editor);
+        } else if (key == 9) {
+            // Tab, completing the word before the cursor (what has been typed is echoed first)
+            if (editor.shownLength < editor.length) {
+                write(STDOUT_FILENO, editor.buffer + editor.shownLength, editor.length - editor.shownLength);
+                editor.shownLength = editor.length;
+            }
+            completeLine(&editor);
+        } else if (key == 21) {
+            // Ctrl-U, clearing the line
+            editor.length = 0;
+            refreshLine(&editor);
+        } else if (key == 18) {
+            // Ctrl-R, starting a search
+            editor.isSearching = 1;
+            editor.queryLength = 0;
+            editor.query[0] = '\0';
+            editor.match = -1;
+            refreshLine(&editor);
+        } else if (key == 27) {
+            // Escape sequences, Up and Down walk the history
+            int next = readEditorKey(&editor);
+            int final = readEditorKey(&editor);
+            while (((final >= '0') && (final <= '9')) || (final == ';')) {final = readEditorKey(&editor);}
+            if (((next == '[') || (next == 'O')) && ((final == 'A') || (final == 'B'))) {
+                if ((final == 'A') && (editor.historyPosition > 0)) {
+                    if (editor.historyPosition == numOfHistoryEntries) {
+                        // Keeping the new line, Down brings it back
+                        editor.saved = realloc(editor.saved, editor.length + 1);
+                        memcpy(editor.saved, editor.buffer, editor.length);
+                        editor.savedLength = editor.length;
+                    }
+                    editor.historyPosition--;
+                } else if ((final == 'B') && (editor.historyPosition < numOfHistoryEntries)) {
+                    editor.historyPosition++;
+                } else {
+                    continue;
+                }
+                if (editor.historyPosition == numOfHistoryEntries) {
+                    replaceLine(&editor, editor.saved != NULL ? editor.saved : "", editor.savedLength);
+                } else {
+                    size_t length;
+                    char *text = historyEntry(editor.historyPosition, &length);
+                    replaceLine(&editor, text, length);
+                }
+                refreshLine(&editor);
+            }
+        } else if (key >= 32) {
+            // A usual character, echoed later
+            if (editor.length + 1 >= editor.capacity) {
+                editor.capacity *= 2;
+                editor.buffer = realloc(editor.buffer, editor.capacity);
+            }
+            editor.buffer[editor.length++] = key;
+        }
+    }
+
+    fflush(stdout);
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &shellTermios);
+    free(editor.saved);
+    if (isEndOfFile && (editor.length == 0)) {
+        free(editor.buffer);
+        return NULL;
+    }
+    editor.buffer[editor.length] = '\0';
+    return editor.buffer;
+}
+/** Scripting: parser **/
+// Skips spaces, tabs, backslash-newline pairs and a comment (up to, not including, its newline)
+void skipBlanks(struct scriptParser *parser) {
+    char *c = parser->position;
+    while (1) {
+        if ((*c == ' ') || (*c == '\t')) {c++;}
+        else if ((c[0] == '\\') && (c[1] == '\n')) {c += 2;}
+        else if (*c == '#') {
+            while ((*c != '\0') && (*c != '\n')) {c++;}
+        }
+        else {break;}
+    }
+    parser->position = c;
+}
+// Skips blanks, newlines and the ; of empty statements (but not the ;; of a case)
+void skipSeparators(struct scriptParser *parser) {
+    while (1) {
+        skipBlanks(parser);
+        char *c = parser->position;
+        if ((*c == '\n') || ((*c == ';') && (c[1] != ';'))) {
+            parser->position++;
+            continue;
+        }
+        return;
+    }
+}
+// Returns 1 if the word at position is word, followed by something which ends a word
+int isWordAt(const char *position, const char *word) {
+    size_t length = strlen(word);
+    return (strncmp(position, word, length) == 0) && (strchr(" \t\n;&|()<>", position[length]) != NULL);
+}
+// Reports a syntax error at the word the parser has stopped at
+void scriptSyntaxError(struct scriptParser *parser) {
+    parser->status = PARSE_ERROR;
+    if (parser->isQuiet) {
+        return;
+    }
+    const char *c = parser->position;
+    size_t length = strcspn(c, " \t\n;&|()<>");
+    if ((length == 0) && (strchr(";&|()<>", *c) != NULL)) {
+        length = c[1] == c[0] ? 2 : 1; // An operator
+    }
+    if (length == 0) {
+        fprintf(stderr, "Error: syntax error near the end of the line\n");
+    } else {
+        fprintf(stderr, "Error: syntax error near '%.*s'\n", (int) (length > 32 ? 32 : length), c);
+    }
+}
+// Allocates an empty node from the arena of the parser
+struct scriptNode *newNode(struct scriptParser *parser, int type) {
+    struct scriptNode *node = arenaAlloc(&parser->arena, sizeof(struct scriptNode));
+    memset(node, 0, sizeof(struct scriptNode));
+    node->type = type;
+    return node;
+}
+// Takes the text up to (not including) the first unquoted character of stops (or the end) and
+// returns a copy of it without its surrounding blanks. Returns NULL if a quote is not closed
+char *scanWords(struct scriptParser *parser, const char *stops) {
+    char *start = parser->position, *c = start;
+    char quote = '\0'; // The quote we are inside, if any
+    for (; *c != '\0'; c++) {
+        if (quote == '\'') {
+            if (*c == '\'') {quote = '\0';}
+        } else if ((*c == '\\') && (c[1] != '\0')) {
+            c++;
+        } else if (quote == '"') {
+            if (*c == '"') {quote = '\0';}
+        } else if ((*c == '\'') || (*c == '"')) {
+            quote = *c;
+        } else if (strchr(stops, *c) != NULL) {
+            break;
+        }
+    }
+    parser->position = c;
+    if (quote != '\0') {
+        parser->status = PARSE_INCOMPLETE;
+        return NULL;
+    }
+    while ((start < c) && ((*start == ' ') || (*start == '\t'))) {start++;}
+    while ((c > start) && ((c[-1] == ' ') || (c[-1] == '\t'))) {c--;}
+    char *text = arenaAlloc(&parser->arena, c - start + 1);
+    memcpy(text, start, c - start);
+    text[c - start] = '\0';
+    return text;
+}
+// Takes the keyword which must come next. Returns 0 on success, -1 (with the status set) if
+// something else is there
+int expectKeyword(struct scriptParser *parser, const char *keyword) {
+    skipBlanks(parser);
+    if (isWordAt(parser->position, keyword)) {
+        parser->position += strlen(keyword);
+        return 0;
+    }
+    if (*parser->position == '\0') {
+        parser->status = PARSE_INCOMPLETE;
+    } else {
+        scriptSyntaxError(parser);
+    }
+    return -1;
+}
+// Returns the length of the variable (or function) name at position, 0 if there is none
+size_t scanName(const char *position) {
+    const char *c = position;
+    if (!(((*c >= 'a') && (*c <= 'z')) || ((*c >= 'A') && (*c <= 'Z')) || (*c == '_'))) {
+        return 0;
+    }
+    for (c++; ((*c >= 'a') && (*c <= 'z')) || ((*c >= 'A') && (*c <= 'Z')) || ((*c >= '0') && (*c <= '9')) || (*c == '_'); c++);
+    return c - position;
+}
+// Parses commands separated by ; & or newlines, until one of the terminators (keywords, which
+// are not taken) or a ;; is reached. A top-level list ends with its line instead. Running out
+// of text inside a construct makes the parse incomplete
+struct scriptNode *parseList(struct scriptParser *parser, const char **terminators, int isTopLevel) {
+    struct scriptNode *list = newNode(parser, NODE_LIST);
+    struct scriptNode **last = &list->first;
+    while (1) {
+        // Separators (and empty statements) before the next command
+        if (isTopLevel) {
+            skipBlanks(parser);
+            while (*parser->position == ';') {
+                parser->position++;
+                skipBlanks(parser);
+            }
+            if (*parser->position == '\n') {
+                parser->position++;
+                return list;
+            }
+        } else {
+            skipSeparators(parser);
+        }
+        char *c = parser->position;
+        if (*c == '\0') {
+            if (!isTopLevel) {parser->status = PARSE_INCOMPLETE;}
+            return list;
+        }
+        if ((c[0] == ';') && (c[1] == ';')) {
+            return list;
+        }
+        for (int t = 0; (terminators != NULL) && (terminators[t] != NULL); t++) {
+            if (isWordAt(c, terminators[t])) {return list;}
+        }
+
+        struct scriptNode *node = parseAndOr(parser);
+        if (parser->status != PARSE_OK) {
+            return NULL;
+        }
+        *last = node;
+        last = &node->next;
+
+        // A command ends with a separator, a & or the keyword closing its construct
+        skipBlanks(parser);
+        c = parser->position;
+        int isTerminated = parser->endsWithAmpersand || (*c == '\0') || (*c == '\n') || (*c == ';');
+        for (int t = 0; (terminators != NULL) && (terminators[t] != NULL); t++) {
+            if (isWordAt(c, terminators[t])) {isTerminated = 1;}
+        }
+        if (!isTerminated) {
+            scriptSyntaxError(parser);
+            return NULL;
+        }
+    }
+}
+// Parses commands joined by && and || (which bind equally, from left to right)
+struct scriptNode *parseAndOr(struct scriptParser *parser) {
+    struct scriptNode *node = parseCommand(parser);
+    while (parser->status == PARSE_OK) {
+        skipBlanks(parser);
+        char *c = parser->position;
+        int type;
+        if ((c[0] == '&') && (c[1] == '&')) {type = NODE_AND;}
+        else if ((c[0] == '|') && (c[1] == '|')) {type = NODE_OR;}
+        else {break;}
+        parser->position += 2;
+        skipSeparators(parser); // The next command may be on the next line
+        struct scriptNode *combined = newNode(parser, type);
+        combined->first = node;
+        combined->second = parseCommand(parser);
+        node = combined;
+    }
+    return parser->status == PARSE_OK ? node : NULL;
+}
+// Parses one command: a compound command (if, while, until, for, case, { }), a function
+// definition, a negated command or a simple command
+struct scriptNode *parseCommand(struct scriptParser *parser) {
+    static const char *reservedWords[] = {"then", "else", "elif", "fi", "do", "done", "esac", "}", NULL};
+    static const char *groupEnd[] = {"}", NULL};
+    skipBlanks(parser);
+    parser->endsWithAmpersand = 0;
+    char *c = parser->position;
+    if (*c == '\0') {
+        parser->status = PARSE_INCOMPLETE;
+        return NULL;
+    }
+    if ((c[0] == '!') && ((c[1] == ' ') || (c[1] == '\t'))) {
+        parser->position++;
+        struct scriptNode *node = newNode(parser, NODE_NOT);
+        node->first = parseCommand(parser);
+        return parser->status == PARSE_OK ? node : NULL;
+    }
+    if (isWordAt(c, "if")) {
+        parser->position += 2;
+        return parseIf(parser);
+    }
+    if (isWordAt(c, "while") || isWordAt(c, "until")) {
+        parser->position += 5;
+        return parseLoop(parser, c[0] == 'w' ? NODE_WHILE : NODE_UNTIL);
+    }
+    if (isWordAt(c, "for")) {
+        parser->position += 3;
+        return parseFor(parser);
+    }
+    if (isWordAt(c, "case")) {
+        parser->position += 4;
+        return parseCase(parser);
+    }
+    if (isWordAt(c, "function")) {
+        parser->position += 8;
+        skipBlanks(parser);
+        char *name = parser->position;
+        size_t nameLength = scanName(name);
+        if (nameLength == 0) {
+            scriptSyntaxError(parser);
+            return NULL;
+        }
+        parser->position += nameLength;
+        skipBlanks(parser);
+        if (*parser->position == '(') {
+            parser->position++;
+            skipBlanks(parser);
+            if (*parser->position != ')') {
+                scriptSyntaxError(parser);
+                return NULL;
+            }
+            parser->position++;
+        }
+        return parseFunctionBody(parser, name, nameLength);
+    }
+    if (isWordAt(c, "{")) {
+        parser->position++;
+        struct scriptNode *list = parseList(parser, groupEnd, 0);
+        if ((parser->status != PARSE_OK) || (expectKeyword(parser, "}") != 0)) {
+            return NULL;
+        }
+        return list;
+    }
+    for (int r = 0; reservedWords[r] != NULL; r++) {
+        if (isWordAt(c, reservedWords[r])) {
+            scriptSyntaxError(parser);
+            return NULL;
+        }
+    }
+    if ((*c == ';') || (*c == '&') || (*c == '|') || (*c == ')')) {
+        scriptSyntaxError(parser);
+        return NULL;
+    }
+
+    // name() body
+    size_t nameLength = scanName(c);
+    if (nameLength > 0) {
+        char *d = c + nameLength;
+        while ((*d == ' ') || (*d == '\t')) {d++;}
+        if (*d == '(') {
+            for (d++; (*d == ' ') || (*d == '\t'); d++);
+            if (*d == ')') {
+                parser->position = d + 1;
+                return parseFunctionBody(parser, c, nameLength);
+            }
+        }
+    }
+    return parseSimpleCommand(parser);
+}
+// Parses a simple command (or a pipeline), whose text is kept as it is for parser(). It ends at
+// an unquoted ; newline && || or comment, or right after a single & (which stays in its text).
+// A line ending with a | goes on with the next line
+struct scriptNode *parseSimpleCommand(struct scriptParser *parser) {
+    char *start = parser->position, *c = start, *end = NULL;
+    char quote = '\0'; // The quote we are inside, if any
+    int endsWithPipe = 0; // 1 if the last character outside quotes (and blanks) has been a |
+    while (1) {
+        if (*c == '\0') {
+            if ((quote != '\0') || endsWithPipe) {
+                parser->status = PARSE_INCOMPLETE;
+                return NULL;
+            }
+            break;
+        }
+        if (quote == '\'') {
+            if (*c == '\'') {quote = '\0';}
+            c++;
+            continue;
+        }
+        if (*c == '\\') {
+            if (c[1] == '\0') {
+                parser->status = PARSE_INCOMPLETE;
+                return NULL;
+            }
+            c += 2;
+            endsWithPipe = 0;
+            continue;
+        }
+        if (quote == '"') {
+            if (*c == '"') {quote = '\0';}
+            c++;
+            continue;
+        }
+        if ((*c == '\'') || (*c == '"')) {
+            quote = *c++;
+            endsWithPipe = 0;
+            continue;
+        }
+        if (((*c == '\n') && !endsWithPipe) || (*c == ';')) {break;}
+        if ((c[0] == '&') && (c[1] == '&')) {break;}
+        if ((c[0] == '|') && (c[1] == '|')) {break;}
+        if (*c == '&') {
+            parser->endsWithAmpersand = 1;
+            c++;
+            break;
+        }
+        if ((*c == '#') && ((c == start) || (c[-1] == ' ') || (c[-1] == '\t'))) {
+            // A comment ends the command, the parser goes on at its newline
+            end = c;
+            while ((*c != '\0') && (*c != '\n')) {c++;}
+            break;
+        }
+        if (*c == '|') {endsWithPipe = 1;}
+        else if ((*c != ' ') && (*c != '\t') && (*c != '\n')) {endsWithPipe = 0;}
+        c++;
+    }
+    parser->position = c;
+    if (end == NULL) {end = c;}
+
+    // Copying the text without its backslash-newline pairs (outside single quotes) and its trailing blanks
+    struct scriptNode *node = newNode(parser, NODE_COMMAND);
+    char *text = node->text = arenaAlloc(&parser->arena, end - start + 1);
+    quote = '\0';
+    for (char *d = start; d < end; d++) {
+        if ((quote != '\'') && (d[0] == '\\') && (d[1] == '\n')) {
+            d++;
+            continue;
+        }
+        if ((quote != '\'') && (d[0] == '\\') && (d + 1 < end)) {
+            *text++ = *d++;
+        } else if ((*d == '\'') || (*d == '"')) {
+            if (quote == '\0') {quote = *d;}
+            else if (quote == *d) {quote = '\0';}
+        }
+        *text++ = *d;
+    }
+    while ((text > node->text) && ((text[-1] == ' ') || (text[-1] == '\t'))) {text--;}
+    *text = '\0';
+    return node;
+}
+// Parses the rest of an if (after the if or elif): condition, then part, and the elif or else parts
+struct scriptNode *parseIf(struct scriptParser *parser) {
+    static const char *conditionEnd[] = {"then", NULL};
+    static const char *thenEnd[] = {"elif", "else", "fi", NULL};
+    static const char *elseEnd[] = {"fi", NULL};
+    struct scriptNode *node = newNode(parser, NODE_IF);
+    node->first = parseList(parser, conditionEnd, 0);
+    if ((parser->status != PARSE_OK) || (expectKeyword(parser, "then") != 0)) {
+        return NULL;
+    }
+    node->second = parseList(parser, thenEnd, 0);
+    if (parser->status != PARSE_OK) {
+        return NULL;
+    }
+    if (isWordAt(parser->position, "elif")) {
+        parser->position += 4;
+        node->third = parseIf(parser); // It takes the fi
+        return parser->status == PARSE_OK ? node : NULL;
+    }
+    if (isWordAt(parser->position, "else")) {
+        parser->position += 4;
+        node->third = parseList(parser, elseEnd, 0);
+        if (parser->status != PARSE_OK) {
+            return NULL;
+        }
+    }
+    return expectKeyword(parser, "fi") == 0 ? node : NULL;
+}
+// Parses the rest of a while or until loop (after its keyword)
+struct scriptNode *parseLoop(struct scriptParser *parser, int type) {
+    static const char *conditionEnd[] = {"do", NULL};
+    static const char *bodyEnd[] = {"done", NULL};
+    struct scriptNode *node = newNode(parser, type);
+    node->first = parseList(parser, conditionEnd, 0);
+    if ((parser->status != PARSE_OK) || (expectKeyword(parser, "do") != 0)) {
+        return NULL;
+    }
+    node->second = parseList(parser, bodyEnd, 0);
+    if ((parser->status != PARSE_OK) || (expectKeyword(parser, "done") != 0)) {
+        return NULL;
+    }
+    return node;
+}
+// Parses the rest of a for loop (after the for): for NAME [in WORDS]; do LIST; done
+struct scriptNode *parseFor(struct scriptParser *parser) {
+    static const char *bodyEnd[] = {"done", NULL};
+    skipBlanks(parser);
+    size_t nameLength = scanName(parser->position);
+    if (nameLength == 0) {
+        if (*parser->position == '\0') {parser->status = PARSE_INCOMPLETE;}
+        else {scriptSyntaxError(parser);}
+        return NULL;
+    }
+    struct scriptNode *node = newNode(parser, NODE_FOR);
+    node->text = arenaAlloc(&parser->arena, nameLength + 1);
+    memcpy(node->text, parser->position, nameLength);
+    node->text[nameLength] = '\0';
+    parser->position += nameLength;
+    skipBlanks(parser);
+    if (isWordAt(parser->position, "in")) {
+        parser->position += 2;
+        node->words = scanWords(parser, ";\n");
+        if (node->words == NULL) {
+            return NULL;
+        }
+    }
+    skipSeparators(parser);
+    if (expectKeyword(parser, "do") != 0) {
+        return NULL;
+    }
+    node->second = parseList(parser, bodyEnd, 0);
+    if ((parser->status != PARSE_OK) || (expectKeyword(parser, "done") != 0)) {
+        return NULL;
+    }
+    return node;
+}
+// Parses the rest of a case (after the case): case WORD in [(]PATTERN[|PATTERN]...) LIST ;; ... esac
+struct scriptNode *parseCase(struct scriptParser *parser) {
+    static const char *itemEnd[] = {"esac", NULL};
+    skipBlanks(parser);
+    struct scriptNode *node = newNode(parser, NODE_CASE);
+    node->text = scanWords(parser, " \t\n;&|()<>");
+    if (node->text == NULL) {
+        return NULL;
+    }
+    if (node->text[0] == '\0') {
+        if (*parser->position == '\0') {parser->status = PARSE_INCOMPLETE;}
+        else {scriptSyntaxError(parser);}
+        return NULL;
+    }
+    skipSeparators(parser);
+    if (expectKeyword(parser, "in") != 0) {
+        return NULL;
+    }
+    struct scriptNode **last = &node->first;
+    while (1) {
+        skipSeparators(parser);
+        if (*parser->position == '\0') {
+            parser->status = PARSE_INCOMPLETE;
+            return NULL;
+        }
+        if (isWordAt(parser->position, "esac")) {
+            parser->position += 4;
+            return node;
+        }
+        if (*parser->position == '(') {parser->position++;}
+        struct scriptNode *item = newNode(parser, NODE_CASE_ITEM);
+        item->text = scanWords(parser, ")\n");
+        if (item->text == NULL) {
+            return NULL;
+        }
+        if (*parser->position != ')') {
+            if (*parser->position == '\0') {parser->status = PARSE_INCOMPLETE;}
+            else {scriptSyntaxError(parser);}
+            return NULL;
+        }
+        parser->position++;
+        item->second = parseList(parser, itemEnd, 0);
+        if (parser->status != PARSE_OK) {
+            return NULL;
+        }
+        if ((parser->position[0] == ';') && (parser->position[1] == ';')) {
+            parser->position += 2;
+        } else if (!isWordAt(parser->position, "esac")) {
+            scriptSyntaxError(parser);
+            return NULL;
+        }
+        *last = item;
+        last = &item->next;
+    }
+}
+// Parses the body of a function definition, the name has already been taken
+struct scriptNode *parseFunctionBody(struct scriptParser *parser, const char *name, size_t nameLength) {
+    struct scriptNode *node = newNode(parser, NODE_FUNCTION);
+    node->text = arenaAlloc(&parser->arena, nameLength + 1);
+    memcpy(node->text, name, nameLength);
+    node->text[nameLength] = '\0';
+    skipSeparators(parser);
+    node->second = parseCommand(parser);
+    return parser->status == PARSE_OK ? node : NULL;
+}
+// Returns PARSE_OK if the whole text parses, PARSE_INCOMPLETE if it needs more lines,
+// PARSE_ERROR on a syntax error. Nothing is printed, nothing is run
+int checkScript(char *text) {
+    struct scriptParser parser = {text, {NULL}, PARSE_OK, 1, 0};
+    while ((*parser.position != '\0') && (parser.status == PARSE_OK)) {
+        parseList(&parser, NULL, 1);
+    }
+    arenaFree(&parser.arena);
+    return parser.status;
+}
+
+/** Scripting: evaluation **/
+// Parses and runs the commands of a text (a script, the string of -c, or a typed line), one
+// top-level command at a time. A syntax error skips the rest of its line
+void runScriptText(char *text) {
+    struct scriptParser parser = {text, {NULL}, PARSE_OK, 0, 0};
+    while (*parser.position != '\0') {
+        char *start = parser.position;
+        parser.status = PARSE_OK;
+        struct scriptNode *list = parseList(&parser, NULL, 1);
+        if (parser.status != PARSE_OK) {
+            if (parser.status == PARSE_INCOMPLETE) {
+                fprintf(stderr, "Error: syntax error, unexpected end of input\n");
+                parser.position = start + strlen(start);
+            } else {
+                char *newline = strchr(parser.position, '\n');
+                parser.position = newline != NULL ? newline + 1 : start + strlen(start);
+            }
+            arenaFree(&parser.arena);
+            error = 1;
+            lastStatus = 2;
+            continue;
+        }
+
+        if (list->first != NULL) {
+            isArenaKept = 0;
+            lastStatus = runNode(list);
+            // A single command has set the error flag itself, a compound one fails with its status
+            if ((list->first->next != NULL) || (list->first->type != NODE_COMMAND)) {
+                error = lastStatus != 0;
+            }
+            scriptControl = CONTROL_NONE;
+            if (!shellIsInteractive) {
+                // Only the last "successfully" executed command will be the "lastly executed command" of bello
+                if (error == 0) {
+                    char *end = parser.position;
+                    while ((end > start) && ((end[-1] == '\n') || (end[-1] == ' ') || (end[-1] == '\t'))) {end--;}
+                    free(lastCommandLine);
+                    lastCommandLine = strndup(start, end - start);
+                }
+                // Finished background jobs are removed from the table between the commands
+                reportJobs();
+            }
+        }
+        if (isArenaKept) {
+            parser.arena.head = NULL; // Its functions still use it
+        } else {
+            arenaFree(&parser.arena);
+        }
+    }
+}
+// Runs a node of a script, returns its exit status (which also becomes $?)
+int runNode(struct scriptNode *node) {
+    int status = 0;
+    switch (node->type) {
+    case NODE_COMMAND:
+        status = runSimpleCommand(node->text);
+        break;
+    case NODE_LIST:
+        for (struct scriptNode *child = node->first; child != NULL; child = child->next) {
+            status = runNode(child);
+            if (scriptControl != CONTROL_NONE) {break;}
+        }
+        break;
+    case NODE_AND:
+    case NODE_OR:
+        status = runCondition(node->first);
+        if ((scriptControl == CONTROL_NONE) && ((status == 0) == (node->type == NODE_AND))) {
+            status = runNode(node->second);
+        }
+        break;
+    case NODE_NOT:
+        status = !runCondition(node->first);
+        break;
+    case NODE_IF:
+        status = runCondition(node->first);
+        if (scriptControl != CONTROL_NONE) {break;}
+        if (status == 0) {
+            status = runNode(node->second);
+        } else {
+            status = node->third != NULL ? runNode(node->third) : 0;
+        }
+        break;
+    case NODE_WHILE:
+    case NODE_UNTIL:
+        loopDepth++;
+        while (1) {
+            if (isInterrupted()) {
+                status = lastStatus;
+                break;
+            }
+            int condition = runCondition(node->first);
+            if (endsLoop() || ((condition == 0) != (node->type == NODE_WHILE))) {break;}
+            status = runNode(node->second);
+            if (endsLoop()) {break;}
+        }
+        loopDepth--;
+        break;
+    case NODE_FOR:
+        status = runFor(node);
+        break;
+    case NODE_CASE:
+        status = runCase(node);
+        break;
+    case NODE_FUNCTION:
+        defineFunction(node->text, node->second);
+        isArenaKept = 1;
+        break;
+    }
+    lastStatus = status;
+    return status;
+}
+// Runs the condition of an if, a loop, && or || (or the command of a !), whose failure is not an error
+int runCondition(struct scriptNode *node) {
+    int wasCondition = isCondition;
+    isCondition = 1;
+    int status = runNode(node);
+    isCondition = wasCondition;
+    return status;
+}
+// Takes a break or continue which has reached a loop. Returns 1 if the loop must end (it is
+// left by the break, an outer loop is meant, or a return or Ctrl-C is on its way)
+int endsLoop() {
+    if (scriptControl == CONTROL_NONE) {
+        return 0;
+    }
+    if ((scriptControl == CONTROL_BREAK) || (scriptControl == CONTROL_CONTINUE)) {
+        if (--controlLevels > 0) {
+            return 1;
+        }
+        int isBreak = scriptControl == CONTROL_BREAK;
+        scriptControl = CONTROL_NONE;
+        return isBreak;
+    }
+    return 1;
+}
+// Returns 1 (and starts leaving everything) if Ctrl-C has been pressed while the shell itself was
+// running the commands. SIGINT is blocked in an interactive shell, so it waits inside the signalfd
+int isInterrupted() {
+    if (shellIsInteractive && !isInterruptPending) {
+        sigset_t pending;
+        sigpending(&pending);
+        if (sigismember(&pending, SIGINT)) {
+            processChildEvents();
+        }
+    }
+    if (isInterruptPending) {
+        isInterruptPending = 0;
+        scriptControl = CONTROL_INTERRUPT;
+        lastStatus = 128 + SIGINT;
+        printf("\n");
+        return 1;
+    }
+    return scriptControl == CONTROL_INTERRUPT;
+}
+// Runs a simple command: expands it, then sets the variables of a line of assignments only,
+// calls a function, or hands the line to parser()
+int runSimpleCommand(char *text) {
+    char *line = text;
+    if (strchr(text, '$') != NULL) {
+        line = expandText(text, 0);
+        if (line == NULL) {
+            error = 1;
+            return 1;
+        }
+    }
+
+    // Assignments (name=value ...) and function calls are only tokenized here when the first word looks like one
+    int status = -1;
+    size_t nameLength = scanName(line);
+    size_t wordLength = strcspn(line, " \t\n");
+    struct function *function = NULL;
+    if (((nameLength > 0) && (line[nameLength] == '=')) ||
+        ((numOfFunctions > 0) && ((function = findFunction(line, wordLength)) != NULL))) {
+        struct arena arena = {NULL};
+        struct tokenList list;
+        if (tokenize(line, &arena, &list) != 0) {
+            error = 1;
+            status = 1;
+        } else if (function == NULL) {
+            // Every word must be an assignment, otherwise it is an ordinary command
+            int a = 0;
+            for (; a < list.numOfTokens; a++) {
+                size_t length = scanName(list.tokens[a]);
+                if (list.isOperator[a] || (length == 0) || (list.tokens[a][length] != '=')) {break;}
+            }
+            if (a == list.numOfTokens) {
+                for (a = 0; a < list.numOfTokens; a++) {
+                    char *equals = strchr(list.tokens[a], '=');
+                    *equals = '\0';
+                    setVariable(list.tokens[a], equals + 1);
+                }
+                error = 0;
+                status = 0;
+            }
+        } else {
+            int a = 0;
+            for (; (a < list.numOfTokens) && !list.isOperator[a]; a++);
+            if (a < list.numOfTokens) {
+                fprintf(stderr, "Error: %s: a function cannot be redirected, piped or put into the background\n", list.tokens[0]);
+                error = 1;
+                status = 1;
+            } else {
+                error = 0;
+                status = callFunction(function, list.tokens + 1, list.numOfTokens - 1);
+            }
+        }
+        arenaFree(&arena);
+    }
+    if (status == -1) {
+        status = parser(line);
+        if ((error == 1) && (status == 0)) {
+            status = 1;
+        }
+    }
+    if (line != text) {
+        free(line);
+    }
+    // A command killed by Ctrl-C ends the loops (and the functions) it is inside
+    if (status == 128 + SIGINT) {
+        scriptControl = CONTROL_INTERRUPT;
+    }
+    return status;
+}
+// Runs a for loop, over its expanded (and globbed) words, or over the positional arguments
+int runFor(struct scriptNode *node) {
+    struct arena arena = {NULL};
+    struct tokenList list = {NULL, NULL, 0, 0};
+    char **values = positionalArguments;
+    int numOfValues = numOfPositionalArguments;
+    if (node->words != NULL) {
+        char *words = expandText(node->words, 0);
+        if ((words == NULL) || (tokenize(words, &arena, &list) != 0)) {
+            free(words);
+            arenaFree(&arena);
+            error = 1;
+            return 1;
+        }
+        free(words);
+        values = list.tokens;
+        numOfValues = list.numOfTokens;
+    }
+    int status = 0;
+    loopDepth++;
+    for (int i = 0; i < numOfValues; i++) {
+        if (isInterrupted()) {
+            status = lastStatus;
+            break;
+        }
+        setVariable(node->text, values[i]);
+        status = runNode(node->second);
+        if (endsLoop()) {break;}
+    }
+    loopDepth--;
+    arenaFree(&arena);
+    return status;
+}
+// Runs the list of the first item of a case whose pattern matches the word
+int runCase(struct scriptNode *node) {
+    struct arena arena = {NULL};
+    struct tokenList list;
+    char *word = expandText(node->text, 0);
+    if ((word == NULL) || (tokenize(word, &arena, &list) != 0)) {
+        free(word);
+        arenaFree(&arena);
+        error = 1;
+        return 1;
+    }
+    const char *value = list.numOfTokens > 0 ? list.tokens[0] : "";
+    int status = 0;
+    for (struct scriptNode *item = node->first; item != NULL; item = item->next) {
+        // The patterns are separated by unquoted |
+        int isMatched = 0;
+        char quote = '\0';
+        const char *pattern = item->text;
+        for (const char *c = item->text; !isMatched; c++) {
+            if ((*c == '\0') || ((*c == '|') && (quote == '\0'))) {
+                isMatched = matchCasePattern(pattern, c - pattern, value);
+                if (*c == '\0') {break;}
+                pattern = c + 1;
+            } else if ((quote != '\'') && (*c == '\\') && (c[1] != '\0')) {
+                c++;
+            } else if ((*c == '\'') || (*c == '"')) {
+                if (quote == '\0') {quote = *c;}
+                else if (quote == *c) {quote = '\0';}
+            }
+        }
+        if (isMatched) {
+            status = item->second != NULL ? runNode(item->second) : 0;
+            break;
+        }
+    }
+    free(word);
+    arenaFree(&arena);
+    return status;
+}
+// Returns 1 if value matches the pattern of a case (its first length bytes). The quotes of the
+// pattern are removed, the characters they have quoted are escaped for the glob matcher
+int matchCasePattern(const char *pattern, size_t length, const char *value) {
+    while ((length > 0) && ((*pattern == ' ') || (*pattern == '\t'))) {pattern++; length--;}
+    while ((length > 0) && ((pattern[length - 1] == ' ') || (pattern[length - 1] == '\t'))) {length--;}
+    char *text = strndup(pattern, length);
+    char *expanded = expandText(text, 0);
+    free(text);
+    if (expanded == NULL) {
+        return 0;
+    }
+    char *glob = malloc(2 * strlen(expanded) + 1), *g = glob;
+    for (const char *c = expanded; *c != '\0'; c++) {
+        if ((*c == '\'') || (*c == '"')) {
+            char quote = *c;
+            for (c++; (*c != '\0') && (*c != quote); c++) {
+                if ((quote == '"') && (*c == '\\') && (c[1] != '\0') && (strchr("\"\\$`", c[1]) != NULL)) {c++;}
+                if (strchr("*?[]\\", *c) != NULL) {*g++ = '\\';}
+                *g++ = *c;
+            }
+            if (*c == '\0') {break;}
+        } else if ((*c == '\\') && (c[1] != '\0')) {
+            *g++ = *c++;
+            *g++ = *c;
+        } else {
+            *g++ = *c;
+        }
+    }
+    *g = '\0';
+    struct globMatcher matcher;
+    compileGlob(glob, &matcher);
+    matcher.startsWithDot = 1; // A case pattern matches a leading dot like any other character
+    int isMatched = matchGlob(&matcher, value);
+    free(matcher.operations);
+    free(glob);
+    free(expanded);
+    return isMatched;
+}
+// Returns the value of a shell variable (or of an environment variable), NULL if it is not set
+char *findVariable(const char *name) {
+    for (struct variable *variable = variableTable[hashString(name) & (VARIABLE_HASH_SIZE - 1)]; variable != NULL; variable = variable->next) {
+        if (strcmp(variable->name, name) == 0) {
+            return variable->value;
+        }
+    }
+    return getenv(name);
+}
+// Sets a variable. A variable of the environment is changed there (so the commands see it too),
+// any other one becomes a shell variable
+void setVariable(const char *name, const char *value) {
+    unsigned long bucket = hashString(name) & (VARIABLE_HASH_SIZE - 1);
+    for (struct variable *variable = variableTable[bucket]; variable != NULL; variable = variable->next) {
+        if (strcmp(variable->name, name) == 0) {
+            free(variable->value);
+            variable->value = strdup(value);
+            return;
+        }
+    }
+    if (getenv(name) != NULL) {
+        setenv(name, value, 1);
+        isZygoteStale = 1; // The zygote's children would still get the old value
+        return;
+    }
+    struct variable *variable = malloc(sizeof(struct variable));
+    variable->name = strdup(name);
+    variable->value = strdup(value);
+    variable->next = variableTable[bucket];
+    variableTable[bucket] = variable;
+}
+// Returns the function whose name is the first length bytes of name, NULL if there is none
+struct function *findFunction(const char *name, size_t length) {
+    char key[length + 1];
+    memcpy(key, name, length);
+    key[length] = '\0';
+    for (struct function *function = functionTable[hashString(key) & (FUNCTION_HASH_SIZE - 1)]; function != NULL; function = function->next) {
+        if (strcmp(function->name, key) == 0) {
+            return function;
+        }
+    }
+    return NULL;
+}
+// Defines a function, or replaces the body of an existing one
+void defineFunction(const char *name, struct scriptNode *body) {
+    struct function *function = findFunction(name, strlen(name));
+    if (function == NULL) {
+        unsigned long bucket = hashString(name) & (FUNCTION_HASH_SIZE - 1);
+        function = malloc(sizeof(struct function));
+        function->name = strdup(name);
+        function->next = functionTable[bucket];
+        functionTable[bucket] = function;
+        numOfFunctions++;
+    }
+    function->body = body;
+}
+// Calls a function with the given positional arguments, returns the status of its body (or of its return)
+int callFunction(struct function *function, char **arguments, int numOfArguments) {
+    if (functionDepth >= MAX_FUNCTION_DEPTH) {
+        fprintf(stderr, "Error: %s: functions are nested too deeply\n", function->name);
+        error = 1;
+        return 1;
+    }
+    char **savedArguments = positionalArguments;
+    int savedNumOfArguments = numOfPositionalArguments;
+    int savedLoopDepth = loopDepth;
+    positionalArguments = arguments;
+    numOfPositionalArguments = numOfArguments;
+    loopDepth = 0; // A break inside the function cannot leave the loops of its caller
+    functionDepth++;
+    int status = runNode(function->body);
+    functionDepth--;
+    loopDepth = savedLoopDepth;
+    positionalArguments = savedArguments;
+    numOfPositionalArguments = savedNumOfArguments;
+    if (scriptControl == CONTROL_RETURN) {
+        scriptControl = CONTROL_NONE;
+    }
+    return status;
+}
+// Appends length bytes of text to the buffer, with the escapes of one of the ESCAPE_ modes
+void appendText(struct textBuffer *buffer, const char *text, size_t length, int escape) {
+    if (buffer->capacity < buffer->length + 2 * length + 1) {
+        buffer->capacity = 2 * (buffer->length + 2 * length + 1);
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (((escape == ESCAPE_WORD) && (strchr("\\'\"|&<>*?[]$`", text[i]) != NULL)) ||
+            ((escape == ESCAPE_DOUBLE_QUOTES) && (strchr("\"\\$`", text[i]) != NULL))) {
+            buffer->data[buffer->length++] = '\\';
+        }
+        buffer->data[buffer->length++] = text[i];
+    }
+    buffer->data[buffer->length] = '\0';
+}
+// Appends the value of a parameter ($name, $1, $#, $?, $$, $0, $@ or $*)
+void appendParameter(struct textBuffer *buffer, const char *name, size_t length, int escape) {
+    char number[32];
+    const char *value = NULL;
+    if ((length == 1) && ((*name == '@') || (*name == '*'))) {
+        // Every argument, inside double quotes "$@" gives a word for each of them
+        for (int i = 0; i < numOfPositionalArguments; i++) {
+            if (i > 0) {
+                appendText(buffer, escape == ESCAPE_DOUBLE_QUOTES && (*name == '@') ? "\" \"" : " ", escape == ESCAPE_DOUBLE_QUOTES && (*name == '@') ? 3 : 1, ESCAPE_NONE);
+            }
+            appendText(buffer, positionalArguments[i], strlen(positionalArguments[i]), escape);
+        }
+        return;
+    }
+    if ((length == 1) && (*name == '#')) {
+        snprintf(number, sizeof(number), "%d", numOfPositionalArguments);
+        value = number;
+    } else if ((length == 1) && (*name == '?')) {
+        snprintf(number, sizeof(number), "%d", lastStatus);
+        value = number;
+    } else if ((length == 1) && (*name == '$')) {
+        snprintf(number, sizeof(number), "%d", (int) getpid());
+        value = number;
+    } else if ((*name >= '0') && (*name <= '9')) {
+        int index = atoi(name);
+        if (index == 0) {value = shellName;}
+        else if (index <= numOfPositionalArguments) {value = positionalArguments[index - 1];}
+    } else {
+        char key[length + 1];
+        memcpy(key, name, length);
+        key[length] = '\0';
+        value = findVariable(key);
+    }
+    if (value != NULL) {
+        appendText(buffer, value, strlen(value), escape);
+    }
+}
+// Expands the parameters ($name, ${name}, $1, $#, $@, ...) and the arithmetic ($((...))) of a
+// command line. Nothing is expanded inside single quotes. The values are escaped, so the
+// tokenizer takes them literally (only split at their blanks outside double quotes), unless
+// isRaw is set. Returns a new string, NULL (with the error printed) if an arithmetic has failed
+char *expandText(const char *text, int isRaw) {
+    struct textBuffer buffer = {NULL, 0, 0};
+    appendText(&buffer, "", 0, ESCAPE_NONE);
+    char quote = '\0'; // The quote we are inside, if any
+    const char *c = text;
+    while (*c != '\0') {
+        const char *plain = c; // The text up to the next $ is copied as it is
+        for (; (*c != '\0') && ((*c != '$') || (quote == '\'')); c++) {
+            if ((quote != '\'') && (*c == '\\') && (c[1] != '\0')) {c++;}
+            else if ((*c == '\'') && (quote != '"')) {quote = quote == '\'' ? '\0' : '\'';}
+            else if ((*c == '"') && (quote != '\'')) {quote = quote == '"' ? '\0' : '"';}
+        }
+        appendText(&buffer, plain, c - plain, ESCAPE_NONE);
+        if (*c == '\0') {
+            break;
+        }
+        int escape = isRaw ? ESCAPE_NONE : (quote == '"' ? ESCAPE_DOUBLE_QUOTES : ESCAPE_WORD);
+        c++;
+        if ((c[0] == '(') && (c[1] == '(')) {
+            // $((arithmetic)), its own $ are expanded first
+            const char *end = c + 2;
+            for (int depth = 0; (*end != '\0') && ((depth > 0) || (end[0] != ')') || (end[1] != ')')); end++) {
+                if (*end == '(') {depth++;}
+                else if (*end == ')') {depth--;}
+            }
+            if (*end != '\0') {
+                char *inner = strndup(c + 2, end - c - 2);
+                char *expression = expandText(inner, 1);
+                free(inner);
+                int hasFailed = 0;
+                long value = expression != NULL ? evaluateArithmetic(expression, &hasFailed) : 0;
+                free(expression);
+                if ((expression == NULL) || hasFailed) {
+                    free(buffer.data);
+                    return NULL;
+                }
+                char number[32];
+                appendText(&buffer, number, snprintf(number, sizeof(number), "%ld", value), ESCAPE_NONE);
+                c = end + 2;
+                continue;
+            }
+        }
+        if (*c == '{') {
+            const char *end = strchr(c, '}');
+            if (end != NULL) {
+                appendParameter(&buffer, c + 1, end - c - 1, escape);
+                c = end + 1;
+                continue;
+            }
+        }
+        size_t length = scanName(c);
+        if ((length == 0) && (*c != '\0') && (strchr("0123456789#?$@*", *c) != NULL)) {
+            length = 1;
+        }
+        if (length == 0) {
+            appendText(&buffer, "$", 1, ESCAPE_NONE); // A lone $ is kept
+            continue;
+        }
+        appendParameter(&buffer, c, length, escape);
+        c += length;
+    }
+    return buffer.data;
+}
+// Evaluates an integer expression of $((...)): || && == != < <= > >= + - * / %, the unary - + !,
+// parentheses, numbers and variable names. Prints the error (and sets hasFailed) on failure
+long evaluateArithmetic(const char *expression, int *hasFailed) {
+    struct arithmetic arithmetic = {expression, 0};
+    while ((*arithmetic.position == ' ') || (*arithmetic.position == '\t')) {arithmetic.position++;}
+    if (*arithmetic.position == '\0') {
+        return 0;
+    }
+    long value = parseArithmetic(&arithmetic, 1);
+    while ((*arithmetic.position == ' ') || (*arithmetic.position == '\t')) {arithmetic.position++;}
+    if ((arithmetic.hasFailed == 0) && (*arithmetic.position != '\0')) {
+        arithmetic.hasFailed = 1;
+    }
+    if (arithmetic.hasFailed == 1) {
+        fprintf(stderr, "Error: syntax error in arithmetic expression '%s'\n", expression);
+    } else if (arithmetic.hasFailed == 2) {
+        fprintf(stderr, "Error: division by zero in '%s'\n", expression);
+    }
+    *hasFailed = arithmetic.hasFailed;
+    return value;
+}
+// Parses (and evaluates) the binary operators of at least the given precedence, by precedence climbing
+long parseArithmetic(struct arithmetic *arithmetic, int minimumPrecedence) {
+    long left = parseArithmeticOperand(arithmetic);
+    while (arithmetic->hasFailed == 0) {
+        while ((*arithmetic->position == ' ') || (*arithmetic->position == '\t')) {arithmetic->position++;}
+        struct arithmeticOperator *operator = arithmeticOperators;
+        for (; operator->text != NULL; operator++) {
+            if (strncmp(arithmetic->position, operator->text, strlen(operator->text)) == 0) {break;}
+        }
+        if ((operator->text == NULL) || (operator->precedence < minimumPrecedence)) {
+            break;
+        }
+        arithmetic->position += strlen(operator->text);
+        long right = parseArithmetic(arithmetic, operator->precedence + 1);
+        switch (operator->text[0]) {
+        case '|': left = left || right; break;
+        case '&': left = left && right; break;
+        case '=': left = left == right; break;
+        case '!': left = left != right; break;
+        case '<': left = operator->text[1] == '=' ? left <= right : left < right; break;
+        case '>': left = operator->text[1] == '=' ? left >= right : left > right; break;
+        // + - * wrap around on overflow (they are done in unsigned arithmetic, where it is defined)
+        case '+': left = (long) ((unsigned long) left + (unsigned long) right); break;
+        case '-': left = (long) ((unsigned long) left - (unsigned long) right); break;
+        case '*': left = (long) ((unsigned long) left * (unsigned long) right); break;
+        default:
+            if (right == 0) {
+                arithmetic->hasFailed = 2;
+                return 0;
+            }
+            // Dividing by -1 is a negation, which would trap for LONG_MIN / -1 (and LONG_MIN % -1)
+            if (right == -1) {
+                left = operator->text[0] == '/' ? (long) (0UL - (unsigned long) left) : 0;
+            } else {
+                left = operator->text[0] == '/' ? left / right : left % right;
+            }
+        }
+    }
+    return left;
+}
+// Parses (and evaluates) a number, a variable, a parenthesized expression or a unary operator
+long parseArithmeticOperand(struct arithmetic *arithmetic) {
+    while ((*arithmetic->position == ' ') || (*arithmetic->position == '\t')) {arithmetic->position++;}
+    const char *c = arithmetic->position;
+    if (*c == '(') {
+        arithmetic->position++;
+        long value = parseArithmetic(arithmetic, 1);
+        while ((*arithmetic->position == ' ') || (*arithmetic->position == '\t')) {arithmetic->position++;}
+        if (*arithmetic->position != ')') {
+            arithmetic->hasFailed = 1;
+            return 0;
+        }
+        arithmetic->position++;
+        return value;
+    }
+    if ((*c == '-') || (*c == '+') || (*c == '!')) {
+        arithmetic->position++;
+        long value = parseArithmeticOperand(arithmetic);
+        return *c == '-' ? (long) (0UL - (unsigned long) value) : (*c == '!' ? !value : value); // -LONG_MIN wraps around
+    }
+    if ((*c >= '0') && (*c <= '9')) {
+        char *end;
+        long value = strtol(c, &end, 0);
+        arithmetic->position = end;
+        return value;
+    }
+    size_t length = scanName(c);
+    if (length == 0) {
+        arithmetic->hasFailed = 1;
+        return 0;
+    }
+    char name[length + 1];
+    memcpy(name, c, length);
+    name[length] = '\0';
+    arithmetic->position += length;
+    const char *value = findVariable(name);
+    return value != NULL ? strtol(value, NULL, 0) : 0;
+}
+
+/** Scripting: builtins **/
+// The test (and [) builtin, with the usual rules: -o binds looser than -a, ! negates, ( ) groups,
+// the file tests -e -f -d -b -c -p -S -r -w -x -s -L -h -g -u -k -O -G, -t (a descriptor is a
+// terminal), the string tests -z -n = == !=, the file comparisons -nt -ot -ef, and the integer
+// comparisons -eq -ne -lt -le -gt -ge. Returns 0 if the expression is true, 1 if it is false,
+// 2 on an error
+int testBuiltin(char **tokens, int numOfTokens) {
+    int numOfArguments = numOfTokens - 1;
+    if (strcmp(tokens[0], "[") == 0) {
+        if ((numOfArguments == 0) || (strcmp(tokens[numOfTokens - 1], "]") != 0)) {
+            fprintf(stderr, "[: missing ']'\n");
+            return 2;
+        }
+        numOfArguments--;
+    }
+    struct testParser test = {tokens + 1, numOfArguments, 0, 0};
+    if (numOfArguments == 0) {
+        return 1;
+    }
+    int result = testOr(&test);
+    if (!test.hasFailed && (test.position < numOfArguments)) {
+        fprintf(stderr, "%s: unexpected '%s'\n", tokens[0], test.arguments[test.position]);
+        test.hasFailed = 1;
+    }
+    return test.hasFailed ? 2 : !result;
+}
+// expression -o expression, returns 1 if true
+int testOr(struct testParser *test) {
+    int result = testAnd(test);
+    while (!test->hasFailed && (test->position < test->numOfArguments) && (strcmp(test->arguments[test->position], "-o") == 0)) {
+        test->position++;
+        result = testAnd(test) || result;
+    }
+    return result;
+}
+// expression -a expression, returns 1 if true
+int testAnd(struct testParser *test) {
+    int result = testPrimary(test);
+    while (!test->hasFailed && (test->position < test->numOfArguments) && (strcmp(test->arguments[test->position], "-a") == 0)) {
+        test->position++;
+        result = testPrimary(test) && result;
+    }
+    return result;
+}
+// A binary comparison, ! expression, ( expression ), a unary test, or a string (true if it is not
+// empty). A binary operator is looked for first, so [ "$a" = -n ] compares two strings
+int testPrimary(struct testParser *test) {
+    char **arguments = test->arguments + test->position;
+    int numLeft = test->numOfArguments - test->position;
+    if (numLeft <= 0) {
+        fprintf(stderr, "test: argument expected\n");
+        test->hasFailed = 1;
+        return 0;
+    }
+    if ((numLeft >= 3) && isTestBinary(arguments[1])) {
+        test->position += 3;
+        return testBinary(test, arguments[0], arguments[1], arguments[2]);
+    }
+    if ((strcmp(arguments[0], "!") == 0) && (numLeft >= 2)) {
+        test->position++;
+        return !testPrimary(test);
+    }
+    if ((strcmp(arguments[0], "(") == 0) && (numLeft >= 2)) {
+        test->position++;
+        int result = testOr(test);
+        if (!test->hasFailed && ((test->position >= test->numOfArguments) || (strcmp(test->arguments[test->position], ")") != 0))) {
+            fprintf(stderr, "test: missing ')'\n");
+            test->hasFailed = 1;
+        }
+        test->position++;
+        return result;
+    }
+    if ((numLeft >= 2) && (arguments[0][0] == '-') && (arguments[0][1] != '\0') && (arguments[0][2] == '\0') &&
+        (strchr("znefdbcpSrwxsLhtgukOG", arguments[0][1]) != NULL)) {
+        test->position += 2;
+        return testUnary(arguments[0], arguments[1]);
+    }
+    test->position++;
+    return arguments[0][0] != '\0';
+}
+// Evaluates a unary test, returns 1 if true
+int testUnary(const char *operator, const char *operand) {
+    struct stat fileInfo;
+    switch (operator[1]) {
+    case 'z': return operand[0] == '\0';
+    case 'n': return operand[0] != '\0';
+    case 'r': return access(operand, R_OK) == 0;
+    case 'w': return access(operand, W_OK) == 0;
+    case 'x': return access(operand, X_OK) == 0;
+    case 'L':
+    case 'h': return (lstat(operand, &fileInfo) == 0) && S_ISLNK(fileInfo.st_mode);
+    case 't': {
+        long fd;
+        return (parseNumber(operand, &fd) == 0) && (fd >= 0) && (fd == (int) fd) && isatty((int) fd);
+    }
+    }
+    if (stat(operand, &fileInfo) != 0) {
+        return 0;
+    }
+    switch (operator[1]) {
+    case 'f': return S_ISREG(fileInfo.st_mode);
+    case 'd': return S_ISDIR(fileInfo.st_mode);
+    case 'b': return S_ISBLK(fileInfo.st_mode);
+    case 'c': return S_ISCHR(fileInfo.st_mode);
+    case 'p': return S_ISFIFO(fileInfo.st_mode);
+    case 'S': return S_ISSOCK(fileInfo.st_mode);
+    case 's': return fileInfo.st_size > 0;
+    case 'g': return (fileInfo.st_mode & S_ISGID) != 0;
+    case 'u': return (fileInfo.st_mode & S_ISUID) != 0;
+    case 'k': return (fileInfo.st_mode & S_ISVTX) != 0;
+    case 'O': return fileInfo.st_uid == geteuid();
+    case 'G': return fileInfo.st_gid == getegid();
+    }
+    return 1; // -e
+}
+// Returns 1 if the operator is a binary operator of test
+int isTestBinary(const char *operator) {
+    static const char *operators[] = {"=", "==", "!=", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef", NULL};
+    for (int i = 0; operators[i] != NULL; i++) {
+        if (strcmp(operator, operators[i]) == 0) {return 1;}
+    }
+    return 0;
+}
+// Evaluates a binary test, returns 1 if true
+int testBinary(struct testParser *test, const char *left, const char *operator, const char *right) {
+    if (operator[0] != '-') {
+        int isEqual = strcmp(left, right) == 0;
+        return operator[0] == '!' ? !isEqual : isEqual;
+    }
+    // File comparisons: a file which exists is newer than one which does not
+    if ((strcmp(operator, "-nt") == 0) || (strcmp(operator, "-ot") == 0) || (strcmp(operator, "-ef") == 0)) {
+        struct stat leftInfo, rightInfo;
+        int hasLeft = stat(left, &leftInfo) == 0;
+        int hasRight = stat(right, &rightInfo) == 0;
+        if (operator[1] == 'e') {
+            return hasLeft && hasRight && (leftInfo.st_dev == rightInfo.st_dev) && (leftInfo.st_ino == rightInfo.st_ino);
+        }
+        if (!hasLeft || !hasRight) {
+            return operator[1] == 'n' ? hasLeft : hasRight;
+        }
+        int order = (leftInfo.st_mtim.tv_sec > rightInfo.st_mtim.tv_sec) - (leftInfo.st_mtim.tv_sec < rightInfo.st_mtim.tv_sec);
+        if (order == 0) {
+            order = (leftInfo.st_mtim.tv_nsec > rightInfo.st_mtim.tv_nsec) - (leftInfo.st_mtim.tv_nsec < rightInfo.st_mtim.tv_nsec);
+        }
+        return operator[1] == 'n' ? order > 0 : order < 0;
+    }
+    char *leftEnd, *rightEnd;
+    long leftValue = strtol(left, &leftEnd, 10);
+    long rightValue = strtol(right, &rightEnd, 10);
+    if ((*left == '\0') || (*leftEnd != '\0') || (*right == '\0') || (*rightEnd != '\0')) {
+        fprintf(stderr, "test: integer expression expected\n");
+        test->hasFailed = 1;
+        return 0;
+    }
+    if (strcmp(operator, "-eq") == 0) {return leftValue == rightValue;}
+    if (strcmp(operator, "-ne") == 0) {return leftValue != rightValue;}
+    if (strcmp(operator, "-lt") == 0) {return leftValue < rightValue;}
+    if (strcmp(operator, "-le") == 0) {return leftValue <= rightValue;}
+    if (strcmp(operator, "-gt") == 0) {return leftValue > rightValue;}
+    return leftValue >= rightValue;
+}
+// The true (and :) builtin, does nothing successfully
+int trueBuiltin(char **tokens, int numOfTokens) {
+    return 0;
+}
+// The false builtin, does nothing unsuccessfully
+int falseBuiltin(char **tokens, int numOfTokens) {
+    return 1;
+}
+// The break and continue builtins, which leave (or go on with) the innermost n loops
+int loopControlBuiltin(char **tokens, int numOfTokens) {
+    int levels = numOfTokens > 1 ? atoi(tokens[1]) : 1;
+    if (levels < 1) {
+        fprintf(stderr, "%s: %s: loop count out of range\n", tokens[0], tokens[1]);
+        return 1;
+    }
+    if (loopDepth == 0) {
+        fprintf(stderr, "%s: only meaningful in a loop\n", tokens[0]);
+        return 1;
+    }
+    scriptControl = tokens[0][0] == 'b' ? CONTROL_BREAK : CONTROL_CONTINUE;
+    controlLevels = levels < loopDepth ? levels : loopDepth;
+    return 0;
+}
+// The return builtin, which leaves the function with the given status (or the one of the last command)
+int returnBuiltin(char **tokens, int numOfTokens) {
+    if (functionDepth == 0) {
+        fprintf(stderr, "return: can only be used inside a function\n");
+        return 1;
+    }
+    scriptControl = CONTROL_RETURN;
+    return numOfTokens > 1 ? atoi(tokens[1]) : lastStatus;
+}
+// Runs a line (or the lines of a construct, joined by newlines) read from the terminal or stdin,
+// and records its result. Returns PARSE_INCOMPLETE (without running anything) if a construct or a
+// quote is still open, unless isEndOfInput says no more lines will come
+int runLine(char *line, int isEndOfInput) {
+    if (!isEndOfInput && (checkScript(line) == PARSE_INCOMPLETE)) {
+        return PARSE_INCOMPLETE;
+    }
+
+    // Every typed line goes into the history, before it runs (so other shells see it meanwhile).
+    // The lines of a construct become one entry, joined by "; " (or by a space after a |)
+    long entry = -1;
+    if (shellIsInteractive && (line[strspn(line, " \t\n")] != '\0')) {
+        char *historyLine = malloc(2 * strlen(line) + 1), *h = historyLine;
+        for (const char *c = line; *c != '\0'; c++) {
+            if (*c != '\n') {
+                *h++ = *c;
+                continue;
+            }
+            char *last = h;
+            while ((last > historyLine) && ((last[-1] == ' ') || (last[-1] == '\t'))) {last--;}
+            if ((last > historyLine) && (last[-1] == '\\')) {
+                h = last - 1; // A backslash-newline pair joins the lines as they are
+            } else if ((last > historyLine) && (last[-1] != '|')) {
+                h = last;
+                *h++ = ';';
+                *h++ = ' ';
+            } else if (last > historyLine) {
+                *h++ = ' ';
+            }
+        }
+        *h = '\0';
+        entry = addHistory(historyLine);
+        free(historyLine);
+    }
+
+    // Parsing the line into its constructs and running them, the simple commands at their
+    // leaves go into our key function, parser()
+    runScriptText(line);
+
+    // Only the last "successfully" executed command will be
+    // the "lastly executed command" of bello. This part
+    // of the code handles the input error cases
+    if ((error == 0) && (entry != -1)) {
+        lastCommandEntry = entry;
+    }
+    if ((error == 1) && shellIsInteractive) {
+        printf("!Error occured!\n");
+    }
+    return PARSE_OK;
+}
+// Runs a line typed at the prompt (or read from stdin). A line which leaves a construct (or a
+// quote) open is kept, and the next lines are added to it until the command is complete
+void runTypedLine(const char *line) {
+    char *text;
+    if (pendingLines != NULL) {
+        if (asprintf(&text, "%s\n%s", pendingLines, line) == -1) {
+            text = NULL;
+        }
+        free(pendingLines);
+        pendingLines = NULL;
+    } else {
+        text = strdup(line);
+    }
+    if (text == NULL) {
+        perror("Error reading the line");
+        return;
+    }
+    if (runLine(text, 0) == PARSE_INCOMPLETE) {
+        pendingLines = text;
+        return;
+    }
+    free(text);
+}
+// Reads everything from a descriptor into one buffer (with an extra byte for a terminating
+// newline), with as few read calls as possible. Returns NULL on error
+char *readWholeFile(int fd, size_t *length) {
+    // Regular files are read with a single call, pipes and the like grow the buffer as needed
+    struct stat fileInfo;
+    size_t capacity = 65536;
+    if ((fstat(fd, &fileInfo) == 0) && S_ISREG(fileInfo.st_mode) && (fileInfo.st_size > 0)) {
+        capacity = fileInfo.st_size + 1;
+    }
+    char *buffer = malloc(capacity + 1);
+    *length = 0;
+    while (buffer != NULL) {
+        ssize_t bytesRead = read(fd, buffer + *length, capacity - *length);
+        if (bytesRead == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead == -1) {
+            free(buffer);
+            return NULL;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        *length += bytesRead;
+        if (*length == capacity) {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity + 1);
+        }
+    }
+    return buffer;
+}
+// Runs the commands of a buffer (a script or the string of -c), which is parsed in place, one
+// top-level command at a time. Returns the exit status of the last command
+int runBuffer(char *buffer, size_t length) {
+    buffer[length] = '\0';
+    runScriptText(buffer);
+    return lastStatus;
+}
+// Runs a script file, returns the exit status of its last command (127 if it cannot be read)
+int runScript(const char *scriptName) {
+    int fd = open(scriptName, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        fprintf(stderr, "myshell: %s: %s\n", scriptName, strerror(errno));
+        return 127;
+    }
+    size_t length;
+    char *script = readWholeFile(fd, &length);
+    close(fd);
+    if (script == NULL) {
+        fprintf(stderr, "myshell: %s: %s\n", scriptName, strerror(errno));
+        return 127;
+    }
+    int status = runBuffer(script, length);
+    free(script);
+    return status;
+}
+// The server of --serve: listens on the socket and forks a worker for every connection, keeping
+// at most MYSHELL_SERVE_WORKERS of them at once. Returns only on error
+int serveCommands(const char *socketPath) {
+    // The zygote's socket cannot be shared by workers running at the same time, they use posix_spawn
+    unsetenv("MYSHELL_ZYGOTE");
+    initShell(0);
+
+    long maxWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    char *workers = getenv("MYSHELL_SERVE_WORKERS");
+    if ((workers != NULL) && (atoi(workers) > 0)) {
+        maxWorkers = atoi(workers);
+    }
+    if (maxWorkers < 1) {
+        maxWorkers = 1;
+    }
+    int listenFd = listenOnSocket(socketPath);
+    if (listenFd == -1) {
+        return 1;
+    }
+    warmServerCaches();
+    printf("Serving on %s with %ld workers\n", socketPath, maxWorkers);
+    fflush(stdout);
+
+    long numOfWorkers = 0;
+    while (1) {
+        // Reaping the workers which have finished, waiting for one while all of them are busy
+        pid_t pid;
+        while ((pid = waitpid(-1, NULL, numOfWorkers >= maxWorkers ? 0 : WNOHANG)) > 0) {
+            numOfWorkers--;
+        }
+        int clientFd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+        if (clientFd == -1) {
+            if ((errno != EINTR) && (errno != ECONNABORTED)) {
+                perror("accept Failed");
+            }
+            continue;
+        }
+        warmServerCaches();
+        pid_t worker = fork();
+        if (worker == 0) {
+            close(listenFd);
+            runServeWorker(clientFd);
+        }
+        if (worker < 0) {
+            perror("fork Failed");
+        } else {
+            numOfForks++;
+            numOfWorkers++;
+        }
+        close(clientFd);
+    }
+}
+// Creates the listening socket of the server, with mode 0600. A socket file left behind by a server
+// which has gone (nobody accepts on it) is replaced, a live one is not. Returns the descriptor, -1 on error
+int listenOnSocket(const char *socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: the socket path %s is too long\n", socketPath);
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd == -1) {
+        perror("Error creating the socket");
+        return -1;
+    }
+    // The socket file gets its mode from the umask, 0177 leaves 0600 while we bind
+    mode_t previousMask = umask(0177);
+    int result = bind(listenFd, (struct sockaddr *) &address, sizeof(address));
+    if ((result == -1) && (errno == EADDRINUSE)) {
+        int probeFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if ((probeFd != -1) && (connect(probeFd, (struct sockaddr *) &address, sizeof(address)) == -1) && (errno == ECONNREFUSED)) {
+            unlink(socketPath);
+            result = bind(listenFd, (struct sockaddr *) &address, sizeof(address));
+        } else {
+            errno = EADDRINUSE;
+        }
+        if (probeFd != -1) {close(probeFd);}
+    }
+    umask(previousMask);
+    if ((result == -1) || (listen(listenFd, SOMAXCONN) == -1)) {
+        fprintf(stderr, "Error listening on %s: %s\n", socketPath, strerror(errno));
+        close(listenFd);
+        return -1;
+    }
+    return listenFd;
+}
+// Brings the alias table up to date and fills the PATH hash with every command of the PATH (again
+// only if it has been emptied since), so that the workers forked afterwards start warm
+void warmServerCaches() {
+    syncAliases();
+    validatePathHash();
+    if (servedPathGeneration == pathGeneration) {
+        return;
+    }
+    refreshCommandTrie();
+    for (int i = 0; i < numOfPathDirectories; i++) {
+        for (int j = 0; j < pathDirectories[i].numOfNames; j++) {
+            lookupCommand(pathDirectories[i].names[j]);
+        }
+    }
+    servedPathGeneration = pathGeneration;
+}
+// A worker of the server: serves one connection, then exits. Its stdin is /dev/null, its stdout
+// and stderr are pipes read by a thread, which sends their data to the client as frames. After
+// every command the worker sends its status through a third pipe, and the thread forwards what
+// is left inside the output pipes before the status, so a command's output always precedes it
+void runServeWorker(int clientFd) {
+    // Our own epoll instance, the server's one is shared with every worker it has forked
+    close(childEpollFd);
+    childEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {EPOLLIN, {.fd = signalFd}};
+    if ((childEpollFd == -1) || (epoll_ctl(childEpollFd, EPOLL_CTL_ADD, signalFd, &event) == -1)) {
+        perror("Error setting up the event loop");
+        _exit(1);
+    }
+
+    int nullFd = open("/dev/null", O_RDONLY);
+    int outputPipe[2], errorPipe[2], controlPipe[2];
+    if ((nullFd == -1) || (pipe2(outputPipe, O_CLOEXEC) == -1) || (pipe2(errorPipe, O_CLOEXEC) == -1) ||
+        (pipe2(controlPipe, O_CLOEXEC) == -1)) {
+        perror("Error setting up the worker");
+        _exit(1);
+    }
+    dup2(nullFd, STDIN_FILENO);
+    dup2(outputPipe[1], STDOUT_FILENO);
+    dup2(errorPipe[1], STDERR_FILENO);
+    close(nullFd);
+    close(outputPipe[1]);
+    close(errorPipe[1]);
+    fcntl(outputPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(errorPipe[0], F_SETFL, O_NONBLOCK);
+
+    static struct serveOutput output;
+    output.clientFd = clientFd;
+    output.outputFd = outputPipe[0];
+    output.errorFd = errorPipe[0];
+    output.controlFd = controlPipe[0];
+    output.isClientGone = 0;
+    serveControlFd = controlPipe[1];
+    serveWorkerPid = getpid();
+    if (pthread_create(&serveOutputThread, NULL, forwardServeOutput, &output) != 0) {
+        _exit(1);
+    }
+    atexit(finishServeWorker); // exit inside a batch still gets its output and status out
+
+    char type;
+    char *batch;
+    uint32_t length;
+    while ((readFrame(clientFd, &type, &batch, &length) == 0) && (type == FRAME_BATCH)) {
+        for (char *command = batch; command < batch + length; command += strlen(command) + 1) {
+            isServedCommandRunning = 1;
+            runScriptText(command);
+            isServedCommandRunning = 0;
+            sendServeControl(FRAME_STATUS, lastStatus);
+        }
+        sendServeControl(FRAME_DONE, 0);
+        free(batch);
+    }
+    exit(0);
+}
+// Called at the exit of a worker (also by exit inside a batch): the status of the running
+// command and the end of its batch are sent, then the thread is waited for until it has
+// forwarded everything. The children of the worker, which also run it when they exit, do nothing
+void finishServeWorker() {
+    if (getpid() != serveWorkerPid) {
+        return;
+    }
+    if (isServedCommandRunning) {
+        isServedCommandRunning = 0;
+        sendServeControl(FRAME_STATUS, lastStatus);
+        sendServeControl(FRAME_DONE, 0);
+    }
+    close(serveControlFd); // The thread stops once it reads the end of the control pipe
+    pthread_join(serveOutputThread, NULL);
+}
+// Sends a status (or the end of a batch) to the thread of the worker, after flushing our stdout
+// and stderr into their pipes
+void sendServeControl(char type, int status) {
+    fflush(stdout);
+    fflush(stderr);
+    struct serveControl control = {type, status};
+    if (writeAll(serveControlFd, (const char *) &control, sizeof(control)) == -1) {
+        perror("Error writing the control pipe");
+    }
+}
+// The thread of a worker: forwards the data of the stdout and stderr pipes to the client as it
+// comes, and a status or the end of a batch (once the output written before it has been
+// forwarded) when the worker sends it. Ends when the worker closes the control pipe
+void *forwardServeOutput(void *argument) {
+    struct serveOutput *output = argument;
+    struct pollfd fds[3] = {{output->outputFd, POLLIN, 0}, {output->errorFd, POLLIN, 0}, {output->controlFd, POLLIN, 0}};
+    while (1) {
+        if (poll(fds, 3, -1) == -1) {
+            if (errno == EINTR) {continue;}
+            break;
+        }
+        if ((fds[0].revents != 0) && (drainServeOutput(output, output->outputFd, FRAME_STDOUT) == 0)) {
+            fds[0].fd = -1; // Nobody writes it anymore
+        }
+        if ((fds[1].revents != 0) && (drainServeOutput(output, output->errorFd, FRAME_STDERR) == 0)) {
+            fds[1].fd = -1;
+        }
+        if (fds[2].revents != 0) {
+            struct serveControl control;
+            if (readExactly(output->controlFd, &control, sizeof(control)) == -1) {
+                break;
+            }
+            // Everything the command has written is inside the pipes by now
+            drainServeOutput(output, output->outputFd, FRAME_STDOUT);
+            drainServeOutput(output, output->errorFd, FRAME_STDERR);
+            uint32_t status = htonl(control.status);
+            writeFrame(output, control.type, &status, control.type == FRAME_STATUS ? sizeof(status) : 0);
+        }
+    }
+    return NULL;
+}
+// Forwards what a non-blocking output pipe holds as frames of the given type. Returns 0 once the
+// pipe has no writer left, 1 otherwise
+int drainServeOutput(struct serveOutput *output, int fd, char type) {
+    char buffer[SERVE_BUFFER_SIZE];
+    while (1) {
+        ssize_t bytesRead = read(fd, buffer, sizeof(buffer));
+        if ((bytesRead == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (bytesRead == 0) {
+            return 0;
+        }
+        if (bytesRead == -1) {
+            return 1;
+        }
+        writeFrame(output, type, buffer, bytesRead);
+    }
+}
+// Reads a frame. The payload is allocated (with a terminating NUL byte after it) and must be
+// freed. Returns 0 on success, -1 at the end of the connection or on error
+int readFrame(int fd, char *type, char **payload, uint32_t *length) {
+    unsigned char header[FRAME_HEADER_SIZE];
+    if (readExactly(fd, header, FRAME_HEADER_SIZE) == -1) {
+        return -1;
+    }
+    uint32_t networkLength;
+    memcpy(&networkLength, header + 1, sizeof(networkLength));
+    *type = header[0];
+    *length = ntohl(networkLength);
+    if (*length > MAX_BATCH_SIZE) {
+        return -1;
+    }
+    *payload = malloc(*length + 1);
+    if ((*payload == NULL) || (readExactly(fd, *payload, *length) == -1)) {
+        free(*payload);
+        return -1;
+    }
+    (*payload)[*length] = '\0';
+    return 0;
+}
+// Sends a frame to the client of a worker. A client which has gone is noticed (EPIPE, without a
+// SIGPIPE) and nothing is sent to it afterwards. Returns 0 on success, -1 on error
+int writeFrame(struct serveOutput *output, char type, const void *payload, uint32_t length) {
+    if (output->isClientGone) {
+        return -1;
+    }
+    unsigned char header[FRAME_HEADER_SIZE];
+    uint32_t networkLength = htonl(length);
+    header[0] = type;
+    memcpy(header + 1, &networkLength, sizeof(networkLength));
+    struct iovec vectors[2] = {{header, FRAME_HEADER_SIZE}, {(void *) payload, length}};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = vectors;
+    message.msg_iovlen = 2;
+    size_t remaining = FRAME_HEADER_SIZE + length;
+    while (remaining > 0) {
+        ssize_t bytesSent = sendmsg(output->clientFd, &message, MSG_NOSIGNAL);
+        if ((bytesSent == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (bytesSent <= 0) {
+            output->isClientGone = 1;
+            return -1;
+        }
+        remaining -= bytesSent;
+        // Skipping what has been sent
+        while ((message.msg_iovlen > 0) && ((size_t) bytesSent >= message.msg_iov->iov_len)) {
+            bytesSent -= message.msg_iov->iov_len;
+            message.msg_iov++;
+            message.msg_iovlen--;
+        }
+        if (message.msg_iovlen > 0) {
+            message.msg_iov->iov_base = (char *) message.msg_iov->iov_base + bytesSent;
+            message.msg_iov->iov_len -= bytesSent;
+        }
+    }
+    return 0;
+}
+// Reads exactly length bytes. Returns 0 on success, -1 at the end of the input or on error
+int readExactly(int fd, void *buffer, size_t length) {
+    while (length > 0) {
+        ssize_t bytesRead = read(fd, buffer, length);
+        if ((bytesRead == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            return -1;
+        }
+        buffer = (char *) buffer + bytesRead;
+        length -= bytesRead;
+    }
+    return 0;
+}
+/** Our main function **/
+// myshell                         : interactive shell (or reads the commands from stdin if it is not a terminal)
+// myshell script.sh [arguments]    : runs the script, the arguments become $1, $2, ...
+// myshell -c 'command' [name args] : runs the given command line(s), name becomes $0
+// myshell --serve /path.sock       : serves command batches of local clients (see Server mode)
+// The alias table and the PATH hash are only built once a command needs them
+int main(int argc, char **argv) {
+    // Server mode
+    if ((argc >= 2) && (strcmp(argv[1], "--serve") == 0)) {
+        if (argc < 3) {
+            fprintf(stderr, "myshell: --serve: option requires a socket path\n");
+            return 2;
+        }
+        return serveCommands(argv[2]);
+    }
+    // One-shot mode
+    if ((argc >= 2) && (strcmp(argv[1], "-c") == 0)) {
+        if (argc < 3) {
+            fprintf(stderr, "myshell: -c: option requires an argument\n");
+            return 2;
+        }
+        initShell(0);
+        if (argc >= 4) {
+            shellName = argv[3];
+            positionalArguments = argv + 4;
+            numOfPositionalArguments = argc - 4;
+        }
+        char *commands = strdup(argv[2]);
+        int status = runBuffer(commands, strlen(commands));
+        free(commands);
+        return status;
+    }
+    // Script mode
+    if (argc >= 2) {
+        initShell(0);
+        shellName = argv[1];
+        positionalArguments = argv + 2;
+        numOfPositionalArguments = argc - 2;
+        return runScript(argv[1]);
+    }
+
+    // Setting up job control, if we are talking with a terminal. Lines are read with our line
+    // editor then, unless the terminal settings cannot be read
+    int isInteractive = isatty(STDIN_FILENO);
+    initShell(isInteractive);
+    int canEditLines = isInteractive && (tcgetattr(STDIN_FILENO, &shellTermios) == 0);
+
+    // Input line, grown by getline as needed
+    char *userInput = NULL;
+    size_t inputCapacity = 0;
+
+    while (1) {
+        // Reporting the background jobs which have finished (or stopped) meanwhile
+        reportJobs();
+
+        if (isInteractive) {
+            // Initializing the string which is holding our hostname
+            char hostName[1024];
+
+            // Getting the hostname and corresponding error procedures in case of an error
+            if (gethostname(hostName, sizeof(hostName)) != 0) {
+                perror("Error getting hostname");
+                error = 1;
+                return 1;
+            }
+
+            // Printing the prompt (or "> " while a construct is still open) and reading the line
+            // with the line editor
+            char *prompt = NULL;
+            if (pendingLines != NULL) {
+                prompt = strdup("> ");
+            } else if (asprintf(&prompt, "%s@%s %s --- ", getenv("USER"), hostName, getenv("PWD")) == -1) {
+                prompt = NULL;
+            }
+            if (canEditLines && (prompt != NULL)) {
+                char *line = readInteractiveLine(prompt);
+                free(prompt);
+                if (line == NULL) {
+                    printf("\n");
+                    break;
+                }
+                runTypedLine(line);
+                free(line);
+                continue;
+            }
+            printf("%s", prompt != NULL ? prompt : "");
+            free(prompt);
+            fflush(stdout);
+        }
+
+        // Taking the input from the user, if exit signal, then terminate the shell
+        ssize_t inputLength = getline(&userInput, &inputCapacity, stdin);
+        if (inputLength == -1) {
+            break;
+        }
+
+        // Remove the newline character, if exists
+        if ((inputLength > 0) && (userInput[inputLength - 1] == '\n')) {
+            userInput[inputLength - 1] = '\0';
+        }
+
+        runTypedLine(userInput);
+    }
+    // A construct left open by the last lines is a syntax error
+    if (pendingLines != NULL) {
+        runLine(pendingLines, 1);
+        free(pendingLines);
+    }
+    free(userInput);
+    return lastStatus;
+}
+
+/** Our key function. Takes the input, parses it into tokens **/
+/** and does the corresponding executions inside. In case of error **/
+/** it also handles according error procedures as well. **/
+int parser(char* input) {
+    error = 0; // Initialized error flag
+
+    // A line which has been launched before (and whose aliases and commands have not changed
+    // since) is not parsed again, its plan is spawned as it is
+    resolveStart = nowMicroseconds();
+    struct executionPlan *knownPlan = findPlan(input);
+    if (knownPlan != NULL) {
+        return spawn(knownPlan, input);
+    }
+
+    // Every token of this command lives inside this arena, which is freed in one shot at the end
+    struct arena arena = {NULL};
+    struct tokenList list;
+
+    // If an error occurs in the parsing part, do not do any execution
+    // just exit the function by returning 1 immediately
+    double parseStart = nowMicroseconds();
+    lineIsGlobbed = 0;
+    if (tokenize(input, &arena, &list) != 0) {
+        arenaFree(&arena);
+        error = 1;
+        return 1;
+    }
+    resolveStart = nowMicroseconds();
+    recordLatency(PHASE_PARSE, resolveStart - parseStart);
+    recordSpan("tokenize", input, parseStart, resolveStart);
+
+    int result = executeCommand(list.tokens, list.isOperator, list.numOfTokens, input, &arena);
+    arenaFree(&arena);
+    return result;
+}
+
+/** The execution part. Takes the tokens of a command (index of them, the operators are marked **/
+/** inside isOperator) and does the corresponding executions. The arena is the one of the command **/
+int executeCommand(char** tokens, char* isOperator, int index, char* input, struct arena* arena) {
+    /** The parsing part has finished, the rest belongs to the execution **/
+    /** If we do not write anything, do nothing , just open a new prompt **/
+    if (index == 0) {
+        return 0;
+    }
+    /** time prefix, runs the rest of the line and reports what it has cost **/
+    if ((strcmp(tokens[0], "time") == 0) && !isOperator[0]) {
+        return timeCommand(tokens, isOperator, index, input, arena);
+    }
+    /** pin, nice and ionice prefixes, they place the job of the rest of the line. The forms they **/
+    /** do not handle go on below, to the nice and ionice programs **/
+    if (!isOperator[0] && ((strcmp(tokens[0], "pin") == 0) || (strcmp(tokens[0], "nice") == 0) || (strcmp(tokens[0], "ionice") == 0))) {
+        int result = placementCommand(tokens, isOperator, index, input, arena);
+        if (result != -1) {
+            return result;
+        }
+    }
+    /** Executing the aliased command **/
+    // The command which will be executed, looked up from the in-memory alias table. An alias
+    // which is already being expanded is not expanded again (so "alias ls = ls -la" works),
+    // and builtin names are never looked up (a builtin cannot be overridden by an alias)
+    int isBeingExpanded = (aliasDepth >= MAX_ALIAS_DEPTH) || (findBuiltin(tokens[0]) != NULL);
+    for (int a = 0; a < aliasDepth; a++) {
+        if (strcmp(aliasesBeingExpanded[a], tokens[0]) == 0) {isBeingExpanded = 1;}
+    }
+    char *storedCommand = isBeingExpanded ? NULL : findAlias(tokens[0]);
+
+    // Meaning our command is aliased, just execute the command
+    if (storedCommand != NULL) {
+        // Tokenizing the stored command, its tokens replace the alias key
+        struct tokenList aliasList;
+        if (tokenize(storedCommand, arena, &aliasList) != 0) {
+            error = 1;
+            return 1;
+        }
+
+        // Wrapping up the command stored inside alias with the rest arguments of the alias
+        int numOfWrapped = aliasList.numOfTokens + index - 1;
+        char **wrappedTokens = arenaAlloc(arena, (numOfWrapped + 1) * sizeof(char *));
+        char *wrappedIsOperator = arenaAlloc(arena, numOfWrapped + 1);
+        memcpy(wrappedTokens, aliasList.tokens, aliasList.numOfTokens * sizeof(char *));
+        memcpy(wrappedIsOperator, aliasList.isOperator, aliasList.numOfTokens);
+        memcpy(wrappedTokens + aliasList.numOfTokens, tokens + 1, (index - 1) * sizeof(char *));
+        memcpy(wrappedIsOperator + aliasList.numOfTokens, isOperator + 1, index - 1);
+        wrappedTokens[numOfWrapped] = NULL;
+
+        // Executing the wrapped command
+        aliasesBeingExpanded[aliasDepth++] = tokens[0];
+        int result = executeCommand(wrappedTokens, wrappedIsOperator, numOfWrapped, input, arena);
+        aliasDepth--;
+        return result;
+    }
+
+    // Input redirection (< file, <<< string), which applies to the first command. The operator
+    // and its word are taken out of the tokens, wherever they are before the first |
+    int inputType = INPUT_NONE;
+    char *inputSource = NULL;
+    int numOfKept = 0;
+    int hasPipe = 0;
+    for (int a = 0; a < index; a++) {
+        if (isOperator[a] && (tokens[a][0] == '<')) {
+            if (strcmp(tokens[a], "<<") == 0) {
+                fprintf(stderr, "Error: here-documents (<<) are not supported, use <<< instead\n");
+                error = 1;
+                return 1;
+            }
+            if ((tokens[a + 1] == NULL) || isOperator[a + 1]) {
+                fprintf(stderr, "Error: missing %s after '%s'\n", strcmp(tokens[a], "<") == 0 ? "file name" : "string", tokens[a]);
+                error = 1;
+                return 1;
+            }
+            if (hasPipe) {
+                fprintf(stderr, "Error: '%s' can only be used by the first command of a pipeline\n", tokens[a]);
+                error = 1;
+                return 1;
+            }
+            inputType = strcmp(tokens[a], "<") == 0 ? INPUT_FILE : INPUT_STRING;
+            inputSource = tokens[++a];
+            continue;
+        }
+        if (isOperator[a] && (strcmp(tokens[a], "|") == 0)) {hasPipe = 1;}
+        tokens[numOfKept] = tokens[a];
+        isOperator[numOfKept] = isOperator[a];
+        numOfKept++;
+    }
+    tokens[numOfKept] = NULL;
+    index = numOfKept;
+    if (index == 0) {
+        return 0;
+    }
+
+    // Indexes of >,>>,>>>,& (if not exist in the input, initialized as -1)
+    int indexOfBackground = -1;
+    int indexOfRedirection = -1;
+    int indexOfAppend = -1;
+    int indexOfReverseAppend = -1;
+
+    // Checking these indexes (only unquoted operators count)
+    for (int a = 0; a<index; a++) {
+        if (!isOperator[a]) {continue;}
+        if (strcmp(tokens[a], "&") == 0) {indexOfBackground = a; continue;}
+        if (strcmp(tokens[a], ">") == 0) {indexOfRedirection = a; continue;}
+        if (strcmp(tokens[a], ">>") == 0) {indexOfAppend = a; continue;}
+        if (strcmp(tokens[a], ">>>") == 0) {indexOfReverseAppend = a; continue;}
+    }
+
+    // Finding the redirection (> >> >>>) and the end of the arguments, which is the first operator
+    int redirectionType = REDIRECT_NONE;
+    int indexOfOperator = -1;
+    if (indexOfRedirection != -1) {redirectionType = REDIRECT_WRITE; indexOfOperator = indexOfRedirection;}
+    else if (indexOfAppend != -1) {redirectionType = REDIRECT_APPEND; indexOfOperator = indexOfAppend;}
+    else if (indexOfReverseAppend != -1) {redirectionType = REDIRECT_REVERSE; indexOfOperator = indexOfReverseAppend;}
+    int endOfArguments = index;
+    if ((indexOfOperator != -1) && (indexOfOperator < endOfArguments)) {endOfArguments = indexOfOperator;}
+    if ((indexOfBackground != -1) && (indexOfBackground < endOfArguments)) {endOfArguments = indexOfBackground;}
+
+    // The file name must follow the redirection operator
+    char *fileName = NULL;
+    if (redirectionType != REDIRECT_NONE) {
+        fileName = tokens[indexOfOperator + 1];
+        if ((fileName == NULL) || isOperator[indexOfOperator + 1]) {
+            fprintf(stderr, "Error: missing file name after '%s'\n", tokens[indexOfOperator]);
+            error = 1;
+            return 1;
+        }
+    }
+
+    // Creating args array, the | tokens are replaced with NULL, so each stage of the
+    // pipeline gets its own NULL terminated part of it
+    char **args = arenaAlloc(arena, (endOfArguments + 1) * sizeof(char *));
+    char ***stages = arenaAlloc(arena, (endOfArguments + 1) * sizeof(char **));
+    int numOfStages = 0;
+    for (int b = 0; b < endOfArguments; b++) {
+        if (isOperator[b] && (strcmp(tokens[b], "|") == 0)) {
+            args[b] = NULL;
+            continue;
+        }
+        args[b] = tokens[b];
+        if ((b == 0) || (args[b - 1] == NULL)) {
+            stages[numOfStages++] = &args[b];
+        }
+    }
+    args[endOfArguments] = NULL;
+
+    // Every | must be between two commands
+    int numOfPipes = 0;
+    for (int b = 0; b < endOfArguments; b++) {
+        if (args[b] == NULL) {numOfPipes++;}
+    }
+    if ((numOfStages != numOfPipes + 1) || (args[endOfArguments - 1] == NULL) || (args[0] == NULL)) {
+        fprintf(stderr, "Error: syntax error near '|'\n");
+        error = 1;
+        return 1;
+    }
+
+    /** Builtin case (a builtin alone in the foreground) **/
+    // It runs inside the shell, with its stdout swapped for the redirection file meanwhile.
+    // A background builtin, one inside a pipeline, or one with a placement (which must not
+    // change the shell itself) is spawned like a command (it is forked)
+    struct builtin *builtin = findBuiltin(args[0]);
+    if ((builtin != NULL) && (numOfStages == 1) && (indexOfBackground == -1) && !isPlaced(&linePlacement)) {
+        double builtinStart = traceClock();
+        int result = runBuiltin(builtin, args, endOfArguments, redirectionType, fileName, inputType, inputSource);
+        recordSpan("builtin", args[0], builtinStart, traceClock());
+        return result;
+    }
+
+    // Every stage must be a builtin or a command inside the path, the plan gets their absolute paths
+    char **programs = arenaAlloc(arena, numOfStages * sizeof(char *));
+    for (int b = 0; b < numOfStages; b++) {
+        if (findBuiltin(stages[b][0]) != NULL) {
+            programs[b] = stages[b][0];
+            continue;
+        }
+        if (!isInPath(stages[b][0])) {
+            return 127; // Command not found
+        }
+        programs[b] = lookupCommand(stages[b][0]);
+    }
+    struct executionPlan plan = {stages, programs, numOfStages, redirectionType, fileName, indexOfBackground != -1, inputType, inputSource, linePlacement};
+
+    // Remembering the plan of the whole line, so the next time it is spawned without parsing
+    if (!isBeingTimed && !lineIsGlobbed) {
+        cachePlan(input, &plan);
+    }
+
+    // Spawn the execution as a (foreground or background) job
+    return spawn(&plan, input);
 }
\ No newline at end of file